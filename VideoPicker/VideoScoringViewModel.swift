@@ -295,7 +295,9 @@ final class VideoScoringViewModel: ObservableObject {
                 }
             }
 
-            func analyzeChunk() throws {
+            // Async so that cancelling the view model's task also stops the
+            // chunk the core is currently scoring.
+            func analyzeChunk() async throws {
                 guard !frames.isEmpty else { return }
                 let result: VideoQualityAggregate
                 switch mode {
@@ -307,9 +309,13 @@ final class VideoScoringViewModel: ObservableObject {
                         "VideoPickerScoring person mode: using heuristic person-blur scores. count=%d",
                         personBlurScores.count
                     )
-                    result = try scorer.analyze(frames: frames, personBlurScores: personBlurScores)
+                    result = try await scorer.analyzeAsync(
+                        frames: frames,
+                        personBlurScores: personBlurScores,
+                        priority: .interactive
+                    )
                 case .scenery:
-                    result = try scorer.analyze(frames: frames)
+                    result = try await scorer.analyzeAsync(frames: frames, priority: .interactive)
                 }
                 merge(result, frameCount: frames.count)
                 frames.removeAll(keepingCapacity: true)
@@ -331,7 +337,7 @@ final class VideoScoringViewModel: ObservableObject {
                     frames.append(FrameInput(pixelBuffer: pixelBuffer, timestamp: timestamp))
                 }
                 if frames.count >= chunkSize {
-                    try analyzeChunk()
+                    try await analyzeChunk()
                 }
             }
 
@@ -339,7 +345,7 @@ final class VideoScoringViewModel: ObservableObject {
                 return nil
             }
 
-            try analyzeChunk()
+            try await analyzeChunk()
 
             guard totalFrames > 0 else {
                 NSLog("VideoPickerScoring skipped: no frames extracted")
@@ -356,6 +362,9 @@ final class VideoScoringViewModel: ObservableObject {
             let score = Self.weightedScore(from: meanItems, mode: mode)
             Self.logScoringDetails(items: meanItems, weightedScore: score, mode: mode)
             return score
+        } catch is CancellationError {
+            NSLog("VideoPickerScoring analyze cancelled")
+            return nil
         } catch {
             if case let VideoPickerScoringError.analyzeFailed(code) = error {
                 let message = Self.videoPickerScoringErrorMessage(for: code)
@@ -428,6 +437,10 @@ final class VideoScoringViewModel: ObservableObject {
             return "decode error"
         case 5:
             return "unsupported frame input"
+        case 6:
+            return "io error"
+        case 7:
+            return "cancelled"
         default:
             return "unknown error"
         }
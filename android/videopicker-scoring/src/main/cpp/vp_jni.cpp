@@ -1,7 +1,205 @@
 #include <jni.h>
-extern "C" JNIEXPORT jobject JNICALL
-Java_com_example_videopickerscoring_VideoPickerScoring_analyzeVideo(JNIEnv* env, jobject /*thiz*/, jstring filePath) {
-  (void)env;
-  (void)filePath;
-  return nullptr;
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "vp_analyzer.h"
+
+// Frames cross JNI as direct ByteBuffers: the native side reads the Java
+// buffers in place through GetDirectBufferAddress, so no pixel is copied.
+// Layouts shared with NativeScoring.java (keep both in sync):
+// - planes: kPlanesPerFrame entries per frame (Y/U/V, or one packed plane
+//   followed by nulls).
+// - meta: kMetaFields ints per frame.
+// - result: item_count, then kResultFieldsPerItem floats per item.
+
+namespace {
+
+constexpr int kPlanesPerFrame = 3;
+
+enum MetaField {
+  kMetaWidth = 0,
+  kMetaHeight,
+  kMetaFormat,
+  kMetaRowStrideY,
+  kMetaRowStrideU,
+  kMetaRowStrideV,
+  kMetaPixelStrideUv,
+  kMetaFields
+};
+
+// id, mean score, mean raw, worst score, worst raw.
+constexpr int kResultFieldsPerItem = 5;
+constexpr int kResultSize = 1 + VP_MAX_ITEMS * kResultFieldsPerItem;
+
+// Per-handle state; the vectors keep their capacity so steady-state batches
+// do not allocate.
+struct JniAnalyzer {
+  VpAnalyzer* analyzer = nullptr;
+  std::vector<VpFrame> frames;
+  std::vector<jint> meta;
+};
+
+int bytes_per_pixel(int format) {
+  switch (format) {
+    case VP_PIXEL_GRAY8:
+    case VP_PIXEL_NV12:
+    case VP_PIXEL_I420:
+      return 1;
+    case VP_PIXEL_RGBA8888:
+    case VP_PIXEL_BGRA8888:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+// Address of a direct buffer holding `rows` rows of `row_bytes` at `stride`,
+// or nullptr when the buffer is missing, heap-backed or too small.
+const uint8_t* plane_address(JNIEnv* env, jobject buffer, int64_t stride, int64_t rows,
+                             int64_t row_bytes) {
+  if (!buffer || stride < row_bytes || rows <= 0) {
+    return nullptr;
+  }
+  void* address = env->GetDirectBufferAddress(buffer);
+  jlong capacity = env->GetDirectBufferCapacity(buffer);
+  if (!address || capacity < stride * (rows - 1) + row_bytes) {
+    return nullptr;
+  }
+  return static_cast<const uint8_t*>(address);
+}
+
+// Validates frame `index` and fills `out`. 4:2:0 frames must carry both
+// chroma planes so the buffers Android hands out are checked as a whole,
+// even though scoring only reads luma.
+int build_frame(JNIEnv* env, jobjectArray planes, const jint* meta, int index, VpFrame* out) {
+  const int width = meta[kMetaWidth];
+  const int height = meta[kMetaHeight];
+  const int format = meta[kMetaFormat];
+  const int bpp = bytes_per_pixel(format);
+  if (width <= 0 || height <= 0 || bpp == 0) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+
+  jobject y_buffer = env->GetObjectArrayElement(planes, index * kPlanesPerFrame);
+  const uint8_t* y = plane_address(env, y_buffer, meta[kMetaRowStrideY], height,
+                                   static_cast<int64_t>(width) * bpp);
+  env->DeleteLocalRef(y_buffer);
+  if (!y) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+
+  int vp_format = format;
+  if (format == VP_PIXEL_NV12 || format == VP_PIXEL_I420) {
+    const int pixel_stride = meta[kMetaPixelStrideUv];
+    if (pixel_stride < 1) {
+      return VP_ERR_INVALID_ARGUMENT;
+    }
+    const int64_t chroma_rows = (height + 1) / 2;
+    const int64_t chroma_bytes = static_cast<int64_t>((width + 1) / 2 - 1) * pixel_stride + 1;
+    for (int plane = 1; plane < kPlanesPerFrame; ++plane) {
+      jobject buffer = env->GetObjectArrayElement(planes, index * kPlanesPerFrame + plane);
+      const uint8_t* chroma = plane_address(env, buffer, meta[kMetaRowStrideY + plane],
+                                            chroma_rows, chroma_bytes);
+      env->DeleteLocalRef(buffer);
+      if (!chroma) {
+        return VP_ERR_INVALID_ARGUMENT;
+      }
+    }
+    // YUV_420_888 with interleaved chroma is NV12/NV21 underneath.
+    vp_format = pixel_stride == 2 ? VP_PIXEL_NV12 : VP_PIXEL_I420;
+  }
+
+  *out = VpFrame{width, height, meta[kMetaRowStrideY], static_cast<VpPixelFormat>(vp_format), y};
+  return VP_OK;
+}
+
+void write_result(const VpAggregateResult& result, jfloat* out) {
+  out[0] = static_cast<jfloat>(result.item_count);
+  for (int i = 0; i < result.item_count; ++i) {
+    jfloat* item = out + 1 + i * kResultFieldsPerItem;
+    item[0] = static_cast<jfloat>(result.mean[i].id);
+    item[1] = result.mean[i].score;
+    item[2] = result.mean[i].raw;
+    item[3] = result.worst[i].score;
+    item[4] = result.worst[i].raw;
+  }
+}
+
+} // namespace
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_videopickerscoring_NativeScoring_create(JNIEnv* /*env*/, jclass /*clazz*/,
+                                                         jint maxFrames,
+                                                         jint nearDuplicateDistance) {
+  VpConfig config;
+  vp_default_config(&config);
+  if (maxFrames > 0) {
+    config.max_frames = maxFrames;
+  }
+  config.near_duplicate_distance = nearDuplicateDistance;
+
+  JniAnalyzer* handle = new (std::nothrow) JniAnalyzer();
+  if (!handle) {
+    return 0;
+  }
+  handle->analyzer = vp_create(&config);
+  if (!handle->analyzer) {
+    delete handle;
+    return 0;
+  }
+  return reinterpret_cast<jlong>(handle);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_videopickerscoring_NativeScoring_destroy(JNIEnv* /*env*/, jclass /*clazz*/,
+                                                          jlong handle) {
+  JniAnalyzer* analyzer = reinterpret_cast<JniAnalyzer*>(handle);
+  if (!analyzer) {
+    return;
+  }
+  vp_destroy(analyzer->analyzer);
+  delete analyzer;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_videopickerscoring_NativeScoring_analyzeBatch(JNIEnv* env, jclass /*clazz*/,
+                                                               jlong handle, jobjectArray planes,
+                                                               jintArray meta, jint frameCount,
+                                                               jfloatArray result) {
+  JniAnalyzer* analyzer = reinterpret_cast<JniAnalyzer*>(handle);
+  if (!analyzer || !planes || !meta || !result || frameCount <= 0 ||
+      env->GetArrayLength(planes) < static_cast<jsize>(frameCount) * kPlanesPerFrame ||
+      env->GetArrayLength(meta) < static_cast<jsize>(frameCount) * kMetaFields ||
+      env->GetArrayLength(result) < kResultSize) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+
+  try {
+    analyzer->meta.resize(static_cast<size_t>(frameCount) * kMetaFields);
+    analyzer->frames.resize(static_cast<size_t>(frameCount));
+  } catch (const std::bad_alloc&) {
+    return VP_ERR_ALLOC;
+  }
+  env->GetIntArrayRegion(meta, 0, frameCount * kMetaFields, analyzer->meta.data());
+
+  for (int i = 0; i < frameCount; ++i) {
+    int rc = build_frame(env, planes, analyzer->meta.data() + i * kMetaFields, i,
+                         &analyzer->frames[i]);
+    if (rc != VP_OK) {
+      return rc;
+    }
+  }
+
+  VpAggregateResult aggregate;
+  int rc = vp_analyze_frames(analyzer->analyzer, analyzer->frames.data(), frameCount, &aggregate);
+  if (rc != VP_OK) {
+    return rc;
+  }
+  jfloat values[kResultSize] = {};
+  write_result(aggregate, values);
+  env->SetFloatArrayRegion(result, 0, kResultSize, values);
+  return VP_OK;
 }
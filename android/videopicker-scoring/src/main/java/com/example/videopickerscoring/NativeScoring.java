@@ -0,0 +1,52 @@
+package com.example.videopickerscoring;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Raw JNI surface of vp_scoring_jni. It depends on java.nio only, so the same
+ * class loads on a host JVM for tests (see core/CMakeLists.txt, VP_BUILD_JNI).
+ * Array layouts must match vp_jni.cpp.
+ */
+final class NativeScoring {
+    // VpPixelFormat values. YUV_420_888 frames use FORMAT_I420; the native
+    // side switches to NV12 when the chroma pixel stride is 2.
+    static final int FORMAT_GRAY8 = 0;
+    static final int FORMAT_RGBA8888 = 1;
+    static final int FORMAT_BGRA8888 = 2;
+    static final int FORMAT_NV12 = 3;
+    static final int FORMAT_I420 = 4;
+
+    static final int PLANES_PER_FRAME = 3;
+
+    static final int META_WIDTH = 0;
+    static final int META_HEIGHT = 1;
+    static final int META_FORMAT = 2;
+    static final int META_ROW_STRIDE_Y = 3;
+    static final int META_ROW_STRIDE_U = 4;
+    static final int META_ROW_STRIDE_V = 5;
+    static final int META_PIXEL_STRIDE_UV = 6;
+    static final int META_FIELDS = 7;
+
+    static final int MAX_ITEMS = 16;
+    // result[0] is the item count; each item is id, mean score, mean raw,
+    // worst score, worst raw.
+    static final int RESULT_FIELDS_PER_ITEM = 5;
+    static final int RESULT_SIZE = 1 + MAX_ITEMS * RESULT_FIELDS_PER_ITEM;
+
+    static final int OK = 0;
+
+    private NativeScoring() {}
+
+    /** Returns 0 on failure. maxFrames <= 0 keeps the core default. */
+    static native long create(int maxFrames, int nearDuplicateDistance);
+
+    static native void destroy(long handle);
+
+    /**
+     * Scores frameCount frames in one call. planes holds PLANES_PER_FRAME
+     * direct buffers per frame (null for unused planes), meta META_FIELDS
+     * ints per frame. Returns a VpErrorCode.
+     */
+    static native int analyzeBatch(long handle, ByteBuffer[] planes, int[] meta, int frameCount,
+                                   float[] result);
+}
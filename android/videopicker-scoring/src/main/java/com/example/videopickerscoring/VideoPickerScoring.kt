@@ -2,15 +2,107 @@ package com.example.videopickerscoring
 
 import android.content.ContentResolver
 import android.content.Context
+import android.media.Image
 import android.net.Uri
+import java.io.Closeable
 import java.io.File
 import java.io.FileOutputStream
+import java.nio.ByteBuffer
 
-class VideoPickerScoring {
+class VideoPickerScoring(
+    maxFrames: Int = 0,
+    nearDuplicateDistance: Int = 0,
+) : Closeable {
     data class Item(val id: String, val score: Float, val raw: Float)
     data class Aggregate(val mean: List<Item>, val worst: List<Item>)
 
-    external fun analyzeVideo(filePath: String): Aggregate?
+    enum class PixelFormat(internal val code: Int) {
+        GRAY8(NativeScoring.FORMAT_GRAY8),
+        RGBA8888(NativeScoring.FORMAT_RGBA8888),
+        BGRA8888(NativeScoring.FORMAT_BGRA8888),
+    }
+
+    /**
+     * One frame backed by direct ByteBuffers, which the native side reads in
+     * place. Buffers must stay unmodified until analyzeFrames returns.
+     */
+    class Frame private constructor(
+        internal val width: Int,
+        internal val height: Int,
+        internal val format: Int,
+        internal val planes: Array<ByteBuffer?>,
+        internal val rowStrides: IntArray,
+        internal val chromaPixelStride: Int,
+    ) {
+        companion object {
+            fun packed(width: Int, height: Int, format: PixelFormat, buffer: ByteBuffer, rowStride: Int): Frame {
+                require(buffer.isDirect) { "frame buffers must be direct" }
+                return Frame(width, height, format.code, arrayOf(buffer, null, null), intArrayOf(rowStride, 0, 0), 0)
+            }
+
+            /** Planes of an ImageFormat.YUV_420_888 image, as returned by Image.getPlanes(). */
+            fun yuv420888(width: Int, height: Int, planes: Array<Image.Plane>): Frame {
+                require(planes.size == 3) { "YUV_420_888 has three planes" }
+                val buffers = Array<ByteBuffer?>(3) { planes[it].buffer }
+                require(buffers.all { it!!.isDirect }) { "frame buffers must be direct" }
+                return Frame(
+                    width,
+                    height,
+                    NativeScoring.FORMAT_I420,
+                    buffers,
+                    IntArray(3) { planes[it].rowStride },
+                    planes[1].pixelStride,
+                )
+            }
+
+            fun fromImage(image: Image): Frame = yuv420888(image.width, image.height, image.planes)
+        }
+    }
+
+    private var handle: Long = NativeScoring.create(maxFrames, nearDuplicateDistance)
+    private val result = FloatArray(NativeScoring.RESULT_SIZE)
+
+    init {
+        check(handle != 0L) { "vp_create failed" }
+    }
+
+    /**
+     * Scores all frames in a single JNI call. Returns null when the core
+     * rejects the batch (invalid geometry, heap buffers or too-small planes).
+     */
+    fun analyzeFrames(frames: List<Frame>): Aggregate? {
+        check(handle != 0L) { "analyzer is closed" }
+        if (frames.isEmpty()) {
+            return null
+        }
+        val planes = arrayOfNulls<ByteBuffer>(frames.size * NativeScoring.PLANES_PER_FRAME)
+        val meta = IntArray(frames.size * NativeScoring.META_FIELDS)
+        frames.forEachIndexed { index, frame ->
+            for (plane in 0 until NativeScoring.PLANES_PER_FRAME) {
+                planes[index * NativeScoring.PLANES_PER_FRAME + plane] = frame.planes[plane]
+            }
+            val base = index * NativeScoring.META_FIELDS
+            meta[base + NativeScoring.META_WIDTH] = frame.width
+            meta[base + NativeScoring.META_HEIGHT] = frame.height
+            meta[base + NativeScoring.META_FORMAT] = frame.format
+            meta[base + NativeScoring.META_ROW_STRIDE_Y] = frame.rowStrides[0]
+            meta[base + NativeScoring.META_ROW_STRIDE_U] = frame.rowStrides[1]
+            meta[base + NativeScoring.META_ROW_STRIDE_V] = frame.rowStrides[2]
+            meta[base + NativeScoring.META_PIXEL_STRIDE_UV] = frame.chromaPixelStride
+        }
+        val code = NativeScoring.analyzeBatch(handle, planes, meta, frames.size, result)
+        if (code != NativeScoring.OK) {
+            return null
+        }
+        return aggregateFromResult(result)
+    }
+
+    override fun close() {
+        if (handle != 0L) {
+            NativeScoring.destroy(handle)
+            handle = 0L
+        }
+    }
 
     fun weightedScore(aggregate: Aggregate): Float? {
         val weights = mapOf(
@@ -37,10 +129,26 @@ class VideoPickerScoring {
     }
 
     companion object {
+        // VpMetricId order.
+        private val metricIds = listOf("sharpness", "exposure", "motion_blur", "noise", "person_blur")
+
         init {
             System.loadLibrary("vp_scoring_jni")
         }
 
+        private fun aggregateFromResult(result: FloatArray): Aggregate {
+            val count = result[0].toInt()
+            val mean = ArrayList<Item>(count)
+            val worst = ArrayList<Item>(count)
+            for (i in 0 until count) {
+                val base = 1 + i * NativeScoring.RESULT_FIELDS_PER_ITEM
+                val id = metricIds.getOrElse(result[base].toInt()) { "metric_${result[base].toInt()}" }
+                mean.add(Item(id, result[base + 1], result[base + 2]))
+                worst.add(Item(id, result[base + 3], result[base + 4]))
+            }
+            return Aggregate(mean, worst)
+        }
+
         fun copyContentUriToFile(context: Context, uri: Uri, destFileName: String = "vp_temp_video") : File {
             val resolver: ContentResolver = context.contentResolver
             val tempFile = File.createTempFile(destFileName, ".mp4", context.cacheDir)
@@ -0,0 +1,101 @@
+package com.example.videopickerscoring;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Host-JVM smoke test for vp_scoring_jni (ctest target jni_host_check, built
+ * with -DVP_BUILD_JNI=ON). Plain main() so it needs no test framework.
+ */
+public final class NativeScoringHostCheck {
+    private static final int WIDTH = 160;
+    private static final int HEIGHT = 120;
+
+    public static void main(String[] args) {
+        System.loadLibrary("vp_scoring_jni");
+        long handle = NativeScoring.create(0, 0);
+        check(handle != 0, "create");
+        try {
+            checkBatch(handle);
+            checkRejectsHeapBuffers(handle);
+            checkRejectsShortPlanes(handle);
+        } finally {
+            NativeScoring.destroy(handle);
+        }
+        System.out.println("jni_host_check: OK");
+    }
+
+    private static void checkBatch(long handle) {
+        int frames = 4;
+        ByteBuffer[] planes = new ByteBuffer[frames * NativeScoring.PLANES_PER_FRAME];
+        int[] meta = new int[frames * NativeScoring.META_FIELDS];
+        for (int i = 0; i < frames; ++i) {
+            // Even frames: GRAY8. Odd frames: YUV_420_888 with interleaved chroma.
+            boolean yuv = (i & 1) == 1;
+            int stride = WIDTH + 32;
+            planes[i * NativeScoring.PLANES_PER_FRAME] = pattern(stride, HEIGHT, i);
+            int base = i * NativeScoring.META_FIELDS;
+            meta[base + NativeScoring.META_WIDTH] = WIDTH;
+            meta[base + NativeScoring.META_HEIGHT] = HEIGHT;
+            meta[base + NativeScoring.META_FORMAT] =
+                    yuv ? NativeScoring.FORMAT_I420 : NativeScoring.FORMAT_GRAY8;
+            meta[base + NativeScoring.META_ROW_STRIDE_Y] = stride;
+            if (yuv) {
+                ByteBuffer chroma = ByteBuffer.allocateDirect(WIDTH * HEIGHT / 2);
+                planes[i * NativeScoring.PLANES_PER_FRAME + 1] = chroma;
+                planes[i * NativeScoring.PLANES_PER_FRAME + 2] = chroma;
+                meta[base + NativeScoring.META_ROW_STRIDE_U] = WIDTH;
+                meta[base + NativeScoring.META_ROW_STRIDE_V] = WIDTH;
+                meta[base + NativeScoring.META_PIXEL_STRIDE_UV] = 2;
+            }
+        }
+        float[] result = new float[NativeScoring.RESULT_SIZE];
+        int code = NativeScoring.analyzeBatch(handle, planes, meta, frames, result);
+        check(code == NativeScoring.OK, "analyzeBatch returned " + code);
+        int count = (int) result[0];
+        check(count > 0 && count <= NativeScoring.MAX_ITEMS, "item count " + count);
+        for (int item = 0; item < count; ++item) {
+            float score = result[1 + item * NativeScoring.RESULT_FIELDS_PER_ITEM + 1];
+            check(score >= 0.0f && score <= 1.0f, "score out of range: " + score);
+        }
+    }
+
+    private static void checkRejectsHeapBuffers(long handle) {
+        ByteBuffer[] planes = {ByteBuffer.allocate(WIDTH * HEIGHT), null, null};
+        int[] meta = grayMeta(WIDTH);
+        int code = NativeScoring.analyzeBatch(handle, planes, meta, 1,
+                new float[NativeScoring.RESULT_SIZE]);
+        check(code != NativeScoring.OK, "heap buffer accepted");
+    }
+
+    private static void checkRejectsShortPlanes(long handle) {
+        ByteBuffer[] planes = {ByteBuffer.allocateDirect(WIDTH * HEIGHT - 1), null, null};
+        int code = NativeScoring.analyzeBatch(handle, planes, grayMeta(WIDTH), 1,
+                new float[NativeScoring.RESULT_SIZE]);
+        check(code != NativeScoring.OK, "short plane accepted");
+    }
+
+    private static int[] grayMeta(int stride) {
+        int[] meta = new int[NativeScoring.META_FIELDS];
+        meta[NativeScoring.META_WIDTH] = WIDTH;
+        meta[NativeScoring.META_HEIGHT] = HEIGHT;
+        meta[NativeScoring.META_FORMAT] = NativeScoring.FORMAT_GRAY8;
+        meta[NativeScoring.META_ROW_STRIDE_Y] = stride;
+        return meta;
+    }
+
+    private static ByteBuffer pattern(int stride, int height, int seed) {
+        ByteBuffer buffer = ByteBuffer.allocateDirect(stride * height);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < stride; ++x) {
+                buffer.put(y * stride + x, (byte) (((x + seed * 3) / 8 + y / 8) % 2 == 0 ? 40 : 200));
+            }
+        }
+        return buffer;
+    }
+
+    private static void check(boolean condition, String message) {
+        if (!condition) {
+            throw new AssertionError(message);
+        }
+    }
+}
@@ -9,6 +9,13 @@ extern "C" {
 
 #define VP_MAX_ITEMS 16
 #define VP_METRIC_ID_MAX_LEN 32
+#define VP_MAX_PERSON_BOXES 32
+#define VP_MAX_GRID_DIM 16
+#define VP_MAX_TILES (VP_MAX_GRID_DIM * VP_MAX_GRID_DIM)
+#define VP_SIGNATURE_HASHES 8
+// Metric ids from here up to VP_MAX_ITEMS - 1 are free for custom metrics
+// (see vp_register_metric); lower ids are reserved for built-ins.
+#define VP_METRIC_CUSTOM_FIRST 8
 
 typedef enum {
   VP_OK = 0,
@@ -16,12 +23,16 @@ typedef enum {
   VP_ERR_ALLOC = 2,
   VP_ERR_FFMPEG = 3,
   VP_ERR_DECODE = 4,
-  VP_ERR_UNSUPPORTED = 5
+  VP_ERR_UNSUPPORTED = 5,
+  VP_ERR_IO = 6,
+  VP_ERR_CANCELLED = 7
 } VpErrorCode;
 
 typedef enum {
   VP_METRIC_SHARPNESS = 0,
   VP_METRIC_EXPOSURE = 1,
+  // Raw is the gradient anisotropy along the block motion (0 = none, ~0.5 for
+  // 16 px of blur); 0 without a previous frame or below one 16x16 motion block.
   VP_METRIC_MOTION_BLUR = 2,
   VP_METRIC_NOISE = 3,
   VP_METRIC_PERSON_BLUR = 4
@@ -30,7 +41,10 @@ typedef enum {
 typedef enum {
   VP_PIXEL_GRAY8 = 0,
   VP_PIXEL_RGBA8888 = 1,
-  VP_PIXEL_BGRA8888 = 2
+  VP_PIXEL_BGRA8888 = 2,
+  // Planar YUV 4:2:0: data/stride_bytes describe the Y plane. Only luma is read.
+  VP_PIXEL_NV12 = 3,
+  VP_PIXEL_I420 = 4
 } VpPixelFormat;
 
 typedef struct {
@@ -48,6 +62,31 @@ typedef struct {
   float fps;
   VpNormalize normalize;
   int32_t log_frame_details;
+  // Non-zero records a pipeline timeline for vp_write_trace. The VP_TRACE
+  // environment variable also enables it (see vp_write_trace).
+  int32_t enable_trace;
+  // Tile grid for vp_get_tile_grid (e.g. 8x8, up to VP_MAX_GRID_DIM each way).
+  // 0 in either dimension disables it.
+  int32_t grid_cols;
+  int32_t grid_rows;
+  // Near-duplicate skipping: a frame whose 64-bit perceptual hash is within
+  // this Hamming distance (exclusive) of the last fully scored frame reuses
+  // that frame's raw metrics and only recomputes motion blur. 0 disables;
+  // 4..6 suits tripod footage and screen recordings.
+  int32_t near_duplicate_distance;
+  // Luma levels at or below exposure_clip_low / at or above
+  // exposure_clip_high count as clipped (defaults 5 / 250). Invalid pairs
+  // (outside 0..255 or low >= high) fall back to the defaults.
+  int32_t exposure_clip_low;
+  int32_t exposure_clip_high;
+  // Tuning profile written by vp_autotune: the faster of two equivalent
+  // kernel variants per pixel format, one section per CPU model. NULL falls
+  // back to the VP_TUNING_PROFILE environment variable; without either the
+  // built-in choice is used. Scores never depend on it. Read once per process.
+  const char* tuning_profile;
+  // Non-zero calibrates on the first vp_create of the process when the
+  // profile has no section for this CPU, and saves the result there.
+  int32_t autotune;
   VpThreshold thresholds[VP_MAX_ITEMS];
 } VpConfig;
 
@@ -59,6 +98,29 @@ typedef struct {
   const uint8_t* data;
 } VpFrame;
 
+typedef struct {
+  int32_t x;
+  int32_t y;
+  int32_t width;
+  int32_t height;
+} VpRect;
+
+// Optional per-frame person detections for VP_METRIC_PERSON_BLUR.
+// - boxes: up to VP_MAX_PERSON_BOXES rectangles in frame pixel coordinates;
+//   they are clipped to the frame and overlaps are counted once.
+// - mask: a low-resolution person mask covering the whole frame, scaled to
+//   the frame by nearest neighbour. Each value (0..255) weights the pixel.
+// With both, the mask weights pixels inside the boxes. With neither, person
+// blur falls back to the whole-frame sharpness value.
+typedef struct {
+  int32_t box_count;
+  const VpRect* boxes;
+  int32_t mask_width;
+  int32_t mask_height;
+  int32_t mask_stride;
+  const uint8_t* mask;
+} VpFrameExtras;
+
 typedef struct {
   int32_t metric_id;
   float raw;
@@ -69,6 +131,30 @@ typedef struct {
   const VpMetricValue* values;
 } VpFrameMetrics;
 
+// Computes a custom metric's raw value for one frame. `frame` is the caller's
+// frame as passed to the analyze call (or the downscaled GRAY8 copy in
+// deadline mode); `prev` is the previous frame of the sequence when the
+// metric declared needs_previous_frame and one exists, NULL otherwise.
+// Returning anything but VP_OK aborts the analysis with that code.
+typedef int (*VpMetricKernel)(void* user_data, const VpFrame* frame, const VpFrame* prev,
+                              float* out_raw);
+
+typedef struct {
+  // VP_METRIC_CUSTOM_FIRST .. VP_MAX_ITEMS - 1, unique per analyzer.
+  int32_t metric_id;
+  // Name reported in VpItemResult.id_str and VpMetricStats.id_str.
+  char id_str[VP_METRIC_ID_MAX_LEN];
+  VpThreshold threshold;
+  VpMetricKernel kernel;
+  void* user_data;
+  // Estimated cost in nanoseconds per pixel. It seeds the deadline-mode cost
+  // model, and cheaper custom metrics run first within a frame.
+  float cost_hint;
+  // Non-zero passes the previous frame to the kernel. Such metrics are always
+  // recomputed on near-duplicate frames, like motion blur.
+  int32_t needs_previous_frame;
+} VpCustomMetric;
+
 typedef struct {
   int32_t id;
   char id_str[VP_METRIC_ID_MAX_LEN];
@@ -82,12 +168,239 @@ typedef struct {
   VpItemResult worst[VP_MAX_ITEMS];
 } VpAggregateResult;
 
+// Per-tile raw metrics of the last analyze call. Each metric is averaged over
+// the frames that computed it (<metric>_frames); frames that supplied it
+// through VpFrameMetrics have no tiles and are left out. A metric with 0
+// frames is unavailable and its tiles read 0.
+// Struct-of-arrays, row-major: tile (col, row) is at index row * cols + col.
+// Tiles split the frame evenly (tile col spans x in [col*W/cols, (col+1)*W/cols)).
+typedef struct {
+  int32_t cols;
+  int32_t rows;
+  int32_t frame_count;
+  int32_t sharpness_frames;
+  int32_t exposure_frames;
+  int32_t noise_frames;
+  float sharpness[VP_MAX_TILES];
+  float exposure[VP_MAX_TILES];
+  float noise[VP_MAX_TILES];
+} VpTileGrid;
+
+// Brightness statistics of the last analyze call, derived from the per-frame
+// 256-bin luma histograms summed over the frames that computed exposure.
+// Percentiles are luma levels (0..255); dynamic_range is p95 - p5.
+typedef struct {
+  int32_t frame_count;
+  int32_t clip_low;
+  int32_t clip_high;
+  float mean;
+  float low_clip_ratio;
+  float high_clip_ratio;
+  float p5;
+  float p50;
+  float p95;
+  float dynamic_range;
+  uint64_t histogram[256];
+} VpExposureStats;
+
+typedef enum {
+  VP_STAGE_DECODE = 0,
+  VP_STAGE_CONVERT = 1,
+  VP_STAGE_METRICS = 2,
+  VP_STAGE_COUNT = 3
+} VpStage;
+
+typedef struct {
+  uint64_t calls;
+  uint64_t frames;
+  uint64_t pixels;
+  uint64_t bytes_copied;
+  uint64_t allocations;
+  uint64_t nanoseconds;
+} VpStageStats;
+
+typedef struct {
+  int32_t metric_id;
+  char id_str[VP_METRIC_ID_MAX_LEN];
+  uint64_t calls;
+  uint64_t overrides;
+  uint64_t nanoseconds;
+} VpMetricStats;
+
+typedef struct {
+  int32_t enabled;
+  VpStageStats stages[VP_STAGE_COUNT];
+  int32_t metric_count;
+  VpMetricStats metrics[VP_MAX_ITEMS];
+  uint64_t scratch_bytes;
+  uint64_t near_duplicate_frames;
+} VpStats;
+
+// Supplies the frame nearest to time_sec (seconds on the clip's timeline).
+// The frame must stay valid until the provider is called again or the
+// analysis returns. Returning anything but VP_OK aborts the analysis with
+// that code.
+typedef int (*VpFrameProvider)(void* user_data, double time_sec, VpFrame* out_frame);
+
+typedef struct {
+  double start_sec;
+  double end_sec;
+  // Uniformly spaced timestamps scored first, including both ends. Raised to
+  // 2 when end_sec > start_sec (capped by the budget); a zero-length range
+  // takes one sample.
+  int32_t initial_samples;
+  // Total frames to score, initial ones included; 0 uses VpConfig.max_frames.
+  int32_t frame_budget;
+  // Intervals shorter than twice this are not split (e.g. 1 / source fps).
+  double min_interval_sec;
+  // > 0 also fetches the frame this many seconds before each sample and scores
+  // motion blur against it. 0 skips the extra fetch; motion blur is then 0.
+  double motion_offset_sec;
+} VpAdaptiveSampling;
+
+typedef struct {
+  // Wall-clock budget for the whole call in milliseconds.
+  double budget_ms;
+  // Frames whose short side exceeds this are scored on a box-downscaled luma
+  // copy (power-of-two factor, at most 16). 0 keeps full resolution unless
+  // auto_downscale asks for less.
+  int32_t max_short_side;
+  // Non-zero lets the analyzer downscale further when its measured cost per
+  // pixel predicts that fewer than 3 frames would fit in the budget.
+  int32_t auto_downscale;
+} VpDeadline;
+
+typedef struct {
+  int32_t frames_covered;
+  int32_t frames_total;
+  // Downscale factor used for every scored frame (1 = full resolution).
+  int32_t downscale_factor;
+  double elapsed_ms;
+} VpDeadlineReport;
+
+typedef struct {
+  // Window length in analyzed frames; 0 derives it from window_sec and
+  // VpConfig.fps (rounded, at least 1).
+  int32_t window_frames;
+  float window_sec;
+  // Weight of each metric in the composite frame score, indexed by
+  // VpMetricId. Negative weights are invalid; all zero weighs every metric
+  // equally.
+  float weights[VP_MAX_ITEMS];
+} VpSegmentQuery;
+
+typedef struct {
+  // Frames [start_frame, end_frame) of the analyzed sequence; the times are
+  // frame indices over VpConfig.fps.
+  int32_t start_frame;
+  int32_t end_frame;
+  double start_sec;
+  double end_sec;
+  // Mean composite score of the window (0..1).
+  float score;
+  // Per-metric mean and lowest score over the window, as in VpAggregateResult.
+  int32_t item_count;
+  VpItemResult mean[VP_MAX_ITEMS];
+  VpItemResult worst[VP_MAX_ITEMS];
+} VpSegmentResult;
+
+// Compact per-clip fingerprint for near-duplicate clip detection: the 64-bit
+// perceptual hashes (see near_duplicate_distance) of up to
+// VP_SIGNATURE_HASHES frames spaced evenly over the clip. Nearly flat frames
+// are left out, so hash_count may be lower; 0 never matches anything.
+typedef struct {
+  int32_t hash_count;
+  uint64_t hashes[VP_SIGNATURE_HASHES];
+} VpVideoSignature;
+
+typedef struct {
+  // Two hashes match when their Hamming distance is at most this.
+  int32_t max_distance;
+  // Share of the query's hashes that must match some hash of a clip.
+  float min_match_ratio;
+} VpSignatureQuery;
+
+typedef struct {
+  int32_t found;
+  uint64_t video_id;
+  int32_t matched_hashes;
+  // Sum of the Hamming distances of the matched hashes.
+  int32_t total_distance;
+} VpSignatureMatch;
+
 typedef struct VpAnalyzer VpAnalyzer;
 
+// Locality-sensitive-hash index of clip signatures (see
+// vp_signature_index_query).
+typedef struct VpSignatureIndex VpSignatureIndex;
+
+// Cooperative cancellation flag shared between the caller and a running
+// analysis. Cancelling is thread-safe and sticky.
+typedef struct VpCancelToken VpCancelToken;
+
+// Background analysis started by vp_analyze_frames_async or
+// vp_scheduler_submit.
+typedef struct VpAnalysisTask VpAnalysisTask;
+
+// Shared worker pool that runs async analyses by priority (see
+// vp_scheduler_submit).
+typedef struct VpScheduler VpScheduler;
+
+typedef enum {
+  // Scoring the user waits on, e.g. the clip on screen.
+  VP_PRIORITY_INTERACTIVE = 0,
+  // Library or batch scoring; yields to interactive work between frames.
+  VP_PRIORITY_BACKGROUND = 1
+} VpPriority;
+
+typedef struct {
+  // Analyses scoring at once; 0 uses the number of cores.
+  int32_t max_running;
+  // Fraction of max_running that background analyses may hold, running or
+  // preempted; at least one slot.
+  float background_share;
+  // A background analysis waiting this long is admitted like an interactive
+  // one and no longer preempted; 0 disables aging.
+  int32_t aging_ms;
+} VpSchedulerConfig;
+
+// Called on the analysis thread after each scored frame.
+typedef void (*VpProgressCallback)(void* user_data, int32_t frames_done, int32_t frames_total);
+
+// Called once on the analysis thread when the task ends. result is non-NULL
+// only for VP_OK and valid only during the call. The analyzer is free again
+// when this runs, so the callback may start the next analysis.
+typedef void (*VpCompletionCallback)(void* user_data, int status, const VpAggregateResult* result);
+
+typedef struct {
+  int32_t frames_done;
+  int32_t frames_total;
+  // Non-zero once the completion callback has returned; status is then final.
+  int32_t finished;
+  int32_t status;
+} VpTaskProgress;
+
 void vp_default_config(VpConfig* config);
 
 VpAnalyzer* vp_create(const VpConfig* config);
 
+// Benchmarks the equivalent kernel variants of each pixel format on
+// synthetic width x height frames (0 for 1280x720; a fraction of a second)
+// and makes the fastest the choice of every analyzer created afterwards in
+// this process. With a profile_path the result is also saved under this
+// CPU's section, so later processes load it instead of tuning again.
+// Returns VP_ERR_IO if saving fails; the in-process choice still applies.
+int vp_autotune(const char* profile_path, int32_t width, int32_t height);
+
+// Adds a custom metric to every later analyze call of the analyzer. It runs
+// in the same per-frame pass as the built-ins, on the same frame memory, and
+// is aggregated, overridden by VpFrameMetrics, reused on near-duplicate frames
+// and included in best-segment and adaptive scores like them. Results list it
+// after the built-ins, in registration order. Returns VP_ERR_INVALID_ARGUMENT
+// for a bad or already registered id, a missing kernel or name, or while a
+// task owns the analyzer.
+int vp_register_metric(VpAnalyzer* analyzer, const VpCustomMetric* metric);
+
 int vp_analyze_frames(VpAnalyzer* analyzer, const VpFrame* frames, int frame_count,
                       VpAggregateResult* out_result);
 
@@ -95,6 +408,183 @@ int vp_analyze_frames_with_metrics(VpAnalyzer* analyzer, const VpFrame* frames,
                                    const VpFrameMetrics* frame_metrics, int frame_metrics_count,
                                    VpAggregateResult* out_result);
 
+// Like vp_analyze_frames, with one VpFrameExtras per frame (extras_count must
+// equal frame_count, or extras may be NULL with extras_count 0).
+int vp_analyze_frames_ex(VpAnalyzer* analyzer, const VpFrame* frames, int frame_count,
+                         const VpFrameExtras* extras, int extras_count,
+                         VpAggregateResult* out_result);
+
+// Fills defaults: 9 initial samples, budget from VpConfig.max_frames, 1/30 s
+// minimum interval and a 0.2 s motion offset (the default 5 fps spacing).
+// start_sec/end_sec are left at 0 and must be set by the caller.
+void vp_default_adaptive_sampling(VpAdaptiveSampling* sampling);
+
+// Coarse-to-fine sampling of [start_sec, end_sec]: scores the initial uniform
+// timestamps, then repeatedly scores the midpoint of the interval whose two
+// ends differ most in mean metric score, until frame_budget frames are scored
+// or no interval can be split. Means are weighted by the time each sample
+// covers; worst is taken over every sample. out_times (may be NULL with
+// capacity 0) receives the first out_times_capacity sample times in ascending
+// order and out_sample_count (may be NULL) the number of frames scored.
+int vp_analyze_adaptive(VpAnalyzer* analyzer, const VpAdaptiveSampling* sampling,
+                        VpFrameProvider provider, void* user_data,
+                        VpAggregateResult* out_result, double* out_times,
+                        int out_times_capacity, int* out_sample_count);
+
+// Fills defaults: 50 ms budget, short side capped at 360 and auto downscale.
+void vp_default_deadline(VpDeadline* deadline);
+
+// Scores as many frames as fit in deadline->budget_ms, in progressive order:
+// first and last frame, midpoint, quarter points, and so on, so any prefix
+// covers the clip evenly. Before each frame the analyzer predicts its cost
+// and stops if that would overrun the budget (at least one frame is always
+// scored). Means are weighted by the span of frames each scored frame stands
+// for; motion blur uses each scored frame's predecessor. All frames of a
+// call share one downscale factor, so raw values are comparable within a
+// call but not with full-resolution results. out_report may be NULL.
+int vp_analyze_frames_deadline(VpAnalyzer* analyzer, const VpFrame* frames, int frame_count,
+                               const VpDeadline* deadline, VpAggregateResult* out_result,
+                               VpDeadlineReport* out_report);
+
+// Fills defaults: a 3 s window and equal weights.
+void vp_default_segment_query(VpSegmentQuery* query);
+
+// vp_analyze_frames that also finds the contiguous window with the highest
+// mean composite score, in the same pass and with memory for one window only.
+// A sequence shorter than the window yields the whole sequence. out_result
+// (may be NULL) receives the whole-clip aggregate.
+int vp_analyze_best_segment(VpAnalyzer* analyzer, const VpFrame* frames, int frame_count,
+                            const VpSegmentQuery* query, VpSegmentResult* out_segment,
+                            VpAggregateResult* out_result);
+
+// Computes the signature of a clip from its frames without scoring them
+// (a few row sums per frame for VP_SIGNATURE_HASHES frames), so it can be
+// looked up before deciding to analyze.
+int vp_compute_video_signature(const VpFrame* frames, int frame_count,
+                               VpVideoSignature* out_signature);
+
+// Signature of the frames of the last vp_analyze_frames* or
+// vp_analyze_frames_deadline call (over all frames up to max_frames, scored
+// or not). Returns VP_ERR_DECODE if no such call succeeded yet.
+int vp_get_video_signature(const VpAnalyzer* analyzer, VpVideoSignature* out_signature);
+
+VpSignatureIndex* vp_signature_index_create(void);
+
+// Adds a clip under a caller-chosen id (e.g. a row id of stored results).
+// Ids are not checked for uniqueness.
+int vp_signature_index_add(VpSignatureIndex* index, const VpVideoSignature* signature,
+                           uint64_t video_id);
+
+// Fills defaults: max_distance 10, min_match_ratio 0.75.
+void vp_default_signature_query(VpSignatureQuery* query);
+
+// Finds the indexed clip whose hashes match the most query hashes (ties go to
+// the lower total distance). Candidates are the clips sharing one of the four
+// 16-bit bands of a query hash, which every hash within distance 3 does; each
+// candidate is then checked against max_distance. out_match->found is 0 when
+// no clip reaches min_match_ratio. Cost grows with the number of candidates,
+// not with the size of the index. Returns VP_ERR_INVALID_ARGUMENT for a
+// negative max_distance or a min_match_ratio outside [0, 1].
+//
+// The index calls return VP_ERR_ALLOC when memory runs out; a failed add
+// leaves the index unchanged.
+int vp_signature_index_query(const VpSignatureIndex* index, const VpVideoSignature* signature,
+                             const VpSignatureQuery* query, VpSignatureMatch* out_match);
+
+int64_t vp_signature_index_size(const VpSignatureIndex* index);
+
+// Writes the index to a little-endian binary file; the band tables are
+// rebuilt on load. Load returns VP_ERR_IO for unreadable or truncated files
+// and VP_ERR_UNSUPPORTED for other format versions.
+int vp_signature_index_save(const VpSignatureIndex* index, const char* path);
+int vp_signature_index_load(const char* path, VpSignatureIndex** out_index);
+
+void vp_signature_index_destroy(VpSignatureIndex* index);
+
+VpCancelToken* vp_cancel_token_create(void);
+void vp_cancel_token_cancel(VpCancelToken* token);
+int vp_cancel_token_is_cancelled(const VpCancelToken* token);
+void vp_cancel_token_destroy(VpCancelToken* token);
+
+// Starts vp_analyze_frames_with_metrics on a background thread (frame_metrics
+// may be NULL with count 0). The frame and metric arrays are copied; the pixel
+// memory and metric values they point to must stay valid until completion.
+// The analyzer belongs to the task until then: other analyze calls on it
+// return VP_ERR_INVALID_ARGUMENT. The analysis checks `cancel` (may be NULL)
+// between frames and between the metrics of a frame; a cancelled task
+// completes with VP_ERR_CANCELLED and releases the analyzer's scratch memory.
+// Either callback may be NULL. On success *out_task must be released with
+// vp_task_destroy.
+int vp_analyze_frames_async(VpAnalyzer* analyzer, const VpFrame* frames, int frame_count,
+                            const VpFrameMetrics* frame_metrics, int frame_metrics_count,
+                            VpCancelToken* cancel, VpProgressCallback progress,
+                            VpCompletionCallback completion, void* user_data,
+                            VpAnalysisTask** out_task);
+
+int vp_task_poll(const VpAnalysisTask* task, VpTaskProgress* out_progress);
+
+// Cancels the task's token (the caller's token when one was passed).
+void vp_task_cancel(VpAnalysisTask* task);
+
+// Blocks until the task completes and returns its status; out_result (may be
+// NULL) receives the result on VP_OK. Must not be called from a callback.
+int vp_task_wait(VpAnalysisTask* task, VpAggregateResult* out_result);
+
+// Cancels the task if it is still running, waits for it and frees it. Must
+// not be called from a callback.
+void vp_task_destroy(VpAnalysisTask* task);
+
+// max_running 0, background_share 0.5, aging_ms 2000.
+void vp_default_scheduler_config(VpSchedulerConfig* config);
+
+// Starts the worker threads; NULL config uses the defaults. Returns NULL when
+// the threads cannot be started.
+VpScheduler* vp_scheduler_create(const VpSchedulerConfig* config);
+
+// Like vp_analyze_frames_async, but the analysis waits in the scheduler's
+// queue and runs on one of its workers. Interactive analyses are started
+// first; while one waits for a slot, a running background analysis pauses at
+// its next frame boundary and resumes later with its state intact. The
+// analyzer belongs to the task from submission, queued time included. A task
+// cancelled while queued or paused completes with VP_ERR_CANCELLED within a
+// few milliseconds. The returned task is used as any other: vp_task_poll,
+// vp_task_cancel, vp_task_wait and vp_task_destroy.
+int vp_scheduler_submit(VpScheduler* scheduler, VpPriority priority, VpAnalyzer* analyzer,
+                        const VpFrame* frames, int frame_count,
+                        const VpFrameMetrics* frame_metrics, int frame_metrics_count,
+                        VpCancelToken* cancel, VpProgressCallback progress,
+                        VpCompletionCallback completion, void* user_data,
+                        VpAnalysisTask** out_task);
+
+// Every task submitted to the scheduler must have been destroyed first.
+void vp_scheduler_destroy(VpScheduler* scheduler);
+
+// Returns VP_ERR_UNSUPPORTED unless VpConfig.grid_cols/grid_rows enabled the
+// grid, VP_ERR_DECODE if nothing has been analyzed yet.
+int vp_get_tile_grid(const VpAnalyzer* analyzer, VpTileGrid* out_grid);
+
+// Returns VP_ERR_DECODE if no analyzed frame computed exposure yet.
+int vp_get_exposure_stats(const VpAnalyzer* analyzer, VpExposureStats* out_stats);
+
+// Counters accumulate across analyze calls until vp_reset_stats.
+// Returns VP_ERR_UNSUPPORTED when the core was built with VP_ENABLE_STATS=0.
+int vp_get_stats(const VpAnalyzer* analyzer, VpStats* out_stats);
+
+int vp_reset_stats(VpAnalyzer* analyzer);
+
+// The analyzer keeps its working memory between calls (sized to the largest
+// frame seen) so repeated calls allocate nothing. Trims that scratch memory
+// down to at most keep_bytes; 0 releases it all. Returns
+// VP_ERR_INVALID_ARGUMENT while an async task owns the analyzer; like the
+// analyze calls it must not race a synchronous analysis on another thread.
+int vp_trim_scratch(VpAnalyzer* analyzer, uint64_t keep_bytes);
+
+// Writes the recorded timeline as Chrome trace JSON (open in Perfetto or
+// chrome://tracing). Returns VP_ERR_UNSUPPORTED when tracing is off. When
+// VP_TRACE holds a path instead of "1", vp_destroy writes the trace there.
+int vp_write_trace(const VpAnalyzer* analyzer, const char* path);
+
+// Destroy every task started on the analyzer first.
 void vp_destroy(VpAnalyzer* analyzer);
 
 #ifdef __cplusplus
@@ -0,0 +1,331 @@
+#include "vp_autotune.h"
+
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "vp_pixel_access.h"
+#include "vp_scratch.h"
+#include "vp_simd.h"
+#include "vp_stats.h"
+
+namespace vp {
+
+namespace {
+
+constexpr int kSamples = 5;
+constexpr double kMinSampleNs = 2e6;
+// A variant must beat the default by this much to replace it, so timing
+// noise does not flip the choice between runs.
+constexpr double kMinGain = 0.03;
+
+constexpr const char* kFormatNames[kPixelFormatCount] = {"gray8", "rgba8888", "bgra8888", "nv12",
+                                                          "i420"};
+constexpr const char* kVariantNames[kPipelineVariantCount] = {"per_metric", "banded"};
+
+std::string trim(const std::string& text) {
+  const size_t begin = text.find_first_not_of(" \t\r\n");
+  if (begin == std::string::npos) {
+    return std::string();
+  }
+  const size_t end = text.find_last_not_of(" \t\r\n");
+  return text.substr(begin, end - begin + 1);
+}
+
+// Value of the first "<field> : value" line of /proc/cpuinfo.
+std::string cpuinfo_field(const char* field) {
+  std::FILE* file = std::fopen("/proc/cpuinfo", "r");
+  if (!file) {
+    return std::string();
+  }
+  std::string value;
+  char line[512];
+  const size_t length = std::strlen(field);
+  while (std::fgets(line, sizeof(line), file)) {
+    const char* colon = std::strchr(line, ':');
+    if (colon && std::strncmp(line, field, length) == 0 &&
+        trim(std::string(line + length, static_cast<size_t>(colon - line) - length)).empty()) {
+      value = trim(colon + 1);
+      break;
+    }
+  }
+  std::fclose(file);
+  return value;
+}
+
+std::string cpu_model() {
+#if defined(__APPLE__)
+  for (const char* name : {"machdep.cpu.brand_string", "hw.machine"}) {
+    char buffer[256];
+    size_t size = sizeof(buffer);
+    if (sysctlbyname(name, buffer, &size, nullptr, 0) == 0 && size > 1) {
+      return std::string(buffer, strnlen(buffer, size));
+    }
+  }
+#else
+  std::string model = cpuinfo_field("model name");
+  if (!model.empty()) {
+    return model;
+  }
+  // ARM kernels (Android included) usually name the core by its part number.
+  const std::string implementer = cpuinfo_field("CPU implementer");
+  const std::string part = cpuinfo_field("CPU part");
+  if (!implementer.empty() && !part.empty()) {
+    return "arm " + implementer + ":" + part;
+  }
+  model = cpuinfo_field("Hardware");
+  if (!model.empty()) {
+    return model;
+  }
+#endif
+  return "unknown";
+}
+
+// Deterministic gradient with hashed noise, so the histogram and the edge
+// metrics see realistic value spreads rather than a flat frame.
+std::vector<uint8_t> synthetic_frame(VpPixelFormat format, int width, int height, VpFrame* out) {
+  const int channels = bytes_per_pixel(format);
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * channels * height);
+  uint8_t* pixel = pixels.data();
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint32_t hash = static_cast<uint32_t>(x) * 73856093u ^ static_cast<uint32_t>(y) * 19349663u;
+      hash ^= hash >> 13;
+      for (int c = 0; c < channels; ++c) {
+        *pixel++ = static_cast<uint8_t>((x * 3 + y * 5 + c * 40) / 8 + ((hash >> (c * 5)) & 31));
+      }
+    }
+  }
+  out->width = width;
+  out->height = height;
+  out->stride_bytes = width * channels;
+  out->format = format;
+  out->data = pixels.data();
+  return pixels;
+}
+
+// Nanoseconds per frame of the fastest sample of each variant. Samples
+// alternate between variants so clock changes hit both alike.
+void time_variants(VpPixelFormat format, int width, int height,
+                   double out_ns[kPipelineVariantCount]) {
+  VpFrame frame{};
+  const std::vector<uint8_t> pixels = synthetic_frame(format, width, height, &frame);
+  Stats stats;
+  ScratchArena arena;
+  LumaHistogram histogram{};
+  const PipelineContext context{&stats, nullptr, 0, nullptr, nullptr, ClipLevels{}, &histogram,
+                                nullptr, &arena};
+  const uint32_t mask = kAllBuiltinMetrics & ~metric_bit(VP_METRIC_MOTION_BLUR);
+  float raw[kBuiltinMetricCount] = {};
+
+  int calls[kPipelineVariantCount];
+  for (int variant = 0; variant < kPipelineVariantCount; ++variant) {
+    out_ns[variant] = std::numeric_limits<double>::max();
+    calls[variant] = 1;
+    // Warm-up: grows the scratch arena and faults the frame in.
+    select_pipeline(format, static_cast<PipelineVariant>(variant))(frame, nullptr, nullptr, mask,
+                                                                    raw, context);
+  }
+  for (int sample = 0; sample < kSamples; ++sample) {
+    for (int variant = 0; variant < kPipelineVariantCount; ++variant) {
+      const FramePipeline pipeline = select_pipeline(format, static_cast<PipelineVariant>(variant));
+      while (true) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int call = 0; call < calls[variant]; ++call) {
+          pipeline(frame, nullptr, nullptr, mask, raw, context);
+        }
+        const double elapsed =
+            std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+                .count();
+        if (elapsed >= kMinSampleNs) {
+          out_ns[variant] = std::min(out_ns[variant], elapsed / calls[variant]);
+          break;
+        }
+        calls[variant] *= 2;
+      }
+    }
+  }
+}
+
+PipelineVariant fastest_variant(VpPixelFormat format, int width, int height) {
+  double ns[kPipelineVariantCount];
+  time_variants(format, width, height, ns);
+  const PipelineVariant fallback = default_pipeline_variant(format);
+  PipelineVariant best = fallback;
+  for (int variant = 0; variant < kPipelineVariantCount; ++variant) {
+    if (ns[variant] < ns[static_cast<int>(best)] * (1.0 - kMinGain)) {
+      best = static_cast<PipelineVariant>(variant);
+    }
+  }
+  return best;
+}
+
+struct ProcessProfile {
+  std::mutex mutex;
+  bool valid = false;
+  TuningProfile profile;
+};
+
+ProcessProfile& process_profile() {
+  static ProcessProfile instance;
+  return instance;
+}
+
+} // namespace
+
+TuningProfile::TuningProfile() {
+  for (int format = 0; format < kPixelFormatCount; ++format) {
+    pipelines[format] = default_pipeline_variant(static_cast<VpPixelFormat>(format));
+  }
+}
+
+std::string cpu_profile_key() {
+#if defined(VP_SIMD_SSE2)
+  const char* simd = "sse2";
+#elif defined(VP_SIMD_NEON)
+  const char* simd = "neon";
+#else
+  const char* simd = "scalar";
+#endif
+  std::string key = cpu_model() + "/" + simd;
+  // Keeps the key usable as a section header.
+  std::replace(key.begin(), key.end(), '[', '(');
+  std::replace(key.begin(), key.end(), ']', ')');
+  return key;
+}
+
+TuningProfile calibrate_pipelines(int width, int height) {
+  TuningProfile profile;
+  const PipelineVariant luma = fastest_variant(VP_PIXEL_GRAY8, width, height);
+  const PipelineVariant packed = fastest_variant(VP_PIXEL_RGBA8888, width, height);
+  for (int format = 0; format < kPixelFormatCount; ++format) {
+    profile.pipelines[format] =
+        bytes_per_pixel(static_cast<VpPixelFormat>(format)) == 4 ? packed : luma;
+  }
+  return profile;
+}
+
+bool load_tuning_profile(const char* path, const std::string& key, TuningProfile* out) {
+  std::FILE* file = std::fopen(path, "r");
+  if (!file) {
+    return false;
+  }
+  TuningProfile profile;
+  bool in_section = false;
+  bool found = false;
+  char buffer[512];
+  while (std::fgets(buffer, sizeof(buffer), file)) {
+    const std::string line = trim(buffer);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    if (line[0] == '[') {
+      in_section = line.size() >= 2 && line.back() == ']' && line.substr(1, line.size() - 2) == key;
+      found = found || in_section;
+      continue;
+    }
+    if (!in_section) {
+      continue;
+    }
+    char format_name[32];
+    char variant_name[32];
+    if (std::sscanf(line.c_str(), "%31s %31s", format_name, variant_name) != 2) {
+      continue;
+    }
+    for (int format = 0; format < kPixelFormatCount; ++format) {
+      for (int variant = 0; variant < kPipelineVariantCount; ++variant) {
+        if (std::strcmp(format_name, kFormatNames[format]) == 0 &&
+            std::strcmp(variant_name, kVariantNames[variant]) == 0) {
+          profile.pipelines[format] = static_cast<PipelineVariant>(variant);
+        }
+      }
+    }
+  }
+  std::fclose(file);
+  if (found) {
+    *out = profile;
+  }
+  return found;
+}
+
+bool save_tuning_profile(const char* path, const std::string& key, const TuningProfile& profile) {
+  // Other CPUs' sections are carried over verbatim.
+  std::vector<std::string> kept;
+  if (std::FILE* existing = std::fopen(path, "r")) {
+    bool skipping = false;
+    char buffer[512];
+    while (std::fgets(buffer, sizeof(buffer), existing)) {
+      const std::string line = trim(buffer);
+      if (!line.empty() && line[0] == '[') {
+        skipping = line == "[" + key + "]";
+      }
+      if (!skipping && !line.empty() && line[0] != '#') {
+        kept.push_back(line);
+      }
+    }
+    std::fclose(existing);
+  }
+
+  const std::string temp_path = std::string(path) + ".tmp" + std::to_string(getpid());
+  std::FILE* file = std::fopen(temp_path.c_str(), "w");
+  if (!file) {
+    return false;
+  }
+  std::fprintf(file, "# VideoPicker tuning profile: one [cpu/simd] section per host type.\n");
+  for (const std::string& line : kept) {
+    std::fprintf(file, "%s\n", line.c_str());
+  }
+  std::fprintf(file, "[%s]\n", key.c_str());
+  for (int format = 0; format < kPixelFormatCount; ++format) {
+    std::fprintf(file, "%s %s\n", kFormatNames[format],
+                 kVariantNames[static_cast<int>(profile.pipelines[format])]);
+  }
+  if (std::fclose(file) != 0 || std::rename(temp_path.c_str(), path) != 0) {
+    std::remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+TuningProfile resolve_tuning_profile(const char* path, bool calibrate_if_missing) {
+  ProcessProfile& process = process_profile();
+  // Held through a calibration, so concurrent vp_create calls run it once.
+  std::lock_guard<std::mutex> lock(process.mutex);
+  if (process.valid) {
+    return process.profile;
+  }
+  if (!path || path[0] == '\0') {
+    return TuningProfile();
+  }
+  const std::string key = cpu_profile_key();
+  TuningProfile profile;
+  if (!load_tuning_profile(path, key, &profile)) {
+    if (!calibrate_if_missing) {
+      return TuningProfile();
+    }
+    profile = calibrate_pipelines(kCalibrationWidth, kCalibrationHeight);
+    // Failing to save only means the next process calibrates again.
+    save_tuning_profile(path, key, profile);
+  }
+  process.profile = profile;
+  process.valid = true;
+  return profile;
+}
+
+void set_process_tuning_profile(const TuningProfile& profile) {
+  ProcessProfile& process = process_profile();
+  std::lock_guard<std::mutex> lock(process.mutex);
+  process.profile = profile;
+  process.valid = true;
+}
+
+} // namespace vp
@@ -0,0 +1,51 @@
+#ifndef VP_AUTOTUNE_H
+#define VP_AUTOTUNE_H
+
+#include <string>
+
+#include "vp_pipeline.h"
+
+namespace vp {
+
+// Frame size calibrated on when none is given.
+constexpr int kCalibrationWidth = 1280;
+constexpr int kCalibrationHeight = 720;
+
+// Kernel choices that do not change results, picked per CPU.
+struct TuningProfile {
+  PipelineVariant pipelines[kPixelFormatCount];
+
+  TuningProfile();
+};
+
+// Identifies the CPU and the SIMD flavour of this build, e.g.
+// "Intel(R) Xeon(R) CPU @ 2.20GHz/sse2". Profiles are stored under this key.
+std::string cpu_profile_key();
+
+// Times every pipeline variant on synthetic width x height frames and keeps
+// the fastest per format. The luma formats share one measurement, as do the
+// two packed RGB orders, since they run the same code.
+TuningProfile calibrate_pipelines(int width, int height);
+
+// A profile file holds one "[key]" section per CPU followed by
+// "<format> <variant>" lines. Returns false without the file or the key's
+// section; unknown lines are ignored.
+bool load_tuning_profile(const char* path, const std::string& key, TuningProfile* out);
+
+// Replaces or adds the key's section and keeps the others. The file is
+// rewritten through a temporary and renamed into place.
+bool save_tuning_profile(const char* path, const std::string& key, const TuningProfile& profile);
+
+// Process-wide profile, shared by every analyzer created afterwards. Once
+// set by vp_autotune or a successful load it is not read again.
+// Without one, `path` (config or VP_TUNING_PROFILE) is loaded; when it lacks
+// this CPU and `calibrate_if_missing` is set, the calibration runs and is
+// saved there. Falls back to the defaults.
+TuningProfile resolve_tuning_profile(const char* path, bool calibrate_if_missing);
+
+// Makes `profile` the process-wide profile.
+void set_process_tuning_profile(const TuningProfile& profile);
+
+} // namespace vp
+
+#endif // VP_AUTOTUNE_H
@@ -0,0 +1,270 @@
+#include "vp_avio.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+namespace vp {
+
+namespace {
+
+// Resolves an AVIO seek request against a stream of `size` bytes; returns
+// the target position, or a negative AVERROR.
+int64_t seek_target(int64_t position, int64_t size, int64_t offset, int whence) {
+  int64_t target;
+  switch (whence & ~AVSEEK_FORCE) {
+    case SEEK_SET:
+      target = offset;
+      break;
+    case SEEK_CUR:
+      target = position + offset;
+      break;
+    case SEEK_END:
+      target = size + offset;
+      break;
+    default:
+      return AVERROR(EINVAL);
+  }
+  if (target < 0 || target > size) {
+    return AVERROR(EINVAL);
+  }
+  return target;
+}
+
+int read_packet(void* opaque, uint8_t* buffer, int size) {
+  return static_cast<IoBackend*>(opaque)->read(buffer, size);
+}
+
+int64_t seek_packet(void* opaque, int64_t offset, int whence) {
+  return static_cast<IoBackend*>(opaque)->seek(offset, whence);
+}
+
+} // namespace
+
+MemoryIo::~MemoryIo() {
+  if (mapping_) {
+    munmap(mapping_, size_);
+  }
+}
+
+bool MemoryIo::map_file(const char* path) {
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+  void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  // Demuxing walks the file front to back; let the kernel read ahead.
+  madvise(mapping, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+  mapping_ = mapping;
+  data_ = static_cast<const uint8_t*>(mapping);
+  size_ = static_cast<size_t>(info.st_size);
+  position_ = 0;
+  return true;
+}
+
+int MemoryIo::read(uint8_t* buffer, int size) {
+  if (position_ >= size_) {
+    return AVERROR_EOF;
+  }
+  size_t count = std::min(static_cast<size_t>(std::max(size, 0)), size_ - position_);
+  std::memcpy(buffer, data_ + position_, count);
+  position_ += count;
+  return static_cast<int>(count);
+}
+
+int64_t MemoryIo::seek(int64_t offset, int whence) {
+  if (whence == AVSEEK_SIZE) {
+    return static_cast<int64_t>(size_);
+  }
+  int64_t target = seek_target(static_cast<int64_t>(position_), static_cast<int64_t>(size_),
+                               offset, whence);
+  if (target >= 0) {
+    position_ = static_cast<size_t>(target);
+  }
+  return target;
+}
+
+ReadAheadIo::~ReadAheadIo() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+bool ReadAheadIo::open(const char* path) {
+  fd_ = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd_, &info) != 0) {
+    return false;
+  }
+  size_ = static_cast<int64_t>(info.st_size);
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+  ring_.resize(static_cast<size_t>(kChunks * kChunkBytes));
+  try {
+    thread_ = std::thread(&ReadAheadIo::prefetch, this);
+  } catch (const std::system_error&) {
+    return false;
+  }
+  return true;
+}
+
+void ReadAheadIo::prefetch() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    const int64_t chunk = next_chunk_;
+    const int64_t offset = chunk * kChunkBytes;
+    if (error_ != 0 || offset >= size_ || chunk >= position_ / kChunkBytes + kChunks) {
+      changed_.wait(lock);
+      continue;
+    }
+    // The slot's previous chunk lies behind the reader; invalidate it before
+    // overwriting so a backward seek cannot pick it up mid-read.
+    Slot& slot = slots_[chunk % kChunks];
+    slot.chunk = -1;
+    const uint64_t generation = generation_;
+    uint8_t* destination = ring_.data() + (chunk % kChunks) * kChunkBytes;
+    const int64_t wanted = std::min(kChunkBytes, size_ - offset);
+    lock.unlock();
+
+    int64_t length = 0;
+    int error = 0;
+    while (length < wanted) {
+      ssize_t count = pread(fd_, destination + length, static_cast<size_t>(wanted - length),
+                            static_cast<off_t>(offset + length));
+      if (count < 0 && errno == EINTR) {
+        continue;
+      }
+      if (count < 0) {
+        error = errno;
+        break;
+      }
+      if (count == 0) {
+        break;
+      }
+      length += count;
+    }
+
+    lock.lock();
+    if (generation != generation_) {
+      continue;
+    }
+    if (error != 0) {
+      error_ = error;
+    } else {
+      slot.chunk = chunk;
+      slot.length = length;
+      ++next_chunk_;
+    }
+    changed_.notify_all();
+  }
+}
+
+void ReadAheadIo::restart_at(int64_t chunk) {
+  ++generation_;
+  next_chunk_ = chunk;
+  error_ = 0;
+  for (Slot& slot : slots_) {
+    slot.chunk = -1;
+  }
+}
+
+int ReadAheadIo::read(uint8_t* buffer, int size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (position_ >= size_) {
+    return AVERROR_EOF;
+  }
+  const int64_t chunk = position_ / kChunkBytes;
+  const Slot& slot = slots_[chunk % kChunks];
+  changed_.wait(lock, [&] { return slot.chunk == chunk || error_ != 0 || stop_; });
+  if (slot.chunk != chunk) {
+    return error_ != 0 ? AVERROR(error_) : AVERROR_EXIT;
+  }
+  const int64_t within = position_ - chunk * kChunkBytes;
+  if (within >= slot.length) {
+    // The file shrank after open().
+    return AVERROR_EOF;
+  }
+  const int64_t count = std::min(static_cast<int64_t>(std::max(size, 0)), slot.length - within);
+  std::memcpy(buffer, ring_.data() + (chunk % kChunks) * kChunkBytes + within,
+              static_cast<size_t>(count));
+  position_ += count;
+  if (position_ / kChunkBytes != chunk) {
+    // A slot became free.
+    changed_.notify_all();
+  }
+  return static_cast<int>(count);
+}
+
+int64_t ReadAheadIo::seek(int64_t offset, int whence) {
+  if (whence == AVSEEK_SIZE) {
+    return size_;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int64_t target = seek_target(position_, size_, offset, whence);
+  if (target < 0) {
+    return target;
+  }
+  position_ = target;
+  const int64_t chunk = target / kChunkBytes;
+  if (slots_[chunk % kChunks].chunk != chunk && chunk != next_chunk_) {
+    restart_at(chunk);
+  }
+  changed_.notify_all();
+  return target;
+}
+
+AVIOContext* create_avio_context(IoBackend* backend) {
+  uint8_t* buffer = static_cast<uint8_t*>(av_malloc(kAvioBufferBytes));
+  if (!buffer) {
+    return nullptr;
+  }
+  AVIOContext* context =
+      avio_alloc_context(buffer, kAvioBufferBytes, 0, backend, &read_packet, nullptr, &seek_packet);
+  if (!context) {
+    av_free(buffer);
+  }
+  return context;
+}
+
+void free_avio_context(AVIOContext** context) {
+  if (*context) {
+    // avio may have replaced the buffer it was given.
+    av_freep(&(*context)->buffer);
+    avio_context_free(context);
+  }
+}
+
+} // namespace vp
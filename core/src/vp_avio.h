@@ -0,0 +1,107 @@
+#ifndef VP_AVIO_H
+#define VP_AVIO_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avio.h>
+}
+
+namespace vp {
+
+// Byte source behind the decoder's custom AVIOContext. The callbacks follow
+// AVIOContext conventions: read returns the byte count or a negative AVERROR
+// (AVERROR_EOF at the end), seek takes SEEK_SET/SEEK_CUR/SEEK_END or
+// AVSEEK_SIZE and returns the new position (or the total size).
+class IoBackend {
+ public:
+  virtual ~IoBackend() = default;
+  virtual int read(uint8_t* buffer, int size) = 0;
+  virtual int64_t seek(int64_t offset, int whence) = 0;
+};
+
+// Serves bytes straight out of memory: either a caller buffer (not owned,
+// must outlive the decoder) or a private read-only mapping of a file. Reads
+// are a memcpy into the AVIO buffer with no system call.
+class MemoryIo : public IoBackend {
+ public:
+  MemoryIo(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+  MemoryIo() = default;
+  ~MemoryIo() override;
+
+  MemoryIo(const MemoryIo&) = delete;
+  MemoryIo& operator=(const MemoryIo&) = delete;
+
+  bool map_file(const char* path);
+
+  int read(uint8_t* buffer, int size) override;
+  int64_t seek(int64_t offset, int whence) override;
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  size_t position_ = 0;
+  void* mapping_ = nullptr;
+};
+
+// Reads a file through a background thread that prefetches chunk-aligned
+// kChunkBytes blocks into a ring of kChunks slots, up to kChunks chunks ahead
+// of the demuxer, so avformat's small reads are served from memory while the
+// next chunks are in flight. A seek that lands in a chunk already fetched (or
+// about to be) keeps the ring; any other seek restarts prefetching there.
+class ReadAheadIo : public IoBackend {
+ public:
+  static constexpr int64_t kChunkBytes = int64_t{1} << 20;
+  static constexpr int kChunks = 8;
+
+  ReadAheadIo() = default;
+  ~ReadAheadIo() override;
+
+  ReadAheadIo(const ReadAheadIo&) = delete;
+  ReadAheadIo& operator=(const ReadAheadIo&) = delete;
+
+  bool open(const char* path);
+
+  int read(uint8_t* buffer, int size) override;
+  int64_t seek(int64_t offset, int whence) override;
+
+ private:
+  struct Slot {
+    int64_t chunk = -1;
+    int64_t length = 0;
+  };
+
+  void prefetch();
+  void restart_at(int64_t chunk);
+
+  int fd_ = -1;
+  int64_t size_ = 0;
+  std::vector<uint8_t> ring_;
+  Slot slots_[kChunks];
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  // Consumer position; the prefetcher stays within kChunks chunks of it.
+  int64_t position_ = 0;
+  int64_t next_chunk_ = 0;
+  // Bumped by restarts so a read finishing after one is discarded.
+  uint64_t generation_ = 0;
+  int error_ = 0;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+// Wraps `backend` (not owned) in an AVIOContext with a buffer of
+// kAvioBufferBytes; release with free_avio_context().
+constexpr int kAvioBufferBytes = 256 * 1024;
+AVIOContext* create_avio_context(IoBackend* backend);
+void free_avio_context(AVIOContext** context);
+
+} // namespace vp
+
+#endif // VP_AVIO_H
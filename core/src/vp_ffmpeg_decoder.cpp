@@ -1,16 +1,21 @@
 #include "vp_ffmpeg_decoder.h"
 
 #include <algorithm>
+#include <utility>
 
 namespace vp {
 
 FfmpegDecoder::FfmpegDecoder()
-    : format_context_(nullptr),
+    : avio_context_(nullptr),
+      format_context_(nullptr),
       codec_context_(nullptr),
       frame_(av_frame_alloc()),
       packet_(av_packet_alloc()),
       sws_context_(nullptr),
-      video_stream_index_(-1) {}
+      video_stream_index_(-1),
+      has_read_(false),
+      stats_(nullptr),
+      tracer_(nullptr) {}
 
 FfmpegDecoder::~FfmpegDecoder() {
   if (sws_context_) {
@@ -22,6 +27,9 @@ FfmpegDecoder::~FfmpegDecoder() {
   if (format_context_) {
     avformat_close_input(&format_context_);
   }
+  // AVFMT_FLAG_CUSTOM_IO leaves the AVIOContext to us; it must outlive the
+  // format context.
+  free_avio_context(&avio_context_);
   if (frame_) {
     av_frame_free(&frame_);
   }
@@ -30,10 +38,54 @@ FfmpegDecoder::~FfmpegDecoder() {
   }
 }
 
-int FfmpegDecoder::open(const char* path) {
+int FfmpegDecoder::open(const char* path, IoMode mode) {
+  if (mode == IoMode::kMemoryMap) {
+    auto io = std::make_unique<MemoryIo>();
+    if (!io->map_file(path)) {
+      return -1;
+    }
+    return open_custom(std::move(io));
+  }
+  if (mode == IoMode::kReadAhead) {
+    auto io = std::make_unique<ReadAheadIo>();
+    if (!io->open(path)) {
+      return -1;
+    }
+    return open_custom(std::move(io));
+  }
   if (avformat_open_input(&format_context_, path, nullptr, nullptr) < 0) {
     return -1;
   }
+  return open_codec();
+}
+
+int FfmpegDecoder::open_memory(const uint8_t* data, size_t size) {
+  if (!data || size == 0) {
+    return -1;
+  }
+  return open_custom(std::make_unique<MemoryIo>(data, size));
+}
+
+int FfmpegDecoder::open_custom(std::unique_ptr<IoBackend> io) {
+  io_ = std::move(io);
+  avio_context_ = create_avio_context(io_.get());
+  if (!avio_context_) {
+    return -1;
+  }
+  format_context_ = avformat_alloc_context();
+  if (!format_context_) {
+    return -1;
+  }
+  format_context_->pb = avio_context_;
+  format_context_->flags |= AVFMT_FLAG_CUSTOM_IO;
+  // On failure avformat_open_input frees the context and nulls the pointer.
+  if (avformat_open_input(&format_context_, nullptr, nullptr, nullptr) < 0) {
+    return -1;
+  }
+  return open_codec();
+}
+
+int FfmpegDecoder::open_codec() {
   if (avformat_find_stream_info(format_context_, nullptr) < 0) {
     return -1;
   }
@@ -47,6 +99,13 @@ int FfmpegDecoder::open(const char* path) {
   if (video_stream_index_ < 0) {
     return -1;
   }
+  // Let the demuxer drop audio/subtitle/data packets instead of returning
+  // them only to be skipped in decode().
+  for (unsigned int i = 0; i < format_context_->nb_streams; ++i) {
+    if (static_cast<int>(i) != video_stream_index_) {
+      format_context_->streams[i]->discard = AVDISCARD_ALL;
+    }
+  }
 
   AVCodecParameters* codec_params = format_context_->streams[video_stream_index_]->codecpar;
   const AVCodec* codec = avcodec_find_decoder(codec_params->codec_id);
@@ -63,6 +122,14 @@ int FfmpegDecoder::open(const char* path) {
     return -1;
   }
 
+  if (options_.keyframes_only) {
+    codec_context_->skip_frame = AVDISCARD_NONKEY;
+  }
+  if (options_.skip_loop_filter) {
+    codec_context_->skip_loop_filter = AVDISCARD_ALL;
+  }
+  codec_context_->lowres = std::max(0, std::min(options_.lowres, static_cast<int>(codec->max_lowres)));
+
   if (avcodec_open2(codec_context_, codec, nullptr) < 0) {
     return -1;
   }
@@ -89,15 +156,20 @@ int FfmpegDecoder::decode(float fps, int max_frames, float start_time_sec,
 
   AVRational time_base = format_context_->streams[video_stream_index_]->time_base;
 
-  if (start_time_sec > 0.0f) {
+  if (start_time_sec > 0.0f || has_read_) {
     int64_t seek_target = static_cast<int64_t>(start_time_sec / av_q2d(time_base));
     if (av_seek_frame(format_context_, video_stream_index_, seek_target, AVSEEK_FLAG_BACKWARD) >= 0) {
       avcodec_flush_buffers(codec_context_);
     }
   }
 
+  StageTimer decode_timer;
+  uint64_t decode_start_ns = tracer_ ? monotonic_ns() : 0;
+
   while (av_read_frame(format_context_, packet_) >= 0) {
-    if (packet_->stream_index != video_stream_index_) {
+    has_read_ = true;
+    if (packet_->stream_index != video_stream_index_ ||
+        (options_.keyframes_only && !(packet_->flags & AV_PKT_FLAG_KEY))) {
       av_packet_unref(packet_);
       continue;
     }
@@ -121,26 +193,45 @@ int FfmpegDecoder::decode(float fps, int max_frames, float start_time_sec,
 
       int width = frame_->width;
       int height = frame_->height;
+      uint64_t pixel_count = static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+      if (stats_) {
+        stats_->add_stage(VP_STAGE_DECODE, 1, pixel_count, 0, decode_timer.stop());
+      }
+      if (tracer_) {
+        tracer_->record("decode", "decoder", decode_start_ns, monotonic_ns() - decode_start_ns,
+                        sampled_frames);
+      }
+
+      DecodedFrame decoded;
+      {
+        TraceScope convert_trace(tracer_, "convert", "decoder", sampled_frames);
+        StageTimer convert_timer;
 
-      if (!sws_context_) {
-        sws_context_ = sws_getContext(width, height, static_cast<AVPixelFormat>(frame_->format),
-                                      width, height, AV_PIX_FMT_GRAY8, SWS_BILINEAR, nullptr, nullptr, nullptr);
         if (!sws_context_) {
-          av_frame_unref(frame_);
-          return -1;
+          sws_context_ = sws_getContext(width, height, static_cast<AVPixelFormat>(frame_->format),
+                                        width, height, AV_PIX_FMT_GRAY8, SWS_BILINEAR, nullptr, nullptr, nullptr);
+          if (!sws_context_) {
+            av_frame_unref(frame_);
+            return -1;
+          }
         }
-      }
 
-      DecodedFrame decoded;
-      decoded.width = width;
-      decoded.height = height;
-      decoded.stride = width;
-      decoded.gray.resize(static_cast<size_t>(width * height));
+        decoded.width = width;
+        decoded.height = height;
+        decoded.stride = width;
+        decoded.gray.resize(static_cast<size_t>(width * height));
+        if (stats_) {
+          stats_->add_allocation(VP_STAGE_CONVERT);
+        }
 
-      uint8_t* dest_data[4] = { decoded.gray.data(), nullptr, nullptr, nullptr };
-      int dest_linesize[4] = { width, 0, 0, 0 };
+        uint8_t* dest_data[4] = { decoded.gray.data(), nullptr, nullptr, nullptr };
+        int dest_linesize[4] = { width, 0, 0, 0 };
 
-      sws_scale(sws_context_, frame_->data, frame_->linesize, 0, height, dest_data, dest_linesize);
+        sws_scale(sws_context_, frame_->data, frame_->linesize, 0, height, dest_data, dest_linesize);
+        if (stats_) {
+          stats_->add_stage(VP_STAGE_CONVERT, 1, pixel_count, pixel_count, convert_timer.stop());
+        }
+      }
 
       on_frame(decoded);
       ++sampled_frames;
@@ -151,10 +242,33 @@ int FfmpegDecoder::decode(float fps, int max_frames, float start_time_sec,
       if (sampled_frames >= max_frames) {
         return 0;
       }
+      decode_timer = StageTimer();
+      if (tracer_) {
+        decode_start_ns = monotonic_ns();
+      }
     }
   }
 
   return 0;
 }
 
+int FfmpegDecoder::decode_at(double time_sec,
+                             const std::function<void(const DecodedFrame&)>& on_frame) {
+  return decode(1.0f, 1, static_cast<float>(std::max(0.0, time_sec)), on_frame);
+}
+
+double FfmpegDecoder::duration_sec() const {
+  if (!format_context_) {
+    return 0.0;
+  }
+  const AVStream* stream = format_context_->streams[video_stream_index_];
+  if (stream->duration != AV_NOPTS_VALUE) {
+    return static_cast<double>(stream->duration) * av_q2d(stream->time_base);
+  }
+  if (format_context_->duration != AV_NOPTS_VALUE) {
+    return static_cast<double>(format_context_->duration) / AV_TIME_BASE;
+  }
+  return 0.0;
+}
+
 } // namespace vp
@@ -2,6 +2,7 @@
 #define VP_FFMPEG_DECODER_H
 
 #include <functional>
+#include <memory>
 #include <vector>
 
 extern "C" {
@@ -10,6 +11,10 @@ extern "C" {
 #include <libswscale/swscale.h>
 }
 
+#include "vp_avio.h"
+#include "vp_stats.h"
+#include "vp_trace.h"
+
 namespace vp {
 
 struct DecodedFrame {
@@ -24,16 +29,64 @@ class FfmpegDecoder {
   FfmpegDecoder();
   ~FfmpegDecoder();
 
-  int open(const char* path);
+  // How open() reads the container. kDefault lets avformat use its own file
+  // protocol; kMemoryMap maps the file and serves reads without system calls;
+  // kReadAhead prefetches the file on a background thread (see vp_avio.h).
+  enum class IoMode { kDefault, kMemoryMap, kReadAhead };
+
+  // Cheaper decoding for a quick pre-scan; all off means full quality. Set
+  // before open().
+  struct DecodeOptions {
+    // Decode keyframes only (non-key packets are dropped before the decoder).
+    bool keyframes_only = false;
+    // Skip the in-loop deblocking filter; edges get slightly blockier.
+    bool skip_loop_filter = false;
+    // Decode at 1/2^lowres resolution, clamped to what the codec supports
+    // (0 for most modern codecs).
+    int lowres = 0;
+  };
+
+  int open(const char* path, IoMode mode = IoMode::kDefault);
+  // Demuxes an in-memory container; `data` is not copied and must outlive the
+  // decoder.
+  int open_memory(const uint8_t* data, size_t size);
   int decode(float fps, int max_frames, float start_time_sec, const std::function<void(const DecodedFrame&)>& on_frame);
+  // Seeks and delivers the first frame at or after time_sec, for random-access
+  // consumers such as a VpFrameProvider driving vp_analyze_adaptive.
+  int decode_at(double time_sec, const std::function<void(const DecodedFrame&)>& on_frame);
+  // Container duration in seconds, or 0 when unknown.
+  double duration_sec() const;
+
+  // Optional sink for decode/convert counters; not owned.
+  void set_stats(Stats* stats) { stats_ = stats; }
+  // Optional timeline sink for decode/convert events; not owned.
+  void set_tracer(Tracer* tracer) { tracer_ = tracer; }
+  // Reports decode/convert into the counters and timeline of `analyzer`, which
+  // must outlive the decoder or be detached with attach(nullptr).
+  void attach(VpAnalyzer* analyzer) {
+    set_stats(analyzer_stats(analyzer));
+    set_tracer(analyzer_tracer(analyzer));
+  }
+  void set_decode_options(const DecodeOptions& options) { options_ = options; }
 
  private:
+  int open_custom(std::unique_ptr<IoBackend> io);
+  int open_codec();
+
+  // Custom byte source for kMemoryMap/kReadAhead/open_memory; null otherwise.
+  std::unique_ptr<IoBackend> io_;
+  AVIOContext* avio_context_;
   AVFormatContext* format_context_;
   AVCodecContext* codec_context_;
   AVFrame* frame_;
   AVPacket* packet_;
   SwsContext* sws_context_;
   int video_stream_index_;
+  // Set once packets have been read, so later calls must seek even to 0.
+  bool has_read_;
+  Stats* stats_;
+  Tracer* tracer_;
+  DecodeOptions options_;
 };
 
 } // namespace vp
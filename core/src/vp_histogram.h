@@ -0,0 +1,108 @@
+#ifndef VP_HISTOGRAM_H
+#define VP_HISTOGRAM_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "vp_analyzer.h"
+#include "vp_pixel_access.h"
+
+namespace vp {
+
+constexpr int kHistogramBins = 256;
+constexpr int kHistogramBanks = 4;
+
+// Luma at or below `low` / at or above `high` counts as clipped.
+struct ClipLevels {
+  int low = 5;
+  int high = 250;
+};
+
+// One frame's 256-bin luma histogram. Frames stay well below 2^32 pixels.
+struct LumaHistogram {
+  uint32_t bins[kHistogramBins];
+  uint32_t total;
+};
+
+// Counts are spread over kHistogramBanks interleaved sub-histograms (pixel x
+// goes to bank x % 4), so a run of equal values, as in flat or clipped
+// regions, updates four independent counters instead of serializing on one
+// counter's store-to-load dependency. SSE2 and NEON have no scatter, so the
+// 1-byte formats load eight pixels per 64-bit word and split it in registers.
+class HistogramBanks {
+ public:
+  HistogramBanks() { clear(); }
+
+  void clear() { std::memset(counts_, 0, sizeof(counts_)); }
+
+  template <class Access>
+  void add_row(const uint8_t* row, int x0, int x1) {
+    int x = x0;
+    if (Access::kBytesPerPixel == 1) {
+      for (; x + 8 <= x1; x += 8) {
+        uint64_t word;
+        std::memcpy(&word, row + x, sizeof(word));
+        ++counts_[0][word & 0xff];
+        ++counts_[1][(word >> 8) & 0xff];
+        ++counts_[2][(word >> 16) & 0xff];
+        ++counts_[3][(word >> 24) & 0xff];
+        ++counts_[0][(word >> 32) & 0xff];
+        ++counts_[1][(word >> 40) & 0xff];
+        ++counts_[2][(word >> 48) & 0xff];
+        ++counts_[3][word >> 56];
+      }
+    } else {
+      for (; x + 4 <= x1; x += 4) {
+        ++counts_[0][Access::luma(row, x)];
+        ++counts_[1][Access::luma(row, x + 1)];
+        ++counts_[2][Access::luma(row, x + 2)];
+        ++counts_[3][Access::luma(row, x + 3)];
+      }
+    }
+    for (; x < x1; ++x) {
+      ++counts_[0][Access::luma(row, x)];
+    }
+  }
+
+  // Like add_row, and also returns how many values have a non-zero `lut`
+  // entry, for per-tile counts without a second pass.
+  template <class Access>
+  uint32_t add_row_counting(const uint8_t* row, int x0, int x1, const uint8_t* lut) {
+    uint32_t hits = 0;
+    for (int x = x0; x < x1; ++x) {
+      int value = Access::luma(row, x);
+      ++counts_[x & (kHistogramBanks - 1)][value];
+      hits += lut[value];
+    }
+    return hits;
+  }
+
+  // Number of counted values in [first, last].
+  uint32_t count_range(int first, int last) const {
+    uint32_t total = 0;
+    for (int bin = first; bin <= last; ++bin) {
+      total += counts_[0][bin] + counts_[1][bin] + counts_[2][bin] + counts_[3][bin];
+    }
+    return total;
+  }
+
+  void merge_into(LumaHistogram* out) const {
+    uint32_t total = 0;
+    for (int bin = 0; bin < kHistogramBins; ++bin) {
+      uint32_t count = counts_[0][bin] + counts_[1][bin] + counts_[2][bin] + counts_[3][bin];
+      out->bins[bin] = count;
+      total += count;
+    }
+    out->total = total;
+  }
+
+ private:
+  uint32_t counts_[kHistogramBanks][kHistogramBins];
+};
+
+// Brightness statistics of a histogram summed over frames.
+void summarize_histogram(const uint64_t* bins, const ClipLevels& levels, VpExposureStats* out);
+
+} // namespace vp
+
+#endif // VP_HISTOGRAM_H
@@ -1,7 +1,6 @@
 #include "vp_metrics.h"
 
-#include <algorithm>
-#include <cmath>
+#include "vp_metric_kernels.h"
 
 namespace vp {
 
@@ -18,168 +17,38 @@ float normalize_score(float raw, const VpThreshold& threshold) {
   return t;
 }
 
-static inline int clamp_index(int value, int min, int max) {
-  return std::max(min, std::min(value, max));
-}
-
 float compute_sharpness(const GrayFrame& frame) {
-  const int width = frame.width;
-  const int height = frame.height;
-  const int stride = frame.stride;
-  const uint8_t* data = frame.data;
-
-  double sum = 0.0;
-  double sum_sq = 0.0;
-  int count = 0;
-
-  for (int y = 1; y < height - 1; ++y) {
-    const uint8_t* row = data + y * stride;
-    const uint8_t* row_prev = data + (y - 1) * stride;
-    const uint8_t* row_next = data + (y + 1) * stride;
-    for (int x = 1; x < width - 1; ++x) {
-      int center = row[x];
-      int lap = -4 * center + row[x - 1] + row[x + 1] + row_prev[x] + row_next[x];
-      double value = static_cast<double>(lap);
-      sum += value;
-      sum_sq += value * value;
-      ++count;
-    }
-  }
-
-  if (count == 0) {
-    return 0.0f;
-  }
-
-  double mean = sum / static_cast<double>(count);
-  double variance = (sum_sq / static_cast<double>(count)) - (mean * mean);
-  if (variance < 0.0) {
-    variance = 0.0;
-  }
-  return static_cast<float>(variance);
+  return sharpness_kernel(Gray8Access(frame));
 }
 
 float compute_exposure_clipping(const GrayFrame& frame) {
-  const int width = frame.width;
-  const int height = frame.height;
-  const int stride = frame.stride;
-  const uint8_t* data = frame.data;
-
-  const int low_threshold = 5;
-  const int high_threshold = 250;
-
-  int clipped = 0;
-  int total = width * height;
-
-  for (int y = 0; y < height; ++y) {
-    const uint8_t* row = data + y * stride;
-    for (int x = 0; x < width; ++x) {
-      int value = row[x];
-      if (value <= low_threshold || value >= high_threshold) {
-        ++clipped;
-      }
-    }
-  }
-
-  if (total == 0) {
-    return 0.0f;
-  }
-  return static_cast<float>(clipped) / static_cast<float>(total);
+  return exposure_kernel(Gray8Access(frame), ClipLevels{}, nullptr);
 }
 
 float compute_noise_estimate(const GrayFrame& frame) {
-  const int width = frame.width;
-  const int height = frame.height;
-  const int stride = frame.stride;
-  const uint8_t* data = frame.data;
-
-  double accum = 0.0;
-  int count = 0;
-
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      int sum = 0;
-      int samples = 0;
-      for (int dy = -1; dy <= 1; ++dy) {
-        int yy = clamp_index(y + dy, 0, height - 1);
-        const uint8_t* row = data + yy * stride;
-        for (int dx = -1; dx <= 1; ++dx) {
-          int xx = clamp_index(x + dx, 0, width - 1);
-          sum += row[xx];
-          ++samples;
-        }
-      }
-      float mean = static_cast<float>(sum) / static_cast<float>(samples);
-      float diff = std::abs(static_cast<float>(data[y * stride + x]) - mean);
-      accum += diff;
-      ++count;
-    }
-  }
-
-  if (count == 0) {
-    return 0.0f;
-  }
-  return static_cast<float>(accum / static_cast<double>(count)) / 255.0f;
-}
-
-static float compute_edge_strength(const GrayFrame& frame) {
-  const int width = frame.width;
-  const int height = frame.height;
-  const int stride = frame.stride;
-  const uint8_t* data = frame.data;
-
-  double accum = 0.0;
-  int count = 0;
-
-  for (int y = 1; y < height - 1; ++y) {
-    for (int x = 1; x < width - 1; ++x) {
-      int gx = -data[(y - 1) * stride + (x - 1)] - 2 * data[y * stride + (x - 1)] - data[(y + 1) * stride + (x - 1)]
-             + data[(y - 1) * stride + (x + 1)] + 2 * data[y * stride + (x + 1)] + data[(y + 1) * stride + (x + 1)];
-      int gy = -data[(y - 1) * stride + (x - 1)] - 2 * data[(y - 1) * stride + x] - data[(y - 1) * stride + (x + 1)]
-             + data[(y + 1) * stride + (x - 1)] + 2 * data[(y + 1) * stride + x] + data[(y + 1) * stride + (x + 1)];
-      float mag = std::sqrt(static_cast<float>(gx * gx + gy * gy));
-      accum += mag;
-      ++count;
-    }
-  }
-
-  if (count == 0) {
-    return 0.0f;
-  }
-  return static_cast<float>(accum / static_cast<double>(count));
+  return noise_kernel(Gray8Access(frame));
 }
 
 float compute_motion_blur(const GrayFrame& frame, const GrayFrame* prev_frame) {
   if (!prev_frame || !prev_frame->data) {
     return 0.0f;
   }
-
-  const int width = frame.width;
-  const int height = frame.height;
-  const int stride = frame.stride;
-  const uint8_t* data = frame.data;
-  const uint8_t* prev = prev_frame->data;
-
-  double diff_accum = 0.0;
-  int count = width * height;
-  for (int y = 0; y < height; ++y) {
-    const uint8_t* row = data + y * stride;
-    const uint8_t* prow = prev + y * prev_frame->stride;
-    for (int x = 0; x < width; ++x) {
-      diff_accum += std::abs(static_cast<int>(row[x]) - static_cast<int>(prow[x]));
-    }
+  if (frame.width != prev_frame->width || frame.height != prev_frame->height) {
+    return 0.0f;
   }
-
-  float diff_mean = 0.0f;
-  if (count > 0) {
-    diff_mean = static_cast<float>(diff_accum / static_cast<double>(count)) / 255.0f;
+  ScratchArena arena;
+  MotionEstimator motion(&arena);
+  VpFrame current{frame.width, frame.height, frame.stride, VP_PIXEL_GRAY8, frame.data};
+  VpFrame previous{prev_frame->width, prev_frame->height, prev_frame->stride, VP_PIXEL_GRAY8,
+                   prev_frame->data};
+  MotionField field;
+  if (motion.estimate(current, previous, nullptr, &field)) {
+    return motion_blur_kernel(Gray8Access(frame), field);
   }
-
-  float edge_strength = compute_edge_strength(frame) / 255.0f;
-
-  return diff_mean / (edge_strength + 1e-5f);
+  return 0.0f;
 }
 
-const char* metric_id_to_string(VpMetricId id) {
+const char* metric_id_to_string(int32_t id) {
   switch (id) {
     case VP_METRIC_SHARPNESS:
       return "sharpness";
@@ -28,7 +28,8 @@ float compute_exposure_clipping(const GrayFrame& frame);
 float compute_noise_estimate(const GrayFrame& frame);
 float compute_motion_blur(const GrayFrame& frame, const GrayFrame* prev_frame);
 
-const char* metric_id_to_string(VpMetricId id);
+// Built-in metric names; "unknown" for any other id.
+const char* metric_id_to_string(int32_t id);
 
 } // namespace vp
 
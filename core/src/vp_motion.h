@@ -0,0 +1,86 @@
+#ifndef VP_MOTION_H
+#define VP_MOTION_H
+
+#include <cstdint>
+
+#include "vp_analyzer.h"
+#include "vp_scratch.h"
+#include "vp_stats.h"
+
+namespace vp {
+
+// Block matching runs on a box-downsampled luma plane: the factor is the
+// largest power of two that keeps the short side at or above
+// kMotionMinShortSide (720p -> 4, 1080p -> 8), capped at kMotionMaxFactor.
+constexpr int kMotionBlockSize = 16;
+constexpr int kMotionSearchRange = 7;
+constexpr int kMotionMinShortSide = 120;
+constexpr int kMotionMaxFactor = 16;
+// Mean absolute difference of 2 levels per pixel counts as a match and ends
+// the search after the predictor candidates.
+constexpr uint32_t kMotionEarlyExitSad = 2 * kMotionBlockSize * kMotionBlockSize;
+
+// Displacement of a block from the previous frame to the current one, in
+// downsampled pixels, and the SAD of the best match.
+struct MotionVector {
+  int16_t dx;
+  int16_t dy;
+  uint32_t sad;
+};
+
+// Row-major per-block vectors plus the component-wise median as the global
+// (camera) motion. Block (col, row) covers downsampled pixels starting at
+// (col, row) * kMotionBlockSize, i.e. full-resolution pixels scaled by factor.
+struct MotionField {
+  int factor;
+  int block_cols;
+  int block_rows;
+  const MotionVector* vectors;
+  int global_dx;
+  int global_dy;
+};
+
+inline int motion_downsample_factor(int width, int height) {
+  int short_side = width < height ? width : height;
+  int factor = 1;
+  while (factor < kMotionMaxFactor && short_side / (factor * 2) >= kMotionMinShortSide) {
+    factor *= 2;
+  }
+  return factor;
+}
+
+// Box-filters the luma of `frame` by `factor` (1, 2, 4, 8 or 16) into a
+// dst_width x dst_height GRAY8 plane with stride dst_width. The destination
+// must not exceed frame.width / factor x frame.height / factor.
+void downsample_luma_plane(const VpFrame& frame, int factor, uint8_t* dst, int dst_width,
+                           int dst_height);
+
+// Estimates block motion between consecutive frames. Downsampled planes live
+// in scratch slots; when `prev` is the frame passed as `frame` to the last
+// call, its plane is reused by swapping slots instead of downsampling again.
+// The last global motion seeds the search of the next frame.
+class MotionEstimator {
+ public:
+  explicit MotionEstimator(ScratchArena* arena) : arena_(arena) {}
+
+  // Forgets the cached plane and predictor. Call whenever the frame memory
+  // behind a cached pointer may have changed.
+  void reset();
+
+  // Returns false when the frames are too small for one block or scratch
+  // memory is unavailable; `out` then is untouched. Frames must share geometry.
+  bool estimate(const VpFrame& frame, const VpFrame& prev, Stats* stats, MotionField* out);
+
+ private:
+  bool is_cached(const VpFrame& frame) const;
+
+  ScratchArena* arena_;
+  bool has_cached_ = false;
+  VpFrame cached_{};
+  int predict_dx_ = 0;
+  int predict_dy_ = 0;
+};
+
+} // namespace vp
+
+#endif // VP_MOTION_H
@@ -0,0 +1,74 @@
+#include "vp_phash.h"
+
+#include "vp_pixel_access.h"
+
+namespace vp {
+
+namespace {
+
+constexpr int kHashCols = 9;
+constexpr int kHashRows = 8;
+
+template <class Access>
+uint64_t dhash(const VpFrame& input) {
+  const Access frame(input);
+  const int width = frame.width();
+  const int height = frame.height();
+
+  int col_begin[kHashCols + 1];
+  for (int c = 0; c <= kHashCols; ++c) {
+    col_begin[c] = static_cast<int>(static_cast<int64_t>(c) * width / kHashCols);
+  }
+
+  uint64_t hash = 0;
+  int bit = 0;
+  for (int r = 0; r < kHashRows; ++r) {
+    int y0 = static_cast<int>(static_cast<int64_t>(r) * height / kHashRows);
+    int y1 = static_cast<int>(static_cast<int64_t>(r + 1) * height / kHashRows);
+    if (y1 <= y0) {
+      y1 = y0 + 1;
+    }
+    int span = y1 - y0;
+    int samples = span < kHashRowsPerCell ? span : kHashRowsPerCell;
+
+    // Cells differ in width by at most one pixel, so compare means, scaled
+    // to integers by cross-multiplying with the neighbour's pixel count.
+    uint64_t sums[kHashCols] = {};
+    for (int s = 0; s < samples; ++s) {
+      int y = y0 + (2 * s + 1) * span / (2 * samples);
+      const uint8_t* row = frame.row(y);
+      for (int c = 0; c < kHashCols; ++c) {
+        sums[c] += Access::sum_luma(row, col_begin[c], col_begin[c + 1]);
+      }
+    }
+    for (int c = 0; c + 1 < kHashCols; ++c) {
+      uint64_t width_a = static_cast<uint64_t>(col_begin[c + 1] - col_begin[c]);
+      uint64_t width_b = static_cast<uint64_t>(col_begin[c + 2] - col_begin[c + 1]);
+      if (sums[c] * width_b < sums[c + 1] * width_a) {
+        hash |= uint64_t{1} << bit;
+      }
+      ++bit;
+    }
+  }
+  return hash;
+}
+
+} // namespace
+
+FrameHashFn select_frame_hash(VpPixelFormat format) {
+  switch (format) {
+    case VP_PIXEL_GRAY8:
+      return &dhash<Gray8Access>;
+    case VP_PIXEL_RGBA8888:
+      return &dhash<Rgba8888Access>;
+    case VP_PIXEL_BGRA8888:
+      return &dhash<Bgra8888Access>;
+    case VP_PIXEL_NV12:
+    case VP_PIXEL_I420:
+      return &dhash<YPlaneAccess>;
+    default:
+      return nullptr;
+  }
+}
+
+} // namespace vp
@@ -0,0 +1,221 @@
+#include "vp_pipeline.h"
+
+#include "vp_metric_kernels.h"
+#include "vp_metrics.h"
+#include "vp_pixel_access.h"
+#include "vp_scratch.h"
+
+namespace vp {
+
+namespace {
+
+template <class Kernel>
+inline float timed_metric(const PipelineContext& context, VpMetricId id, Kernel&& kernel) {
+  TraceScope trace(context.tracer, metric_id_to_string(id), "metric", context.frame_index);
+  StageTimer timer;
+  float raw = kernel();
+  context.stats->add_metric(static_cast<int>(id), id, timer.stop());
+  return raw;
+}
+
+template <class Access>
+float motion_against(const Access& frame, const VpFrame& input, const VpFrame& prev,
+                     const PipelineContext& context) {
+  if (prev.width != frame.width() || prev.height != frame.height()) {
+    return 0.0f;
+  }
+  // Frames too small for one motion block are not measured, like the first
+  // frame of a sequence.
+  MotionField field;
+  if (context.motion && context.motion->estimate(input, prev, context.stats, &field)) {
+    return motion_blur_kernel(frame, field);
+  }
+  return 0.0f;
+}
+
+template <class Access>
+void run_pipeline(const VpFrame& input, const VpFrame* prev, const VpFrameExtras* extras,
+                  uint32_t compute_mask, float* out_raw, const PipelineContext& context) {
+  const Access frame(input);
+  if (compute_mask & metric_bit(VP_METRIC_SHARPNESS)) {
+    out_raw[VP_METRIC_SHARPNESS] =
+        timed_metric(context, VP_METRIC_SHARPNESS, [&] { return sharpness_kernel(frame, context.tiles); });
+  }
+  if (is_cancelled(context)) {
+    return;
+  }
+  if (compute_mask & metric_bit(VP_METRIC_EXPOSURE)) {
+    out_raw[VP_METRIC_EXPOSURE] = timed_metric(context, VP_METRIC_EXPOSURE, [&] {
+      return exposure_kernel(frame, context.clip_levels, context.histogram, context.tiles);
+    });
+  }
+  if (is_cancelled(context)) {
+    return;
+  }
+  if (compute_mask & metric_bit(VP_METRIC_MOTION_BLUR)) {
+    out_raw[VP_METRIC_MOTION_BLUR] = timed_metric(context, VP_METRIC_MOTION_BLUR, [&] {
+      return prev ? motion_against(frame, input, *prev, context) : 0.0f;
+    });
+  }
+  if (is_cancelled(context)) {
+    return;
+  }
+  if (compute_mask & metric_bit(VP_METRIC_NOISE)) {
+    out_raw[VP_METRIC_NOISE] =
+        timed_metric(context, VP_METRIC_NOISE, [&] { return noise_kernel(frame, context.tiles); });
+  }
+  if (is_cancelled(context)) {
+    return;
+  }
+  if (compute_mask & metric_bit(VP_METRIC_PERSON_BLUR)) {
+    // Without person data the metric is the whole-frame sharpness, which is
+    // reused rather than computed a second time.
+    out_raw[VP_METRIC_PERSON_BLUR] = timed_metric(context, VP_METRIC_PERSON_BLUR, [&] {
+      float raw = 0.0f;
+      if (has_person_region(extras) && person_sharpness_kernel(frame, *extras, &raw)) {
+        return raw;
+      }
+      if (compute_mask & metric_bit(VP_METRIC_SHARPNESS)) {
+        return out_raw[VP_METRIC_SHARPNESS];
+      }
+      return sharpness_kernel(frame);
+    });
+  }
+}
+
+constexpr uint32_t kBandMetrics = metric_bit(VP_METRIC_SHARPNESS) | metric_bit(VP_METRIC_EXPOSURE) |
+                                  metric_bit(VP_METRIC_NOISE) | metric_bit(VP_METRIC_PERSON_BLUR);
+constexpr int kBandCancelRows = 64;
+
+// Packed RGB frames would recompute luma on every read of every metric pass.
+// Here each row is converted once into a small ring of luma rows that stays
+// in cache, and sharpness, exposure, noise and person sharpness consume it in
+// one fused pass; the results are identical to run_pipeline. For luma formats
+// the conversion is a row copy, which can still win on large frames where the
+// per-metric passes miss the cache. Motion still reads the source, since the
+// estimator keeps its own downsampled planes.
+template <class Access>
+void run_banded_pipeline(const VpFrame& input, const VpFrame* prev, const VpFrameExtras* extras,
+                         uint32_t compute_mask, float* out_raw, const PipelineContext& context) {
+  const Access frame(input);
+  const int width = frame.width();
+  const int height = frame.height();
+  uint8_t* ring = nullptr;
+  if (context.scratch && (compute_mask & kBandMetrics) != 0) {
+    bool grew = false;
+    ring = context.scratch->acquire(
+        kScratchBandRows, static_cast<size_t>(RingRowsAccess::kRingRows) * width, &grew);
+    if (grew) {
+      context.stats->add_allocation(VP_STAGE_METRICS);
+    }
+  }
+  if (!ring) {
+    run_pipeline<Access>(input, prev, extras, compute_mask, out_raw, context);
+    return;
+  }
+
+  const bool want_sharpness = (compute_mask & metric_bit(VP_METRIC_SHARPNESS)) != 0;
+  const bool want_exposure = (compute_mask & metric_bit(VP_METRIC_EXPOSURE)) != 0;
+  const bool want_noise = (compute_mask & metric_bit(VP_METRIC_NOISE)) != 0;
+  const bool want_person = (compute_mask & metric_bit(VP_METRIC_PERSON_BLUR)) != 0;
+  PersonSharpness person;
+  const bool person_region =
+      want_person && has_person_region(extras) && person.begin(width, height, *extras);
+  // Without a person region the metric falls back to whole-frame sharpness.
+  const bool band_sharpness = want_sharpness || (want_person && !person_region);
+  TileFrameSums* sharpness_tiles = want_sharpness ? context.tiles : nullptr;
+
+  const RingRowsAccess rows(ring, width, height);
+  SharpnessSums sharpness;
+  ExposureCounts exposure(context.clip_levels, context.tiles);
+  NoiseSums noise;
+  {
+    TraceScope trace(context.tracer, "band_pass", "metric", context.frame_index);
+    StageTimer timer;
+    frame.convert_row(0, rows.slot(0));
+    for (int y = 0; y < height; ++y) {
+      if (y + 1 < height) {
+        frame.convert_row(y + 1, rows.slot(y + 1));
+      }
+      if (want_exposure) {
+        exposure_row(rows, y, context.tiles, &exposure);
+      }
+      if (want_noise) {
+        noise_row(rows, y, context.tiles, &noise);
+      }
+      if (y >= 1 && y < height - 1) {
+        if (band_sharpness) {
+          sharpness_row(rows, y, sharpness_tiles, &sharpness);
+        }
+        if (person_region) {
+          person.add_row(rows, y);
+        }
+      }
+      if ((y + 1) % kBandCancelRows == 0 && is_cancelled(context)) {
+        return;
+      }
+    }
+
+    // The fused pass is charged to its metrics in equal shares.
+    const uint64_t nanoseconds = timer.stop();
+    const uint64_t share =
+        nanoseconds / static_cast<uint64_t>(want_sharpness + want_exposure + want_noise + want_person);
+    for (VpMetricId id : {VP_METRIC_SHARPNESS, VP_METRIC_EXPOSURE, VP_METRIC_NOISE, VP_METRIC_PERSON_BLUR}) {
+      if (compute_mask & metric_bit(id)) {
+        context.stats->add_metric(static_cast<int>(id), id, share);
+      }
+    }
+  }
+
+  const float frame_sharpness = sharpness_value(sharpness);
+  if (want_sharpness) {
+    out_raw[VP_METRIC_SHARPNESS] = frame_sharpness;
+  }
+  if (want_exposure) {
+    out_raw[VP_METRIC_EXPOSURE] = exposure_value(exposure, width * height, context.histogram);
+  }
+  if (want_noise) {
+    out_raw[VP_METRIC_NOISE] = noise_value(noise);
+  }
+  if (want_person) {
+    float raw = frame_sharpness;
+    if (person_region && !person.result(&raw)) {
+      // A mask with no weight inside the boxes; rare enough for a second pass.
+      raw = want_sharpness ? frame_sharpness : sharpness_kernel(frame);
+    }
+    out_raw[VP_METRIC_PERSON_BLUR] = raw;
+  }
+  if (is_cancelled(context)) {
+    return;
+  }
+  if (compute_mask & metric_bit(VP_METRIC_MOTION_BLUR)) {
+    out_raw[VP_METRIC_MOTION_BLUR] = timed_metric(context, VP_METRIC_MOTION_BLUR, [&] {
+      return prev ? motion_against(frame, input, *prev, context) : 0.0f;
+    });
+  }
+}
+
+} // namespace
+
+PipelineVariant default_pipeline_variant(VpPixelFormat format) {
+  return bytes_per_pixel(format) == 4 ? PipelineVariant::kBanded : PipelineVariant::kPerMetric;
+}
+
+FramePipeline select_pipeline(VpPixelFormat format, PipelineVariant variant) {
+  const bool banded = variant == PipelineVariant::kBanded;
+  switch (format) {
+    case VP_PIXEL_GRAY8:
+      return banded ? &run_banded_pipeline<Gray8Access> : &run_pipeline<Gray8Access>;
+    case VP_PIXEL_RGBA8888:
+      return banded ? &run_banded_pipeline<Rgba8888Access> : &run_pipeline<Rgba8888Access>;
+    case VP_PIXEL_BGRA8888:
+      return banded ? &run_banded_pipeline<Bgra8888Access> : &run_pipeline<Bgra8888Access>;
+    case VP_PIXEL_NV12:
+    case VP_PIXEL_I420:
+      return banded ? &run_banded_pipeline<YPlaneAccess> : &run_pipeline<YPlaneAccess>;
+    default:
+      return nullptr;
+  }
+}
+
+} // namespace vp
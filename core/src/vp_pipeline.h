@@ -0,0 +1,85 @@
+#ifndef VP_PIPELINE_H
+#define VP_PIPELINE_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "vp_analyzer.h"
+#include "vp_histogram.h"
+#include "vp_motion.h"
+#include "vp_scratch.h"
+#include "vp_stats.h"
+#include "vp_tiles.h"
+#include "vp_trace.h"
+
+namespace vp {
+
+// Built-in metrics are indexed by their VpMetricId.
+constexpr int kBuiltinMetricCount = VP_METRIC_PERSON_BLUR + 1;
+constexpr int kPixelFormatCount = VP_PIXEL_I420 + 1;
+
+// Takes built-in and custom metric ids alike.
+constexpr uint32_t metric_bit(int32_t id) {
+  return 1u << static_cast<uint32_t>(id);
+}
+
+constexpr uint32_t kAllBuiltinMetrics = (1u << kBuiltinMetricCount) - 1u;
+
+inline bool has_person_region(const VpFrameExtras* extras) {
+  return extras && (extras->box_count > 0 || extras->mask);
+}
+
+struct PipelineContext {
+  Stats* stats;
+  Tracer* tracer;
+  int frame_index;
+  // Non-null when the tile grid is enabled; prepared with begin_frame().
+  TileFrameSums* tiles;
+  // Block motion for the motion-blur metric; without one (or for frames too
+  // small for a block) the frame-difference estimate is used.
+  MotionEstimator* motion;
+  ClipLevels clip_levels;
+  // Receives the frame's luma histogram whenever exposure is computed.
+  LumaHistogram* histogram;
+  // Set to stop between metrics; the remaining ones are left unwritten.
+  const std::atomic<bool>* cancel;
+  // Working memory for the banded packed-RGB pipeline; without it those
+  // formats run one pass per metric.
+  ScratchArena* scratch;
+};
+
+inline bool is_cancelled(const PipelineContext& context) {
+  return context.cancel && context.cancel->load(std::memory_order_relaxed);
+}
+
+// Scores one frame with the fixed built-in metric set, reading pixels through
+// the accessor policy of a single pixel format. Metrics whose bit is set in
+// `compute_mask` are written to out_raw[metric_id]; the rest are untouched.
+// `prev` is the previous frame of the sequence (any format) or nullptr;
+// `extras` carries optional person detections for the frame or nullptr.
+using FramePipeline = void (*)(const VpFrame& frame, const VpFrame* prev,
+                               const VpFrameExtras* extras, uint32_t compute_mask, float* out_raw,
+                               const PipelineContext& context);
+
+// How a format's frames go through the built-in metrics. kPerMetric reads
+// the caller's buffer once per metric; kBanded converts each row once into a
+// small ring of luma rows and runs sharpness, exposure, noise and person
+// sharpness over it in one fused pass. Results are identical; which is faster
+// depends on the format, the frame size and the CPU (see vp_autotune.h).
+enum class PipelineVariant : uint8_t { kPerMetric = 0, kBanded = 1 };
+constexpr int kPipelineVariantCount = 2;
+
+// The variant used without a tuning profile: banded for packed RGB, which
+// would otherwise recompute luma in every pass, per-metric for luma formats.
+PipelineVariant default_pipeline_variant(VpPixelFormat format);
+
+// Returns the pipeline specialized for `format`, or nullptr if unsupported.
+FramePipeline select_pipeline(VpPixelFormat format, PipelineVariant variant);
+
+inline FramePipeline select_pipeline(VpPixelFormat format) {
+  return select_pipeline(format, default_pipeline_variant(format));
+}
+
+} // namespace vp
+
+#endif // VP_PIPELINE_H
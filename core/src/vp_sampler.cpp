@@ -0,0 +1,143 @@
+#include "vp_sampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vp {
+
+bool AdaptiveSampler::heap_less(const Interval& a, const Interval& b) {
+  return a.priority < b.priority || (a.priority == b.priority && a.length < b.length);
+}
+
+void AdaptiveSampler::reset(double start, double end, int initial_samples, int budget,
+                            double min_interval) {
+  start_ = start;
+  end_ = std::max(start, end);
+  min_interval_ = std::max(0.0, min_interval);
+  budget_ = std::max(1, budget);
+  // Both ends at least, or no interval would ever be split.
+  initial_count_ = end_ == start_ ? 1 : std::min(std::max(2, initial_samples), budget_);
+  issued_ = 0;
+  pending_ = false;
+  samples_.clear();
+  intervals_.clear();
+  samples_.reserve(static_cast<size_t>(budget_));
+  intervals_.reserve(static_cast<size_t>(budget_) + 1);
+}
+
+bool AdaptiveSampler::next(double* out_time) {
+  if (pending_ || issued_ >= budget_) {
+    return false;
+  }
+  if (issued_ < initial_count_) {
+    if (initial_count_ == 1) {
+      pending_time_ = 0.5 * (start_ + end_);
+    } else {
+      pending_time_ = start_ + (end_ - start_) * static_cast<double>(issued_) /
+                                   static_cast<double>(initial_count_ - 1);
+    }
+    *out_time = pending_time_;
+    ++issued_;
+    pending_ = true;
+    return true;
+  }
+
+  while (!intervals_.empty()) {
+    std::pop_heap(intervals_.begin(), intervals_.end(), heap_less);
+    Interval interval = intervals_.back();
+    intervals_.pop_back();
+    if (interval.length <= 0.0 || interval.length < 2.0 * min_interval_) {
+      continue;
+    }
+    pending_interval_ = interval;
+    pending_time_ = 0.5 * (samples_[interval.left].time + samples_[interval.right].time);
+    *out_time = pending_time_;
+    ++issued_;
+    pending_ = true;
+    return true;
+  }
+  return false;
+}
+
+void AdaptiveSampler::report(float score) {
+  if (!pending_) {
+    return;
+  }
+  pending_ = false;
+  samples_.push_back({pending_time_, score});
+  int index = static_cast<int>(samples_.size()) - 1;
+
+  if (issued_ < initial_count_) {
+    return;
+  }
+  if (issued_ == initial_count_) {
+    // Initial samples were issued in time order.
+    for (int i = 0; i + 1 < initial_count_; ++i) {
+      push_interval(i, i + 1);
+    }
+    return;
+  }
+  push_interval(pending_interval_.left, index);
+  push_interval(index, pending_interval_.right);
+}
+
+void AdaptiveSampler::push_interval(int left, int right) {
+  const Sample& a = samples_[left];
+  const Sample& b = samples_[right];
+  double length = b.time - a.time;
+  double span = end_ - start_;
+  float priority = std::fabs(a.score - b.score);
+  if (span > 0.0) {
+    priority += kLengthWeight * static_cast<float>(length / span);
+  }
+  intervals_.push_back({priority, length, left, right});
+  std::push_heap(intervals_.begin(), intervals_.end(), heap_less);
+}
+
+void AdaptiveSampler::ordered(std::vector<int>* order, std::vector<double>* spans) const {
+  size_t count = samples_.size();
+  order->resize(count);
+  spans->resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    (*order)[i] = static_cast<int>(i);
+  }
+  std::sort(order->begin(), order->end(),
+            [this](int a, int b) { return samples_[a].time < samples_[b].time; });
+
+  double total = 0.0;
+  for (size_t i = 0; i < count; ++i) {
+    double before = i > 0 ? samples_[(*order)[i - 1]].time : samples_[(*order)[i]].time;
+    double after = i + 1 < count ? samples_[(*order)[i + 1]].time : samples_[(*order)[i]].time;
+    (*spans)[i] = 0.5 * (after - before);
+    total += (*spans)[i];
+  }
+  if (total <= 0.0) {
+    std::fill(spans->begin(), spans->end(), 1.0);
+  }
+}
+
+void progressive_order(int count, std::vector<int>* order, std::vector<uint8_t>* seen) {
+  order->clear();
+  if (count <= 0) {
+    return;
+  }
+  seen->assign(static_cast<size_t>(count), 0);
+  auto emit = [order, seen](int64_t index) {
+    if (!(*seen)[index]) {
+      (*seen)[index] = 1;
+      order->push_back(static_cast<int>(index));
+    }
+  };
+  const int64_t last = count - 1;
+  emit(0);
+  emit(last);
+  // Level `parts` adds the odd multiples of last / parts; once the spacing
+  // drops below one frame every index has been emitted.
+  for (int64_t parts = 2; parts < 2 * last; parts *= 2) {
+    for (int64_t k = 1; k < parts; k += 2) {
+      emit((k * last + parts / 2) / parts);
+    }
+  }
+}
+
+} // namespace vp
@@ -0,0 +1,78 @@
+#ifndef VP_SAMPLER_H
+#define VP_SAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vp {
+
+// Coarse-to-fine timestamp selection. The first pass hands out a sparse,
+// uniformly spaced set of timestamps; after that each step splits the
+// interval between two time-adjacent samples whose scores differ most,
+// so samples concentrate where quality changes (e.g. a short blur event)
+// instead of being spent on stable stretches. Usage:
+//
+//   sampler.reset(start, end, initial, budget, min_interval);
+//   while (sampler.next(&t)) sampler.report(score_at(t));
+class AdaptiveSampler {
+ public:
+  struct Sample {
+    double time;
+    float score;
+  };
+
+  // Small bias towards long intervals so that a stretch whose two ends happen
+  // to score alike is still revisited once the large differences are resolved.
+  static constexpr float kLengthWeight = 0.05f;
+
+  void reset(double start, double end, int initial_samples, int budget, double min_interval);
+
+  // Next timestamp to score. Returns false once the budget is spent or no
+  // interval is longer than twice the minimum interval.
+  bool next(double* out_time);
+
+  // Records the score of the timestamp last returned by next().
+  void report(float score);
+
+  // Samples in the order they were reported.
+  size_t sample_count() const { return samples_.size(); }
+  const Sample& sample(size_t index) const { return samples_[index]; }
+
+  // Report-order indices sorted by time, and the span of time each sample
+  // stands for (half the distance to each neighbour), for time-weighted means.
+  void ordered(std::vector<int>* order, std::vector<double>* spans) const;
+
+ private:
+  struct Interval {
+    float priority;
+    double length;
+    int left;
+    int right;
+  };
+
+  static bool heap_less(const Interval& a, const Interval& b);
+  void push_interval(int left, int right);
+
+  double start_ = 0.0;
+  double end_ = 0.0;
+  double min_interval_ = 0.0;
+  int initial_count_ = 0;
+  int budget_ = 0;
+  int issued_ = 0;
+  bool pending_ = false;
+  double pending_time_ = 0.0;
+  Interval pending_interval_{};
+  std::vector<Sample> samples_;
+  // Binary max-heap on (priority, length).
+  std::vector<Interval> intervals_;
+};
+
+// Frame indices 0..count-1 in progressive order: first and last, then the
+// midpoint, the quarter points, the eighth points and so on, so that every
+// prefix of the order covers the range roughly evenly. `seen` is scratch.
+void progressive_order(int count, std::vector<int>* order, std::vector<uint8_t>* seen);
+
+} // namespace vp
+
+#endif // VP_SAMPLER_H
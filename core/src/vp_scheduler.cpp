@@ -0,0 +1,243 @@
+#include "vp_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <system_error>
+
+namespace vp {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// While jobs wait, idle workers and preempted jobs wake this often to notice
+// tokens that were cancelled without vp_task_cancel. An idle scheduler sleeps
+// without a timeout.
+constexpr std::chrono::milliseconds kSweepPeriod(20);
+
+bool is_cancelled(const ScheduledJob& job) {
+  return job.cancel && job.cancel->load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+Scheduler::Scheduler(const VpSchedulerConfig& config) {
+  max_running_ = config.max_running;
+  if (max_running_ <= 0) {
+    max_running_ = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  }
+  const float share = std::isfinite(config.background_share) ? config.background_share : 0.0f;
+  background_cap_ = std::max(
+      1, std::min(max_running_, static_cast<int>(std::floor(share * static_cast<float>(max_running_)))));
+  aging_ = std::chrono::milliseconds(config.aging_ms);
+}
+
+Scheduler::~Scheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  ready_cv_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+bool Scheduler::start() {
+  // Running jobs plus preempted background jobs can occupy max_running_ +
+  // background_cap_ workers; one more always remains to sweep cancelled jobs.
+  const int workers = max_running_ + background_cap_ + 1;
+  try {
+    for (int i = 0; i < workers; ++i) {
+      workers_.emplace_back(&Scheduler::worker, this);
+    }
+  } catch (const std::system_error&) {
+    return false;
+  }
+  return true;
+}
+
+void Scheduler::submit(ScheduledJob* job) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  job->state = ScheduledJob::State::kQueued;
+  job->waiting_since = Clock::now();
+  job->sequence = next_sequence_++;
+  waiting_.push_back(job);
+  dispatch();
+  if (job->state == ScheduledJob::State::kQueued) {
+    // Moves an idle worker from its untimed wait to sweeping.
+    ready_cv_.notify_one();
+  }
+}
+
+void Scheduler::checkpoint(ScheduledJob* job) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (job->priority != VP_PRIORITY_BACKGROUND || job->aged || !job->holds_slot) {
+    return;
+  }
+  const Clock::time_point now = Clock::now();
+  if (running_ < max_running_ || !has_urgent_waiter(now)) {
+    return;
+  }
+  job->holds_slot = false;
+  --running_;
+  job->state = ScheduledJob::State::kPaused;
+  job->waiting_since = now;
+  waiting_.push_back(job);
+  dispatch();
+  while (job->state == ScheduledJob::State::kPaused) {
+    if (is_cancelled(*job)) {
+      // The analysis stops at its next cancellation check; no slot needed.
+      remove_waiting(job);
+      job->state = ScheduledJob::State::kRunning;
+      return;
+    }
+    resume_cv_.wait_for(lock, kSweepPeriod);
+  }
+}
+
+void Scheduler::finish(ScheduledJob* job) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (job->holds_slot) {
+    job->holds_slot = false;
+    --running_;
+  }
+  if (job->started && job->priority == VP_PRIORITY_BACKGROUND) {
+    --background_held_;
+  }
+  job->state = ScheduledJob::State::kDone;
+  dispatch();
+}
+
+void Scheduler::wake() {
+  ready_cv_.notify_all();
+  resume_cv_.notify_all();
+}
+
+void Scheduler::worker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    ScheduledJob* job = nullptr;
+    if (!ready_.empty()) {
+      job = ready_.front();
+      ready_.pop_front();
+    } else {
+      // A cancelled job still in the queue is finished here without a slot;
+      // its analysis returns VP_ERR_CANCELLED before the first frame.
+      for (ScheduledJob* waiting : waiting_) {
+        if (waiting->state == ScheduledJob::State::kQueued && is_cancelled(*waiting)) {
+          job = waiting;
+          break;
+        }
+      }
+      if (job) {
+        remove_waiting(job);
+      } else if (stopping_) {
+        return;
+      } else if (has_queued()) {
+        ready_cv_.wait_for(lock, kSweepPeriod);
+        continue;
+      } else {
+        ready_cv_.wait(lock);
+        continue;
+      }
+    }
+    job->state = ScheduledJob::State::kRunning;
+    lock.unlock();
+    // The owner may free the job as soon as it has reported completion.
+    job->run(job->owner);
+    lock.lock();
+  }
+}
+
+void Scheduler::dispatch() {
+  const Clock::time_point now = Clock::now();
+  while (running_ < max_running_) {
+    // Urgent jobs (interactive or aged) first, in the order they started
+    // waiting; then preempted background jobs before fresh ones.
+    ScheduledJob* best = nullptr;
+    bool best_urgent = false;
+    for (ScheduledJob* job : waiting_) {
+      if (!admissible(*job)) {
+        continue;
+      }
+      const bool job_urgent = urgent(*job, now);
+      bool better = !best;
+      if (best && job_urgent != best_urgent) {
+        better = job_urgent;
+      } else if (best && !job_urgent && job->started != best->started) {
+        better = job->started;
+      } else if (best) {
+        better = job->waiting_since < best->waiting_since ||
+                 (job->waiting_since == best->waiting_since && job->sequence < best->sequence);
+      }
+      if (better) {
+        best = job;
+        best_urgent = job_urgent;
+      }
+    }
+    if (!best) {
+      return;
+    }
+    grant(best, now);
+  }
+}
+
+bool Scheduler::admissible(const ScheduledJob& job) const {
+  if (job.state != ScheduledJob::State::kQueued && job.state != ScheduledJob::State::kPaused) {
+    return false;
+  }
+  // Preempted background jobs are already counted in background_held_.
+  return job.priority == VP_PRIORITY_INTERACTIVE || job.started ||
+         background_held_ < background_cap_;
+}
+
+bool Scheduler::urgent(const ScheduledJob& job, Clock::time_point now) const {
+  return job.priority == VP_PRIORITY_INTERACTIVE || job.aged ||
+         (aging_.count() > 0 && now - job.waiting_since >= aging_);
+}
+
+bool Scheduler::has_queued() const {
+  for (const ScheduledJob* job : waiting_) {
+    if (job->state == ScheduledJob::State::kQueued) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Scheduler::has_urgent_waiter(Clock::time_point now) const {
+  for (const ScheduledJob* job : waiting_) {
+    if (admissible(*job) && urgent(*job, now)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Scheduler::grant(ScheduledJob* job, Clock::time_point now) {
+  remove_waiting(job);
+  job->holds_slot = true;
+  ++running_;
+  if (job->priority == VP_PRIORITY_BACKGROUND && urgent(*job, now)) {
+    job->aged = true;
+  }
+  if (job->started) {
+    job->state = ScheduledJob::State::kRunning;
+    resume_cv_.notify_all();
+    return;
+  }
+  job->started = true;
+  if (job->priority == VP_PRIORITY_BACKGROUND) {
+    ++background_held_;
+  }
+  job->state = ScheduledJob::State::kReady;
+  ready_.push_back(job);
+  ready_cv_.notify_one();
+}
+
+void Scheduler::remove_waiting(ScheduledJob* job) {
+  waiting_.erase(std::remove(waiting_.begin(), waiting_.end(), job), waiting_.end());
+}
+
+} // namespace vp
@@ -0,0 +1,69 @@
+#ifndef VP_SCRATCH_H
+#define VP_SCRATCH_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vp {
+
+// Slot ids are claimed by the pipeline stages that need working memory; the
+// metric kernels themselves read straight from the caller's frames or from the
+// banded pipeline's row ring.
+enum ScratchSlot {
+  // Copy of the frame adaptive sampling scores motion blur against.
+  kScratchMotionReference = 0,
+  // Downsampled luma planes and block vectors of the motion estimator.
+  kScratchMotionCurrent = 1,
+  kScratchMotionPrevious = 2,
+  kScratchMotionVectors = 3,
+  // Downscaled copies of a sampled frame and its predecessor in deadline mode.
+  kScratchDeadlineCurrent = 4,
+  kScratchDeadlinePrevious = 5,
+  // Ring of converted luma rows for the banded packed-RGB pipeline.
+  kScratchBandRows = 6,
+  kScratchSlotCount = 7
+};
+
+// Per-analyzer working memory. Each slot keeps the largest block requested so
+// far, so repeated calls with the same (or smaller) geometry never touch the
+// heap. Blocks are 64-byte aligned and padded to a multiple of 64 bytes so
+// vector loads may safely run past the logical end of a row or buffer.
+class ScratchArena {
+ public:
+  static constexpr size_t kAlignment = 64;
+
+  ScratchArena() = default;
+  ~ScratchArena();
+
+  ScratchArena(const ScratchArena&) = delete;
+  ScratchArena& operator=(const ScratchArena&) = delete;
+
+  // Returns a block of at least `bytes` for `slot`, or nullptr on allocation
+  // failure. Contents are preserved only when the slot did not have to grow;
+  // `grew` reports whether a heap allocation happened.
+  uint8_t* acquire(ScratchSlot slot, size_t bytes, bool* grew);
+
+  uint8_t* data(ScratchSlot slot) const { return blocks_[slot].data; }
+
+  // Exchanges two slots without copying, e.g. to turn "current" into "previous".
+  void swap(ScratchSlot a, ScratchSlot b);
+
+  // Frees the largest blocks until the retained total is at most `keep_bytes`.
+  void trim(size_t keep_bytes);
+
+  size_t capacity_bytes() const;
+
+ private:
+  struct Block {
+    uint8_t* data = nullptr;
+    size_t capacity = 0;
+  };
+
+  static void release(Block& block);
+
+  Block blocks_[kScratchSlotCount];
+};
+
+} // namespace vp
+
+#endif // VP_SCRATCH_H
@@ -0,0 +1,112 @@
+#include "vp_segment.h"
+
+#include <algorithm>
+
+namespace vp {
+
+void SegmentFinder::reset(int window, int metric_count, const float* weights) {
+  window_ = std::max(1, window);
+  metric_count_ = std::max(0, std::min(metric_count, VP_MAX_ITEMS));
+  float total_weight = 0.0f;
+  for (int m = 0; m < metric_count_; ++m) {
+    weights_[m] = weights[m];
+    total_weight += weights[m];
+  }
+  for (int m = 0; m < metric_count_; ++m) {
+    weights_[m] = total_weight > 0.0f ? weights_[m] / total_weight
+                                      : 1.0f / static_cast<float>(metric_count_);
+  }
+
+  const size_t ring = static_cast<size_t>(window_) * static_cast<size_t>(metric_count_);
+  scores_.resize(ring);
+  raws_.resize(ring);
+  deque_frames_.resize(ring);
+  composites_.resize(static_cast<size_t>(window_));
+  for (int m = 0; m < metric_count_; ++m) {
+    deques_[m] = MinDeque{};
+    score_sums_[m] = 0.0;
+    raw_sums_[m] = 0.0;
+  }
+  composite_sum_ = 0.0;
+  count_ = 0;
+  has_best_ = false;
+  best_start_ = 0;
+  best_length_ = 0;
+  best_mean_ = 0.0;
+  best_score_ = 0.0f;
+}
+
+void SegmentFinder::push(const float* scores, const float* raws) {
+  const int frame = count_;
+  const int slot = frame % window_;
+  const bool full = frame >= window_;
+  float composite = 0.0f;
+  for (int m = 0; m < metric_count_; ++m) {
+    float* score_ring = &scores_[static_cast<size_t>(m) * window_];
+    float* raw_ring = &raws_[static_cast<size_t>(m) * window_];
+    int* deque = &deque_frames_[static_cast<size_t>(m) * window_];
+    MinDeque& q = deques_[m];
+
+    // The frame leaving the window occupies the slot being overwritten.
+    if (full) {
+      score_sums_[m] -= score_ring[slot];
+      raw_sums_[m] -= raw_ring[slot];
+      if (q.size > 0 && deque[q.head] <= frame - window_) {
+        q.head = (q.head + 1) % window_;
+        --q.size;
+      }
+    }
+    score_ring[slot] = scores[m];
+    raw_ring[slot] = raws[m];
+    score_sums_[m] += scores[m];
+    raw_sums_[m] += raws[m];
+    while (q.size > 0 &&
+           score_ring[deque[(q.head + q.size - 1) % window_] % window_] >= scores[m]) {
+      --q.size;
+    }
+    deque[(q.head + q.size) % window_] = frame;
+    ++q.size;
+
+    composite += weights_[m] * scores[m];
+  }
+  if (full) {
+    composite_sum_ -= composites_[slot];
+  }
+  composites_[slot] = composite;
+  composite_sum_ += composite;
+  ++count_;
+
+  // Composite scores are floats and the running sum drifts, so windows that
+  // tie exactly can differ by a few ulps; only a clear gain replaces the best.
+  if (count_ >= window_ && (!has_best_ || composite_sum_ / window_ > best_mean_ + kTieEpsilon)) {
+    snapshot(window_);
+  }
+}
+
+bool SegmentFinder::finish() {
+  if (count_ == 0) {
+    return false;
+  }
+  if (!has_best_) {
+    snapshot(count_);
+  }
+  return true;
+}
+
+void SegmentFinder::snapshot(int length) {
+  has_best_ = true;
+  best_start_ = count_ - length;
+  best_length_ = length;
+  best_mean_ = composite_sum_ / length;
+  best_score_ = static_cast<float>(best_mean_);
+  for (int m = 0; m < metric_count_; ++m) {
+    const int worst = deque_frames_[static_cast<size_t>(m) * window_ + deques_[m].head] % window_;
+    MetricWindow& out = best_metrics_[m];
+    out.mean_score = static_cast<float>(score_sums_[m] / length);
+    out.mean_raw = static_cast<float>(raw_sums_[m] / length);
+    out.worst_score = scores_[static_cast<size_t>(m) * window_ + worst];
+    out.worst_raw = raws_[static_cast<size_t>(m) * window_ + worst];
+  }
+}
+
+} // namespace vp
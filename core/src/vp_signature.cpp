@@ -0,0 +1,344 @@
+#include "vp_signature.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <new>
+
+#include "vp_phash.h"
+#include "vp_pixel_access.h"
+
+namespace vp {
+
+namespace {
+
+constexpr char kIndexMagic[4] = {'V', 'P', 'S', 'I'};
+constexpr uint32_t kIndexVersion = 1;
+// video_id, hash_count, hashes.
+constexpr size_t kEntryBytes = 8 + 4 + 8 * VP_SIGNATURE_HASHES;
+
+// Makes room for `extra` more elements, growing geometrically, so that many
+// push_backs cannot throw.
+template <class T>
+void reserve_more(std::vector<T>* items, size_t extra) {
+  if (items->capacity() - items->size() < extra) {
+    items->reserve(std::max(items->size() + extra, 2 * items->capacity()));
+  }
+}
+
+void put_u32(uint8_t* out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+void put_u64(uint8_t* out, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    out[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+uint32_t get_u32(const uint8_t* in) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) {
+    value |= static_cast<uint32_t>(in[i]) << (8 * i);
+  }
+  return value;
+}
+
+uint64_t get_u64(const uint8_t* in) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i) {
+    value |= static_cast<uint64_t>(in[i]) << (8 * i);
+  }
+  return value;
+}
+
+bool is_informative(uint64_t hash) {
+  int bits = __builtin_popcountll(hash);
+  return bits >= kSignatureMinBits && bits <= 64 - kSignatureMinBits;
+}
+
+} // namespace
+
+int compute_signature(const VpFrame* frames, int frame_count, VpVideoSignature* out_signature) {
+  if (!frames || frame_count <= 0 || !out_signature) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  VpVideoSignature signature{};
+  const int positions = std::min(frame_count, VP_SIGNATURE_HASHES);
+  for (int i = 0; i < positions; ++i) {
+    const int index =
+        positions > 1 ? static_cast<int>(static_cast<int64_t>(i) * (frame_count - 1) / (positions - 1))
+                      : 0;
+    const VpFrame& frame = frames[index];
+    FrameHashFn hasher = is_valid_frame(frame) ? select_frame_hash(frame.format) : nullptr;
+    if (!hasher) {
+      continue;
+    }
+    uint64_t hash = hasher(frame);
+    if (is_informative(hash)) {
+      signature.hashes[signature.hash_count++] = hash;
+    }
+  }
+  *out_signature = signature;
+  return VP_OK;
+}
+
+bool SignatureIndex::add(const VpVideoSignature& signature, uint64_t video_id) {
+  if (signature.hash_count <= 0 || signature.hash_count > VP_SIGNATURE_HASHES) {
+    return false;
+  }
+  // Everything that can throw happens before the index changes, so a failed
+  // add leaves it as it was.
+  if (heads_.empty()) {
+    heads_.assign(static_cast<size_t>(kBands) << kBandBits, kNoNode);
+  }
+  reserve_more(&entries_, 1);
+  reserve_more(&nodes_, static_cast<size_t>(signature.hash_count) * kBands);
+  entries_.push_back({video_id, signature});
+  insert_bands(static_cast<uint32_t>(entries_.size() - 1));
+  return true;
+}
+
+void SignatureIndex::insert_bands(uint32_t entry) {
+  if (heads_.empty()) {
+    heads_.assign(static_cast<size_t>(kBands) << kBandBits, kNoNode);
+  }
+  const VpVideoSignature& signature = entries_[entry].signature;
+  for (int i = 0; i < signature.hash_count; ++i) {
+    for (int band = 0; band < kBands; ++band) {
+      uint32_t& head = heads_[band_key(signature.hashes[i], band)];
+      // Lists are prepended in entry order, so a repeat within one clip is the head.
+      if (head != kNoNode && nodes_[head].entry == entry) {
+        continue;
+      }
+      nodes_.push_back({entry, head});
+      head = static_cast<uint32_t>(nodes_.size() - 1);
+    }
+  }
+}
+
+void SignatureIndex::query(const VpVideoSignature& signature, const VpSignatureQuery& query,
+                           VpSignatureMatch* out_match) const {
+  *out_match = VpSignatureMatch{};
+  const int hash_count = std::min(signature.hash_count, VP_SIGNATURE_HASHES);
+  if (hash_count <= 0 || heads_.empty()) {
+    return;
+  }
+
+  std::vector<uint32_t> candidates;
+  for (int i = 0; i < hash_count; ++i) {
+    for (int band = 0; band < kBands; ++band) {
+      for (uint32_t node = heads_[band_key(signature.hashes[i], band)]; node != kNoNode;
+           node = nodes_[node].next) {
+        candidates.push_back(nodes_[node].entry);
+      }
+    }
+  }
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+  const int required = std::max(
+      1, static_cast<int>(std::ceil(static_cast<double>(query.min_match_ratio) * hash_count)));
+  for (uint32_t candidate : candidates) {
+    const VpVideoSignature& indexed = entries_[candidate].signature;
+    int matched = 0;
+    int missed = 0;
+    int total_distance = 0;
+    // Most candidates share a single band by chance; stop once they cannot
+    // reach `required` any more.
+    for (int i = 0; i < hash_count && missed <= hash_count - required; ++i) {
+      int best = 65;
+      for (int j = 0; j < indexed.hash_count; ++j) {
+        best = std::min(best, hamming_distance(signature.hashes[i], indexed.hashes[j]));
+      }
+      if (best <= query.max_distance) {
+        ++matched;
+        total_distance += best;
+      } else {
+        ++missed;
+      }
+    }
+    if (matched < required) {
+      continue;
+    }
+    if (!out_match->found || matched > out_match->matched_hashes ||
+        (matched == out_match->matched_hashes && total_distance < out_match->total_distance)) {
+      out_match->found = 1;
+      out_match->video_id = entries_[candidate].video_id;
+      out_match->matched_hashes = matched;
+      out_match->total_distance = total_distance;
+    }
+  }
+}
+
+int SignatureIndex::save(const char* path) const {
+  std::vector<uint8_t> bytes(16 + entries_.size() * kEntryBytes);
+  uint8_t* out = bytes.data();
+  std::copy(kIndexMagic, kIndexMagic + 4, out);
+  put_u32(out + 4, kIndexVersion);
+  put_u64(out + 8, static_cast<uint64_t>(entries_.size()));
+  out += 16;
+  for (const Entry& entry : entries_) {
+    put_u64(out, entry.video_id);
+    put_u32(out + 8, static_cast<uint32_t>(entry.signature.hash_count));
+    for (int i = 0; i < VP_SIGNATURE_HASHES; ++i) {
+      put_u64(out + 12 + 8 * i, entry.signature.hashes[i]);
+    }
+    out += kEntryBytes;
+  }
+
+  std::FILE* file = std::fopen(path, "wb");
+  if (!file) {
+    return VP_ERR_IO;
+  }
+  bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+  ok = std::fclose(file) == 0 && ok;
+  return ok ? VP_OK : VP_ERR_IO;
+}
+
+int SignatureIndex::load(const char* path) {
+  std::FILE* file = std::fopen(path, "rb");
+  if (!file) {
+    return VP_ERR_IO;
+  }
+  uint8_t header[16];
+  if (std::fread(header, 1, sizeof(header), file) != sizeof(header) ||
+      !std::equal(kIndexMagic, kIndexMagic + 4, header)) {
+    std::fclose(file);
+    return VP_ERR_IO;
+  }
+  if (get_u32(header + 4) != kIndexVersion) {
+    std::fclose(file);
+    return VP_ERR_UNSUPPORTED;
+  }
+
+  const uint64_t count = get_u64(header + 8);
+  std::vector<Entry> entries;
+  uint8_t record[kEntryBytes];
+  try {
+    entries.reserve(static_cast<size_t>(std::min<uint64_t>(count, 1u << 20)));
+    for (uint64_t n = 0; n < count; ++n) {
+      if (std::fread(record, 1, sizeof(record), file) != sizeof(record)) {
+        std::fclose(file);
+        return VP_ERR_IO;
+      }
+      Entry entry{get_u64(record), VpVideoSignature{}};
+      uint32_t hash_count = get_u32(record + 8);
+      if (hash_count == 0 || hash_count > VP_SIGNATURE_HASHES) {
+        std::fclose(file);
+        return VP_ERR_IO;
+      }
+      entry.signature.hash_count = static_cast<int32_t>(hash_count);
+      for (int i = 0; i < VP_SIGNATURE_HASHES; ++i) {
+        entry.signature.hashes[i] = get_u64(record + 12 + 8 * i);
+      }
+      entries.push_back(entry);
+    }
+  } catch (const std::bad_alloc&) {
+    std::fclose(file);
+    throw;
+  }
+  std::fclose(file);
+
+  entries_.swap(entries);
+  heads_.clear();
+  nodes_.clear();
+  nodes_.reserve(entries_.size() * VP_SIGNATURE_HASHES * kBands);
+  for (size_t entry = 0; entry < entries_.size(); ++entry) {
+    insert_bands(static_cast<uint32_t>(entry));
+  }
+  return VP_OK;
+}
+
+} // namespace vp
+
+struct VpSignatureIndex {
+  vp::SignatureIndex index;
+};
+
+int vp_compute_video_signature(const VpFrame* frames, int frame_count,
+                               VpVideoSignature* out_signature) {
+  return vp::compute_signature(frames, frame_count, out_signature);
+}
+
+VpSignatureIndex* vp_signature_index_create(void) {
+  return new (std::nothrow) VpSignatureIndex();
+}
+
+int vp_signature_index_add(VpSignatureIndex* index, const VpVideoSignature* signature,
+                           uint64_t video_id) {
+  if (!index || !signature) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  try {
+    return index->index.add(*signature, video_id) ? VP_OK : VP_ERR_INVALID_ARGUMENT;
+  } catch (const std::bad_alloc&) {
+    return VP_ERR_ALLOC;
+  }
+}
+
+void vp_default_signature_query(VpSignatureQuery* query) {
+  if (!query) {
+    return;
+  }
+  query->max_distance = 10;
+  query->min_match_ratio = 0.75f;
+}
+
+int vp_signature_index_query(const VpSignatureIndex* index, const VpVideoSignature* signature,
+                             const VpSignatureQuery* query, VpSignatureMatch* out_match) {
+  if (!index || !signature || !query || !out_match || query->max_distance < 0 ||
+      !(query->min_match_ratio >= 0.0f && query->min_match_ratio <= 1.0f)) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  try {
+    index->index.query(*signature, *query, out_match);
+  } catch (const std::bad_alloc&) {
+    *out_match = VpSignatureMatch{};
+    return VP_ERR_ALLOC;
+  }
+  return VP_OK;
+}
+
+int64_t vp_signature_index_size(const VpSignatureIndex* index) {
+  return index ? index->index.size() : 0;
+}
+
+int vp_signature_index_save(const VpSignatureIndex* index, const char* path) {
+  if (!index || !path) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  try {
+    return index->index.save(path);
+  } catch (const std::bad_alloc&) {
+    return VP_ERR_ALLOC;
+  }
+}
+
+int vp_signature_index_load(const char* path, VpSignatureIndex** out_index) {
+  if (!path || !out_index) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  VpSignatureIndex* index = new (std::nothrow) VpSignatureIndex();
+  if (!index) {
+    return VP_ERR_ALLOC;
+  }
+  int rc;
+  try {
+    rc = index->index.load(path);
+  } catch (const std::bad_alloc&) {
+    rc = VP_ERR_ALLOC;
+  }
+  if (rc != VP_OK) {
+    delete index;
+    return rc;
+  }
+  *out_index = index;
+  return VP_OK;
+}
+
+void vp_signature_index_destroy(VpSignatureIndex* index) {
+  delete index;
+}
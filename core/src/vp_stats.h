@@ -0,0 +1,130 @@
+#ifndef VP_STATS_H
+#define VP_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "vp_analyzer.h"
+
+// Set VP_ENABLE_STATS=0 to compile every counter and timer out of the pipeline.
+#ifndef VP_ENABLE_STATS
+#define VP_ENABLE_STATS 1
+#endif
+
+namespace vp {
+
+inline uint64_t monotonic_ns() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count());
+}
+
+#if VP_ENABLE_STATS
+
+struct StageCounters {
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> frames{0};
+  std::atomic<uint64_t> pixels{0};
+  std::atomic<uint64_t> bytes_copied{0};
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> nanoseconds{0};
+};
+
+struct MetricCounters {
+  std::atomic<int32_t> metric_id{-1};
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> overrides{0};
+  std::atomic<uint64_t> nanoseconds{0};
+};
+
+// Counters are relaxed atomics so a decoder thread and an analyzer thread can
+// report into the same instance; snapshots are not a consistent cut.
+class Stats {
+ public:
+  static constexpr bool kEnabled = true;
+
+  void add_stage(VpStage stage, uint64_t frames, uint64_t pixels, uint64_t bytes_copied,
+                 uint64_t nanoseconds) {
+    StageCounters& counters = stages_[stage];
+    counters.calls.fetch_add(1, std::memory_order_relaxed);
+    counters.frames.fetch_add(frames, std::memory_order_relaxed);
+    counters.pixels.fetch_add(pixels, std::memory_order_relaxed);
+    counters.bytes_copied.fetch_add(bytes_copied, std::memory_order_relaxed);
+    counters.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+  }
+
+  void add_allocation(VpStage stage) {
+    stages_[stage].allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void add_metric(int slot, int32_t id, uint64_t nanoseconds) {
+    if (slot < 0 || slot >= VP_MAX_ITEMS) {
+      return;
+    }
+    MetricCounters& counters = metrics_[slot];
+    counters.metric_id.store(id, std::memory_order_relaxed);
+    counters.calls.fetch_add(1, std::memory_order_relaxed);
+    counters.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+  }
+
+  void add_metric_override(int slot, int32_t id) {
+    if (slot < 0 || slot >= VP_MAX_ITEMS) {
+      return;
+    }
+    MetricCounters& counters = metrics_[slot];
+    counters.metric_id.store(id, std::memory_order_relaxed);
+    counters.overrides.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void add_near_duplicate() { near_duplicates_.fetch_add(1, std::memory_order_relaxed); }
+
+  void snapshot(VpStats* out) const;
+  void reset();
+
+ private:
+  std::atomic<uint64_t> near_duplicates_{0};
+  StageCounters stages_[VP_STAGE_COUNT];
+  MetricCounters metrics_[VP_MAX_ITEMS];
+};
+
+// Measures one stage interval; call stop() once the work is done.
+class StageTimer {
+ public:
+  StageTimer() : start_(monotonic_ns()) {}
+  uint64_t stop() const { return monotonic_ns() - start_; }
+
+ private:
+  uint64_t start_;
+};
+
+#else
+
+class Stats {
+ public:
+  static constexpr bool kEnabled = false;
+
+  void add_stage(VpStage, uint64_t, uint64_t, uint64_t, uint64_t) {}
+  void add_allocation(VpStage) {}
+  void add_metric(int, int32_t, uint64_t) {}
+  void add_metric_override(int, int32_t) {}
+  void add_near_duplicate() {}
+  void snapshot(VpStats*) const {}
+  void reset() {}
+};
+
+class StageTimer {
+ public:
+  uint64_t stop() const { return 0; }
+};
+
+#endif // VP_ENABLE_STATS
+
+// The counters vp_get_stats reports for `analyzer`, for code outside the
+// analyzer that times its own stages (FfmpegDecoder::attach). Null for a null
+// analyzer.
+Stats* analyzer_stats(VpAnalyzer* analyzer);
+
+} // namespace vp
+
+#endif // VP_STATS_H
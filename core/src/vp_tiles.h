@@ -0,0 +1,83 @@
+#ifndef VP_TILES_H
+#define VP_TILES_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "vp_analyzer.h"
+
+namespace vp {
+
+// Per-frame tile accumulators filled by the metric kernels during their
+// normal traversal. Sums are kept per tile so the grid costs one extra add
+// per row segment rather than a second pass over each tile.
+struct TileFrameSums {
+  int cols = 0;
+  int rows = 0;
+  int col_begin[VP_MAX_GRID_DIM + 1] = {};
+  int row_begin[VP_MAX_GRID_DIM + 1] = {};
+
+  double sharp_sum[VP_MAX_TILES];
+  double sharp_sum_sq[VP_MAX_TILES];
+  int64_t sharp_count[VP_MAX_TILES];
+  int64_t clipped[VP_MAX_TILES];
+  int64_t exposure_count[VP_MAX_TILES];
+  double noise_sum[VP_MAX_TILES];
+  int64_t noise_count[VP_MAX_TILES];
+
+  void begin_frame(int grid_cols, int grid_rows, int width, int height) {
+    cols = grid_cols;
+    rows = grid_rows;
+    for (int i = 0; i <= cols; ++i) {
+      col_begin[i] = static_cast<int>(static_cast<int64_t>(i) * width / cols);
+    }
+    for (int i = 0; i <= rows; ++i) {
+      row_begin[i] = static_cast<int>(static_cast<int64_t>(i) * height / rows);
+    }
+    size_t tiles = static_cast<size_t>(cols * rows);
+    std::memset(sharp_sum, 0, tiles * sizeof(sharp_sum[0]));
+    std::memset(sharp_sum_sq, 0, tiles * sizeof(sharp_sum_sq[0]));
+    std::memset(sharp_count, 0, tiles * sizeof(sharp_count[0]));
+    std::memset(clipped, 0, tiles * sizeof(clipped[0]));
+    std::memset(exposure_count, 0, tiles * sizeof(exposure_count[0]));
+    std::memset(noise_sum, 0, tiles * sizeof(noise_sum[0]));
+    std::memset(noise_count, 0, tiles * sizeof(noise_count[0]));
+  }
+
+  // Tile row containing pixel row y; rows are visited in order so callers
+  // advance a cursor instead of dividing.
+  int advance_row(int tile_row, int y) const {
+    while (tile_row + 1 < rows && y >= row_begin[tile_row + 1]) {
+      ++tile_row;
+    }
+    return tile_row;
+  }
+
+  float sharpness(int tile) const {
+    if (sharp_count[tile] == 0) {
+      return 0.0f;
+    }
+    double n = static_cast<double>(sharp_count[tile]);
+    double mean = sharp_sum[tile] / n;
+    double variance = sharp_sum_sq[tile] / n - mean * mean;
+    return static_cast<float>(variance < 0.0 ? 0.0 : variance);
+  }
+
+  float exposure(int tile) const {
+    if (exposure_count[tile] == 0) {
+      return 0.0f;
+    }
+    return static_cast<float>(clipped[tile]) / static_cast<float>(exposure_count[tile]);
+  }
+
+  float noise(int tile) const {
+    if (noise_count[tile] == 0) {
+      return 0.0f;
+    }
+    return static_cast<float>(noise_sum[tile] / static_cast<double>(noise_count[tile])) / 255.0f;
+  }
+};
+
+} // namespace vp
+
+#endif // VP_TILES_H
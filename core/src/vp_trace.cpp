@@ -0,0 +1,147 @@
+#include "vp_trace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace vp {
+
+namespace {
+
+std::atomic<uint64_t> g_next_tracer_id{1};
+
+struct ThreadBufferCache {
+  uint64_t tracer_id = 0;
+  void* buffer = nullptr;
+};
+
+thread_local ThreadBufferCache t_buffer_cache;
+
+void write_json_string(std::FILE* file, const char* text) {
+  std::fputc('"', file);
+  for (const char* c = text ? text : ""; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      std::fputc('\\', file);
+      std::fputc(*c, file);
+    } else if (static_cast<unsigned char>(*c) < 0x20) {
+      std::fprintf(file, "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(*c)));
+    } else {
+      std::fputc(*c, file);
+    }
+  }
+  std::fputc('"', file);
+}
+
+} // namespace
+
+Tracer::Tracer(size_t events_per_thread)
+    : id_(g_next_tracer_id.fetch_add(1, std::memory_order_relaxed)),
+      capacity_(events_per_thread > 0 ? events_per_thread : 1),
+      origin_ns_(monotonic_ns()) {}
+
+Tracer::ThreadBuffer* Tracer::thread_buffer() {
+  ThreadBufferCache& cache = t_buffer_cache;
+  if (cache.tracer_id == id_) {
+    return static_cast<ThreadBuffer*>(cache.buffer);
+  }
+
+  std::lock_guard<std::mutex> lock(registry_mutex_);
+  std::thread::id self = std::this_thread::get_id();
+  for (const auto& existing : buffers_) {
+    if (existing->owner == self) {
+      cache.tracer_id = id_;
+      cache.buffer = existing.get();
+      return existing.get();
+    }
+  }
+  auto buffer = std::make_unique<ThreadBuffer>();
+  buffer->owner = self;
+  buffer->tid = static_cast<uint32_t>(buffers_.size() + 1);
+  buffer->events.reset(new (std::nothrow) TraceEvent[capacity_]);
+  if (!buffer->events) {
+    return nullptr;
+  }
+  buffers_.push_back(std::move(buffer));
+  cache.tracer_id = id_;
+  cache.buffer = buffers_.back().get();
+  return buffers_.back().get();
+}
+
+void Tracer::record(const char* name, const char* category, uint64_t start_ns, uint64_t duration_ns,
+                    int64_t frame) {
+  ThreadBuffer* buffer = thread_buffer();
+  if (!buffer) {
+    return;
+  }
+  size_t index = buffer->count.load(std::memory_order_relaxed);
+  if (index >= capacity_) {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer->events[index] = TraceEvent{name, category, start_ns, duration_ns, frame};
+  buffer->count.store(index + 1, std::memory_order_release);
+}
+
+uint64_t Tracer::dropped_events() const {
+  std::lock_guard<std::mutex> lock(registry_mutex_);
+  uint64_t dropped = 0;
+  for (const auto& buffer : buffers_) {
+    dropped += buffer->dropped.load(std::memory_order_relaxed);
+  }
+  return dropped;
+}
+
+bool Tracer::write_chrome_json(const char* path) const {
+  if (!path) {
+    return false;
+  }
+  std::FILE* file = std::fopen(path, "w");
+  if (!file) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(registry_mutex_);
+  std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+                     "\"args\":{\"name\":\"vp_scoring\"}}");
+  for (const auto& buffer : buffers_) {
+    std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                       "\"args\":{\"name\":\"vp_thread_%u\"}}",
+                 buffer->tid, buffer->tid);
+    size_t count = buffer->count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+      const TraceEvent& event = buffer->events[i];
+      double ts_us = static_cast<double>(event.start_ns - origin_ns_) / 1000.0;
+      double dur_us = static_cast<double>(event.duration_ns) / 1000.0;
+      std::fprintf(file, ",\n{\"name\":");
+      write_json_string(file, event.name);
+      std::fprintf(file, ",\"cat\":");
+      write_json_string(file, event.category);
+      std::fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", buffer->tid,
+                   ts_us, dur_us);
+      if (event.frame >= 0) {
+        std::fprintf(file, ",\"args\":{\"frame\":%lld}", static_cast<long long>(event.frame));
+      }
+      std::fputc('}', file);
+    }
+  }
+  std::fprintf(file, "\n]}\n");
+  return std::fclose(file) == 0;
+}
+
+bool trace_enabled_from_env(const char** out_path) {
+  const char* value = std::getenv("VP_TRACE");
+  if (out_path) {
+    *out_path = nullptr;
+  }
+  if (!value || value[0] == '\0' || std::strcmp(value, "0") == 0) {
+    return false;
+  }
+  if (out_path && std::strcmp(value, "1") != 0) {
+    *out_path = value;
+  }
+  return true;
+}
+
+} // namespace vp
@@ -0,0 +1,97 @@
+#ifndef VP_TRACE_H
+#define VP_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vp_stats.h"
+
+namespace vp {
+
+struct TraceEvent {
+  const char* name;
+  const char* category;
+  uint64_t start_ns;
+  uint64_t duration_ns;
+  int64_t frame;
+};
+
+// Collects complete ("X") events into one fixed-size buffer per recording
+// thread. Appends never take a lock: each buffer has a single writer and
+// publishes its length with a release store. Only the first event of a thread
+// registers its buffer under the mutex. Events past capacity are dropped and
+// counted rather than wrapping, so a dump never races a writer.
+class Tracer {
+ public:
+  explicit Tracer(size_t events_per_thread = 1 << 16);
+
+  Tracer(const Tracer&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+
+  void record(const char* name, const char* category, uint64_t start_ns, uint64_t duration_ns,
+              int64_t frame);
+
+  // Writes Chrome trace event JSON (loadable by chrome://tracing and Perfetto).
+  // Call while no thread is recording into this tracer.
+  bool write_chrome_json(const char* path) const;
+
+  uint64_t dropped_events() const;
+
+ private:
+  struct ThreadBuffer {
+    std::thread::id owner;
+    uint32_t tid = 0;
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<size_t> count{0};
+    std::atomic<uint64_t> dropped{0};
+  };
+
+  ThreadBuffer* thread_buffer();
+
+  uint64_t id_;
+  size_t capacity_;
+  uint64_t origin_ns_;
+  mutable std::mutex registry_mutex_;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+};
+
+// Records the enclosing scope as one event. A null tracer costs one branch.
+class TraceScope {
+ public:
+  TraceScope(Tracer* tracer, const char* name, const char* category, int64_t frame = -1)
+      : tracer_(tracer), name_(name), category_(category), frame_(frame),
+        start_ns_(tracer ? monotonic_ns() : 0) {}
+
+  ~TraceScope() {
+    if (tracer_) {
+      tracer_->record(name_, category_, start_ns_, monotonic_ns() - start_ns_, frame_);
+    }
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+ private:
+  Tracer* tracer_;
+  const char* name_;
+  const char* category_;
+  int64_t frame_;
+  uint64_t start_ns_;
+};
+
+// VP_TRACE=1 enables tracing; any other non-empty value except "0" is also
+// taken as the output path written when the analyzer is destroyed.
+bool trace_enabled_from_env(const char** out_path);
+
+// The timeline vp_write_trace dumps for `analyzer`; null when the analyzer
+// does not record one.
+Tracer* analyzer_tracer(VpAnalyzer* analyzer);
+
+} // namespace vp
+
+#endif // VP_TRACE_H
@@ -0,0 +1,680 @@
+// Differential test and perf gate for the metric kernels.
+//
+//   vp_kernel_test diff [--iterations <n>] [--seed <s>]
+//   vp_kernel_test perf --baseline <file> [--tolerance <t>] [--update]
+//
+// diff fuzzes frame geometry, strides, pixel formats and content, runs the
+// library kernels (through the per-format pipelines, as the analyzer does)
+// and checks them against the frozen scalar references. perf times each
+// kernel against its reference on a 720p frame and fails when a speedup
+// drops more than `tolerance` below the baseline file. Speedups rather than
+// absolute throughput are stored so one baseline holds across machines.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "vp_metric_kernels.h"
+#include "vp_motion.h"
+#include "vp_pipeline.h"
+#include "vp_pixel_access.h"
+#include "vp_reference_kernels.h"
+#include "vp_scratch.h"
+#include "vp_simd.h"
+
+namespace {
+
+using vp_reference::LumaPlane;
+
+constexpr VpPixelFormat kFormats[] = {VP_PIXEL_GRAY8, VP_PIXEL_RGBA8888, VP_PIXEL_BGRA8888,
+                                      VP_PIXEL_NV12, VP_PIXEL_I420};
+
+const char* format_name(VpPixelFormat format) {
+  switch (format) {
+    case VP_PIXEL_GRAY8:
+      return "gray8";
+    case VP_PIXEL_RGBA8888:
+      return "rgba";
+    case VP_PIXEL_BGRA8888:
+      return "bgra";
+    case VP_PIXEL_NV12:
+      return "nv12";
+    case VP_PIXEL_I420:
+      return "i420";
+    default:
+      return "?";
+  }
+}
+
+// A frame that owns its pixels. Planar formats carry only the Y plane, which
+// is all the kernels read.
+struct TestFrame {
+  std::vector<uint8_t> bytes;
+  VpFrame frame{};
+};
+
+enum class Content { kNoise, kGradient, kClipped, kChecker };
+
+// Position hash, so a shifted frame repeats the same pattern.
+uint32_t position_hash(int x, int y) {
+  uint32_t h = static_cast<uint32_t>(x) * 0x9e3779b1u ^ static_cast<uint32_t>(y) * 0x85ebca77u;
+  h ^= h >> 15;
+  h *= 0x2c1b3c6du;
+  return h ^ (h >> 13);
+}
+
+uint8_t content_value(Content content, int x, int y, uint32_t hash) {
+  switch (content) {
+    case Content::kNoise:
+      return static_cast<uint8_t>(hash);
+    case Content::kGradient:
+      return static_cast<uint8_t>((x * 3 + y * 5) / 2 + hash % 9);
+    case Content::kClipped:
+      return hash % 3 == 0 ? static_cast<uint8_t>(250 + (hash >> 8) % 6)
+                           : static_cast<uint8_t>((hash >> 8) % 7);
+    case Content::kChecker:
+      return ((x / 4 + y / 4) & 1) ? 230 : 20;
+  }
+  return 0;
+}
+
+// Fills a frame whose luma-bearing bytes follow `content`, shifted by
+// (shift_x, shift_y) so a second frame looks like camera motion. Row padding
+// is random so reads past the row end would show.
+void fill_frame(TestFrame* out, int width, int height, int padding, VpPixelFormat format,
+                Content content, int shift_x, int shift_y, std::mt19937& rng) {
+  const int bpp = vp::bytes_per_pixel(format);
+  const int stride = width * bpp + padding;
+  out->bytes.resize(static_cast<size_t>(stride) * height);
+  for (uint8_t& byte : out->bytes) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  for (int y = 0; y < height; ++y) {
+    uint8_t* row = out->bytes.data() + static_cast<size_t>(y) * stride;
+    for (int x = 0; x < width; ++x) {
+      const int sx = x + shift_x;
+      const int sy = y + shift_y;
+      for (int c = 0; c < bpp; ++c) {
+        row[x * bpp + c] = content_value(content, sx, sy, position_hash(sx * 4 + c, sy));
+      }
+    }
+  }
+  out->frame = VpFrame{width, height, stride, format, out->bytes.data()};
+}
+
+// Widths and heights from the degenerate 1xN / Nx1 cases up to sizes that
+// take the block-motion path (and its downsampling above 240 lines).
+void pick_size(std::mt19937& rng, int* width, int* height) {
+  auto range = [&rng](int lo, int hi) { return lo + static_cast<int>(rng() % (hi - lo + 1)); };
+  switch (rng() % 6) {
+    case 0:
+      *width = 1;
+      *height = range(1, 64);
+      break;
+    case 1:
+      *width = range(1, 64);
+      *height = 1;
+      break;
+    case 2:
+      *width = range(2, 8);
+      *height = range(2, 8);
+      break;
+    case 3:
+      *width = range(3, 48);
+      *height = range(3, 48);
+      break;
+    case 4:
+      *width = range(16, 200);
+      *height = range(16, 120);
+      break;
+    default:
+      *width = range(240, 400);
+      *height = range(240, 300);
+      break;
+  }
+}
+
+struct Checker {
+  int checks = 0;
+  int failures = 0;
+  std::string label;
+
+  // |got - want| <= rel * |want|; rel 0 demands bit-identical values.
+  void close(const char* what, double got, double want, double rel) {
+    ++checks;
+    bool ok = got == want || std::abs(got - want) <= rel * std::abs(want);
+    if (!ok) {
+      fail(what, got, want);
+    }
+  }
+
+  void equal(const char* what, uint64_t got, uint64_t want) {
+    ++checks;
+    if (got != want) {
+      fail(what, static_cast<double>(got), static_cast<double>(want));
+    }
+  }
+
+  void fail(const char* what, double got, double want) {
+    if (++failures <= 20) {
+      std::fprintf(stderr, "FAIL %s %s: got %.9g want %.9g\n", label.c_str(), what, got, want);
+    }
+  }
+};
+
+// Relative tolerance for values summed in a different order than the
+// reference (tiled noise); everything else must match exactly.
+constexpr double kReorderedSumTolerance = 1e-5;
+
+void check_pipeline(const TestFrame& current, const TestFrame& previous, bool with_prev,
+                    const VpFrameExtras* extras, Checker* checker) {
+  const VpFrame& frame = current.frame;
+  const LumaPlane luma = vp_reference::to_luma(frame);
+
+  vp::Stats stats;
+  vp::ScratchArena arena;
+  vp::MotionEstimator motion(&arena);
+  vp::LumaHistogram histogram{};
+  vp::PipelineContext context{&stats,     nullptr, 0,      nullptr, &motion, vp::ClipLevels{},
+                              &histogram, nullptr, &arena};
+  float raw[vp::kBuiltinMetricCount] = {};
+  vp::select_pipeline(frame.format)(frame, with_prev ? &previous.frame : nullptr, extras,
+                                    vp::kAllBuiltinMetrics, raw, context);
+
+  // Packed RGB runs banded with scratch and one pass per metric without it.
+  vp::LumaHistogram unbanded_histogram{};
+  vp::PipelineContext unbanded{&stats,  nullptr, 0, nullptr, nullptr, vp::ClipLevels{},
+                               &unbanded_histogram, nullptr, nullptr};
+  float unbanded_raw[vp::kBuiltinMetricCount] = {};
+  const uint32_t unbanded_mask = vp::kAllBuiltinMetrics & ~vp::metric_bit(VP_METRIC_MOTION_BLUR);
+  vp::select_pipeline(frame.format)(frame, nullptr, extras, unbanded_mask, unbanded_raw, unbanded);
+  for (VpMetricId id : {VP_METRIC_SHARPNESS, VP_METRIC_EXPOSURE, VP_METRIC_NOISE,
+                        VP_METRIC_PERSON_BLUR}) {
+    checker->close("unbanded", unbanded_raw[id], raw[id], 0.0);
+  }
+
+  // The autotuner may pick either variant for any format.
+  for (vp::PipelineVariant variant : {vp::PipelineVariant::kPerMetric, vp::PipelineVariant::kBanded}) {
+    vp::ScratchArena variant_arena;
+    vp::LumaHistogram variant_histogram{};
+    vp::PipelineContext variant_context{&stats,  nullptr, 0, nullptr, nullptr, vp::ClipLevels{},
+                                        &variant_histogram, nullptr, &variant_arena};
+    float variant_raw[vp::kBuiltinMetricCount] = {};
+    vp::select_pipeline(frame.format, variant)(frame, nullptr, extras, unbanded_mask, variant_raw,
+                                               variant_context);
+    const char* label = variant == vp::PipelineVariant::kBanded ? "banded" : "per_metric";
+    for (VpMetricId id : {VP_METRIC_SHARPNESS, VP_METRIC_EXPOSURE, VP_METRIC_NOISE,
+                          VP_METRIC_PERSON_BLUR}) {
+      checker->close(label, variant_raw[id], raw[id], 0.0);
+    }
+    for (int bin = 0; bin < 256; ++bin) {
+      checker->equal(label, variant_histogram.bins[bin], histogram.bins[bin]);
+    }
+  }
+
+  const vp::ClipLevels levels;
+  const float sharpness = vp_reference::sharpness(luma);
+  checker->close("sharpness", raw[VP_METRIC_SHARPNESS], sharpness, 0.0);
+  checker->close("exposure", raw[VP_METRIC_EXPOSURE],
+                 vp_reference::exposure(luma, levels.low, levels.high), 0.0);
+  checker->close("noise", raw[VP_METRIC_NOISE], vp_reference::noise(luma), 0.0);
+
+  uint32_t bins[256];
+  vp_reference::histogram(luma, bins);
+  for (int bin = 0; bin < 256; ++bin) {
+    checker->equal("histogram", histogram.bins[bin], bins[bin]);
+  }
+  checker->equal("histogram total", histogram.total, luma.pixels.size());
+
+  float person = sharpness;
+  float region_raw = 0.0f;
+  if (vp::has_person_region(extras) && vp_reference::person_sharpness(luma, *extras, &region_raw)) {
+    person = region_raw;
+  }
+  checker->close("person_blur", raw[VP_METRIC_PERSON_BLUR], person, 0.0);
+
+  float motion_blur = 0.0f;
+  const VpFrame& prev = previous.frame;
+  if (with_prev && prev.width == frame.width && prev.height == frame.height) {
+    vp::ScratchArena reference_arena;
+    vp::MotionEstimator reference_motion(&reference_arena);
+    vp::MotionField field;
+    if (reference_motion.estimate(frame, prev, nullptr, &field)) {
+      motion_blur = vp_reference::motion_blur(luma, field);
+      // Every vector's SAD must be the exact SAD of its block on the
+      // reference-downsampled planes, within the search window.
+      const LumaPlane small = vp_reference::downsample(
+          luma, field.factor, frame.width / field.factor, frame.height / field.factor);
+      const LumaPlane small_prev =
+          vp_reference::downsample(vp_reference::to_luma(prev), field.factor, small.width,
+                                   small.height);
+      for (int by = 0; by < field.block_rows; ++by) {
+        for (int bx = 0; bx < field.block_cols; ++bx) {
+          const vp::MotionVector& vector = field.vectors[by * field.block_cols + bx];
+          const int x0 = bx * vp::kMotionBlockSize;
+          const int y0 = by * vp::kMotionBlockSize;
+          const int px = x0 - vector.dx;
+          const int py = y0 - vector.dy;
+          bool in_window = std::abs(vector.dx) <= vp::kMotionSearchRange &&
+                           std::abs(vector.dy) <= vp::kMotionSearchRange && px >= 0 && py >= 0 &&
+                           px + vp::kMotionBlockSize <= small.width &&
+                           py + vp::kMotionBlockSize <= small.height;
+          checker->equal("motion vector in window", in_window ? 1 : 0, 1);
+          if (in_window) {
+            checker->equal("motion vector sad", vector.sad,
+                           vp_reference::sad_16xn(&small.pixels[y0 * small.width + x0], small.width,
+                                                  &small_prev.pixels[py * small.width + px],
+                                                  small.width, vp::kMotionBlockSize));
+          }
+        }
+      }
+    }
+  }
+  checker->close("motion_blur", raw[VP_METRIC_MOTION_BLUR], motion_blur, 0.0);
+}
+
+void check_tiles(const TestFrame& current, int cols, int rows, vp::PipelineVariant variant,
+                 Checker* checker) {
+  const VpFrame& frame = current.frame;
+  const LumaPlane luma = vp_reference::to_luma(frame);
+  vp::TileFrameSums tiles;
+  tiles.begin_frame(cols, rows, frame.width, frame.height);
+
+  vp::Stats stats;
+  vp::LumaHistogram histogram{};
+  vp::ScratchArena arena;
+  vp::PipelineContext context{&stats, nullptr, 0, &tiles, nullptr, vp::ClipLevels{}, &histogram,
+                              nullptr, &arena};
+  const uint32_t mask = vp::metric_bit(VP_METRIC_SHARPNESS) | vp::metric_bit(VP_METRIC_EXPOSURE) |
+                        vp::metric_bit(VP_METRIC_NOISE);
+  float raw[vp::kBuiltinMetricCount] = {};
+  vp::select_pipeline(frame.format, variant)(frame, nullptr, nullptr, mask, raw, context);
+
+  const vp::ClipLevels levels;
+  checker->close("tiled sharpness", raw[VP_METRIC_SHARPNESS], vp_reference::sharpness(luma), 0.0);
+  checker->close("tiled exposure", raw[VP_METRIC_EXPOSURE],
+                 vp_reference::exposure(luma, levels.low, levels.high), 0.0);
+  checker->close("tiled noise", raw[VP_METRIC_NOISE], vp_reference::noise(luma),
+                 kReorderedSumTolerance);
+
+  vp_reference::TileValues expected;
+  vp_reference::tiles(luma, tiles, levels.low, levels.high, &expected);
+  for (int tile = 0; tile < cols * rows; ++tile) {
+    checker->close("tile sharpness", tiles.sharpness(tile), expected.sharpness[tile], 0.0);
+    checker->close("tile exposure", tiles.exposure(tile), expected.exposure[tile], 0.0);
+    checker->close("tile noise", tiles.noise(tile), expected.noise[tile], kReorderedSumTolerance);
+  }
+}
+
+void check_downsample(const TestFrame& current, Checker* checker) {
+  const VpFrame& frame = current.frame;
+  const LumaPlane luma = vp_reference::to_luma(frame);
+  for (int factor = 1; factor <= vp::kMotionMaxFactor; factor *= 2) {
+    const int width = frame.width / factor;
+    const int height = frame.height / factor;
+    if (width == 0 || height == 0) {
+      break;
+    }
+    std::vector<uint8_t> plane(static_cast<size_t>(width) * height);
+    vp::downsample_luma_plane(frame, factor, plane.data(), width, height);
+    const LumaPlane expected = vp_reference::downsample(luma, factor, width, height);
+    checker->equal("downsample", plane == expected.pixels ? 1 : 0, 1);
+  }
+}
+
+void check_simd(std::mt19937& rng, Checker* checker) {
+  std::vector<uint8_t> a(64 * 40);
+  std::vector<uint8_t> b(64 * 40);
+  for (size_t i = 0; i < a.size(); ++i) {
+    a[i] = static_cast<uint8_t>(rng());
+    b[i] = rng() % 4 == 0 ? static_cast<uint8_t>(rng()) : a[i];
+  }
+  const int rows = 1 + static_cast<int>(rng() % 16);
+  const int stride = 16 + static_cast<int>(rng() % 48);
+  const int offset = static_cast<int>(rng() % 16);
+  const uint32_t exact =
+      vp_reference::sad_16xn(a.data() + offset, stride, b.data(), stride, rows);
+  checker->equal("sad", vp::sad_16xn(a.data() + offset, stride, b.data(), stride, rows,
+                                     std::numeric_limits<uint32_t>::max()),
+                 exact);
+  // With a limit the result is exact below it and at least the limit above.
+  const uint32_t limit = static_cast<uint32_t>(rng() % (exact + 2));
+  const uint32_t limited = vp::sad_16xn(a.data() + offset, stride, b.data(), stride, rows, limit);
+  checker->equal("sad early exit", exact < limit ? limited == exact : limited >= limit, 1);
+
+  const int count = static_cast<int>(rng() % 200);
+  checker->equal("sum_u8", vp::sum_u8(a.data() + offset, count),
+                 vp_reference::sum_u8(a.data() + offset, count));
+}
+
+int run_diff(int iterations, uint32_t seed) {
+  std::mt19937 rng(seed);
+  Checker checker;
+  const Content contents[] = {Content::kNoise, Content::kGradient, Content::kClipped,
+                              Content::kChecker};
+  for (int iteration = 0; iteration < iterations; ++iteration) {
+    int width = 0;
+    int height = 0;
+    pick_size(rng, &width, &height);
+    const VpPixelFormat format = kFormats[rng() % 5];
+    const VpPixelFormat prev_format = rng() % 4 == 0 ? kFormats[rng() % 5] : format;
+    const Content content = contents[rng() % 4];
+    const int padding = static_cast<int>(rng() % 20);
+
+    char label[96];
+    std::snprintf(label, sizeof(label), "seed=%u iter=%d %dx%d+%d %s/%s", seed, iteration, width,
+                  height, padding, format_name(format), format_name(prev_format));
+    checker.label = label;
+
+    TestFrame current;
+    TestFrame previous;
+    fill_frame(&current, width, height, padding, format, content, 0, 0, rng);
+    // Mostly a shifted copy; sometimes a geometry change, which scores no motion.
+    const bool resized = rng() % 8 == 0;
+    fill_frame(&previous, resized ? width + 1 : width, height, static_cast<int>(rng() % 20),
+               prev_format, content, static_cast<int>(rng() % 7) - 3,
+               static_cast<int>(rng() % 7) - 3, rng);
+
+    VpRect boxes[4];
+    std::vector<uint8_t> mask;
+    VpFrameExtras extras{};
+    const int person_mode = static_cast<int>(rng() % 4);
+    if (person_mode & 1) {
+      extras.box_count = 1 + static_cast<int>(rng() % 4);
+      extras.boxes = boxes;
+      for (int i = 0; i < extras.box_count; ++i) {
+        boxes[i] = VpRect{static_cast<int32_t>(rng() % (width + 2)) - 1,
+                          static_cast<int32_t>(rng() % (height + 2)) - 1,
+                          static_cast<int32_t>(rng() % (width + 1)),
+                          static_cast<int32_t>(rng() % (height + 1))};
+      }
+    }
+    if (person_mode & 2) {
+      extras.mask_width = 1 + static_cast<int>(rng() % 24);
+      extras.mask_height = 1 + static_cast<int>(rng() % 24);
+      extras.mask_stride = extras.mask_width + static_cast<int>(rng() % 4);
+      mask.resize(static_cast<size_t>(extras.mask_stride) * extras.mask_height);
+      for (uint8_t& value : mask) {
+        value = rng() % 3 == 0 ? 0 : static_cast<uint8_t>(rng());
+      }
+      extras.mask = mask.data();
+    }
+
+    check_pipeline(current, previous, rng() % 6 != 0, person_mode ? &extras : nullptr, &checker);
+    check_tiles(current, 1 + static_cast<int>(rng() % VP_MAX_GRID_DIM),
+                1 + static_cast<int>(rng() % VP_MAX_GRID_DIM),
+                iteration % 2 ? vp::PipelineVariant::kBanded : vp::PipelineVariant::kPerMetric,
+                &checker);
+    check_downsample(current, &checker);
+    check_simd(rng, &checker);
+  }
+  std::printf("diff: %d iterations, %d checks, %d failures (seed %u)\n", iterations, checker.checks,
+              checker.failures, seed);
+  return checker.failures == 0 ? 0 : 1;
+}
+
+// Nanoseconds per call of `body`, from one sample that repeats the call for
+// at least kMinSampleNs. `calls` doubles until samples are long enough and
+// carries over to the next sample.
+constexpr double kMinSampleNs = 5e6;
+
+double sample_ns(const std::function<void()>& body, int* calls) {
+  while (true) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int call = 0; call < *calls; ++call) {
+      body();
+    }
+    const double elapsed =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (elapsed >= kMinSampleNs) {
+      return elapsed / *calls;
+    }
+    *calls *= 2;
+  }
+}
+
+struct PerfKernel {
+  const char* name;
+  std::function<void()> optimized;
+  std::function<void()> reference;
+};
+
+struct PerfResult {
+  double optimized_ns;
+  double reference_ns;
+  double speedup() const { return reference_ns / optimized_ns; }
+};
+
+// Samples alternate so frequency changes hit both sides alike.
+PerfResult measure(const PerfKernel& kernel, int samples) {
+  PerfResult result{std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+  int optimized_calls = 1;
+  int reference_calls = 1;
+  for (int sample = 0; sample < samples; ++sample) {
+    result.optimized_ns =
+        std::min(result.optimized_ns, sample_ns(kernel.optimized, &optimized_calls));
+    result.reference_ns =
+        std::min(result.reference_ns, sample_ns(kernel.reference, &reference_calls));
+  }
+  return result;
+}
+
+std::map<std::string, double> read_baseline(const char* path) {
+  std::map<std::string, double> baseline;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    char name[64];
+    double speedup = 0.0;
+    if (std::sscanf(line.c_str(), "%63s %lf", name, &speedup) == 2) {
+      baseline[name] = speedup;
+    }
+  }
+  return baseline;
+}
+
+int run_perf(const char* baseline_path, double tolerance, bool update) {
+  constexpr int kWidth = 1280;
+  constexpr int kHeight = 720;
+  constexpr int kSamples = 7;
+  constexpr int kRetries = 2;
+  std::mt19937 rng(1);
+  TestFrame gray;
+  TestFrame gray_prev;
+  fill_frame(&gray, kWidth, kHeight, 0, VP_PIXEL_GRAY8, Content::kGradient, 0, 0, rng);
+  fill_frame(&gray_prev, kWidth, kHeight, 0, VP_PIXEL_GRAY8, Content::kGradient, 3, 2, rng);
+  const LumaPlane luma = vp_reference::to_luma(gray.frame);
+  const vp::Gray8Access access(gray.frame);
+
+  vp::ScratchArena arena;
+  vp::MotionEstimator motion(&arena);
+  vp::MotionField field;
+  motion.estimate(gray.frame, gray_prev.frame, nullptr, &field);
+  const int factor = field.factor;
+  std::vector<uint8_t> small(static_cast<size_t>(kWidth / factor) * (kHeight / factor));
+
+  // Packed RGB through the banded pipeline against convert-then-measure.
+  TestFrame rgba;
+  fill_frame(&rgba, kWidth, kHeight, 0, VP_PIXEL_RGBA8888, Content::kGradient, 0, 0, rng);
+  const vp::FramePipeline rgba_pipeline = vp::select_pipeline(VP_PIXEL_RGBA8888);
+  const uint32_t band_mask = vp::metric_bit(VP_METRIC_SHARPNESS) |
+                             vp::metric_bit(VP_METRIC_EXPOSURE) | vp::metric_bit(VP_METRIC_NOISE);
+  vp::Stats band_stats;
+  LumaPlane rgba_luma;
+
+  volatile float sink = 0.0f;
+  vp::LumaHistogram histogram{};
+  uint32_t bins[256];
+  const vp::PipelineContext band_context{&band_stats, nullptr,    0,       nullptr, nullptr,
+                                         vp::ClipLevels{}, &histogram, nullptr, &arena};
+  const PerfKernel kernels[] = {
+      {"sharpness", [&] { sink = vp::sharpness_kernel(access); },
+       [&] { sink = vp_reference::sharpness(luma); }},
+      {"exposure", [&] { sink = vp::exposure_kernel(access, vp::ClipLevels{}, &histogram); },
+       [&] {
+         vp_reference::histogram(luma, bins);
+         sink = vp_reference::exposure(luma, 5, 250);
+       }},
+      {"noise", [&] { sink = vp::noise_kernel(access); },
+       [&] { sink = vp_reference::noise(luma); }},
+      {"motion_blur", [&] { sink = vp::motion_blur_kernel(access, field); },
+       [&] { sink = vp_reference::motion_blur(luma, field); }},
+      {"downsample",
+       [&] {
+         vp::downsample_luma_plane(gray.frame, factor, small.data(), kWidth / factor,
+                                   kHeight / factor);
+         sink = small[0];
+       },
+       [&] {
+         sink = vp_reference::downsample(luma, factor, kWidth / factor, kHeight / factor)
+                    .pixels[0];
+       }},
+      {"sad_16xn",
+       [&] {
+         uint32_t total = 0;
+         for (int y = 0; y + 16 <= kHeight - 1; y += 16) {
+           for (int x = 0; x + 16 <= kWidth; x += 16) {
+             total += vp::sad_16xn(&luma.pixels[y * kWidth + x], kWidth,
+                                   &luma.pixels[(y + 1) * kWidth + x], kWidth, 16,
+                                   std::numeric_limits<uint32_t>::max());
+           }
+         }
+         sink = static_cast<float>(total);
+       },
+       [&] {
+         uint32_t total = 0;
+         for (int y = 0; y + 16 <= kHeight - 1; y += 16) {
+           for (int x = 0; x + 16 <= kWidth; x += 16) {
+             total += vp_reference::sad_16xn(&luma.pixels[y * kWidth + x], kWidth,
+                                             &luma.pixels[(y + 1) * kWidth + x], kWidth, 16);
+           }
+         }
+         sink = static_cast<float>(total);
+       }},
+      {"band_rgba",
+       [&] {
+         float raw[vp::kBuiltinMetricCount];
+         rgba_pipeline(rgba.frame, nullptr, nullptr, band_mask, raw, band_context);
+         sink = raw[VP_METRIC_NOISE];
+       },
+       [&] {
+         vp_reference::to_luma(rgba.frame, &rgba_luma);
+         vp_reference::histogram(rgba_luma, bins);
+         sink = vp_reference::sharpness(rgba_luma) + vp_reference::exposure(rgba_luma, 5, 250) +
+                vp_reference::noise(rgba_luma);
+       }},
+  };
+
+  std::map<std::string, double> baseline = read_baseline(baseline_path);
+  if (baseline.empty() && !update) {
+    std::fprintf(stderr, "No baseline in %s (run with --update to create it)\n", baseline_path);
+    return 1;
+  }
+  const double pixels = static_cast<double>(kWidth) * kHeight;
+  int regressions = 0;
+  std::map<std::string, double> measured;
+  std::printf("%-16s %12s %12s %9s %9s\n", "kernel", "Mpx/s", "ref Mpx/s", "speedup", "baseline");
+  for (const PerfKernel& kernel : kernels) {
+    auto it = baseline.find(kernel.name);
+    auto regressed = [&](const PerfResult& result) {
+      return !update && it != baseline.end() && result.speedup() < it->second * (1.0 - tolerance);
+    };
+    // A shared machine can stall one measurement; only a slowdown that
+    // persists across retries counts.
+    PerfResult result = measure(kernel, kSamples);
+    for (int retry = 0; retry < kRetries && regressed(result); ++retry) {
+      PerfResult again = measure(kernel, kSamples);
+      if (again.speedup() > result.speedup()) {
+        result = again;
+      }
+    }
+    const double speedup = result.speedup();
+    measured[kernel.name] = speedup;
+    const bool is_regressed = regressed(result);
+    std::printf("%-16s %12.1f %12.1f %9.2f %9s%s\n", kernel.name,
+                pixels * 1e3 / result.optimized_ns, pixels * 1e3 / result.reference_ns, speedup,
+                it != baseline.end() ? std::to_string(it->second).substr(0, 5).c_str() : "-",
+                is_regressed ? "  REGRESSED" : "");
+    regressions += is_regressed ? 1 : 0;
+  }
+
+  if (update) {
+    std::FILE* out = std::fopen(baseline_path, "w");
+    if (!out) {
+      std::fprintf(stderr, "Failed to write %s\n", baseline_path);
+      return 1;
+    }
+    std::fprintf(out,
+                 "# Kernel speedup over the frozen reference (tests/vp_reference_kernels.cpp),\n"
+                 "# 1280x720, best of %d samples. Regenerate from a Release build:\n"
+                 "#   vp_kernel_test perf --baseline <file> --update\n",
+                 kSamples);
+    for (const auto& entry : measured) {
+      std::fprintf(out, "%s %.2f\n", entry.first.c_str(), entry.second);
+    }
+    std::fclose(out);
+    std::printf("perf: baseline written to %s\n", baseline_path);
+    return 0;
+  }
+  std::printf("perf: %d regression(s) beyond %.0f%%\n", regressions, tolerance * 100.0);
+  return regressions == 0 ? 0 : 1;
+}
+
+void print_usage(const char* program) {
+  std::fprintf(stderr,
+               "Usage: %s diff [--iterations <n>] [--seed <s>]\n"
+               "       %s perf --baseline <file> [--tolerance <fraction>] [--update]\n",
+               program, program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  int iterations = 400;
+  uint32_t seed = 20240601;
+  const char* baseline = nullptr;
+  double tolerance = 0.4;
+  bool update = false;
+  for (int i = 2; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--iterations") == 0 && has_value) {
+      iterations = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--seed") == 0 && has_value) {
+      seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (std::strcmp(argv[i], "--baseline") == 0 && has_value) {
+      baseline = argv[++i];
+    } else if (std::strcmp(argv[i], "--tolerance") == 0 && has_value) {
+      tolerance = std::atof(argv[++i]);
+    } else if (std::strcmp(argv[i], "--update") == 0) {
+      update = true;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (std::strcmp(argv[1], "diff") == 0) {
+    return run_diff(iterations, seed);
+  }
+  if (std::strcmp(argv[1], "perf") == 0 && baseline) {
+    return run_perf(baseline, tolerance, update);
+  }
+  print_usage(argv[0]);
+  return 1;
+}
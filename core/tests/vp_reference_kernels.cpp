@@ -0,0 +1,311 @@
+#include "vp_reference_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace vp_reference {
+
+namespace {
+
+int clamp_index(int value, int size) {
+  return std::min(std::max(value, 0), size - 1);
+}
+
+int laplacian(const LumaPlane& plane, int x, int y) {
+  return -4 * plane.at(x, y) + plane.at(x - 1, y) + plane.at(x + 1, y) + plane.at(x, y - 1) +
+         plane.at(x, y + 1);
+}
+
+float noise_at(const LumaPlane& plane, int x, int y) {
+  int sum = 0;
+  for (int dy = -1; dy <= 1; ++dy) {
+    for (int dx = -1; dx <= 1; ++dx) {
+      sum += plane.at(clamp_index(x + dx, plane.width), clamp_index(y + dy, plane.height));
+    }
+  }
+  float mean = static_cast<float>(sum) / 9.0f;
+  return std::abs(static_cast<float>(plane.at(x, y)) - mean);
+}
+
+bool is_clipped(int value, int low, int high) {
+  return value <= low || value >= high;
+}
+
+float variance(double sum, double sum_sq, double weight) {
+  double mean = sum / weight;
+  double value = sum_sq / weight - mean * mean;
+  return static_cast<float>(value < 0.0 ? 0.0 : value);
+}
+
+// Last grid cell whose start is at or before `position`.
+int cell_of(const int* begin, int cells, int position) {
+  int cell = 0;
+  while (cell + 1 < cells && position >= begin[cell + 1]) {
+    ++cell;
+  }
+  return cell;
+}
+
+} // namespace
+
+LumaPlane to_luma(const VpFrame& frame) {
+  LumaPlane plane;
+  to_luma(frame, &plane);
+  return plane;
+}
+
+void to_luma(const VpFrame& frame, LumaPlane* out) {
+  LumaPlane& plane = *out;
+  plane.width = frame.width;
+  plane.height = frame.height;
+  plane.pixels.resize(static_cast<size_t>(frame.width) * frame.height);
+  for (int y = 0; y < frame.height; ++y) {
+    const uint8_t* row = frame.data + static_cast<size_t>(y) * frame.stride_bytes;
+    for (int x = 0; x < frame.width; ++x) {
+      int luma = 0;
+      switch (frame.format) {
+        case VP_PIXEL_RGBA8888:
+          luma = (299 * row[4 * x] + 587 * row[4 * x + 1] + 114 * row[4 * x + 2]) / 1000;
+          break;
+        case VP_PIXEL_BGRA8888:
+          luma = (299 * row[4 * x + 2] + 587 * row[4 * x + 1] + 114 * row[4 * x]) / 1000;
+          break;
+        default:
+          luma = row[x];
+          break;
+      }
+      plane.pixels[static_cast<size_t>(y) * frame.width + x] = static_cast<uint8_t>(luma);
+    }
+  }
+}
+
+float sharpness(const LumaPlane& plane) {
+  double sum = 0.0;
+  double sum_sq = 0.0;
+  int64_t count = 0;
+  for (int y = 1; y < plane.height - 1; ++y) {
+    for (int x = 1; x < plane.width - 1; ++x) {
+      double value = static_cast<double>(laplacian(plane, x, y));
+      sum += value;
+      sum_sq += value * value;
+      ++count;
+    }
+  }
+  if (count == 0) {
+    return 0.0f;
+  }
+  return variance(sum, sum_sq, static_cast<double>(count));
+}
+
+float exposure(const LumaPlane& plane, int low, int high) {
+  int clipped = 0;
+  for (uint8_t value : plane.pixels) {
+    clipped += is_clipped(value, low, high) ? 1 : 0;
+  }
+  if (plane.pixels.empty()) {
+    return 0.0f;
+  }
+  return static_cast<float>(clipped) / static_cast<float>(plane.pixels.size());
+}
+
+void histogram(const LumaPlane& plane, uint32_t* bins) {
+  std::fill(bins, bins + 256, 0u);
+  for (uint8_t value : plane.pixels) {
+    ++bins[value];
+  }
+}
+
+float noise(const LumaPlane& plane) {
+  double accum = 0.0;
+  int64_t count = 0;
+  for (int y = 0; y < plane.height; ++y) {
+    for (int x = 0; x < plane.width; ++x) {
+      accum += noise_at(plane, x, y);
+      ++count;
+    }
+  }
+  if (count == 0) {
+    return 0.0f;
+  }
+  return static_cast<float>(accum / static_cast<double>(count)) / 255.0f;
+}
+
+float motion_blur(const LumaPlane& plane, const vp::MotionField& field) {
+  const int factor = field.factor;
+  const int block_extent = vp::kMotionBlockSize * factor;
+  double weighted_blur = 0.0;
+  double weight_sum = 0.0;
+  for (int by = 0; by < field.block_rows; ++by) {
+    for (int bx = 0; bx < field.block_cols; ++bx) {
+      const vp::MotionVector& vector = field.vectors[by * field.block_cols + bx];
+      const float motion =
+          std::sqrt(static_cast<float>(vector.dx * vector.dx + vector.dy * vector.dy)) *
+          static_cast<float>(factor);
+      int dir_x = 0;
+      int dir_y = 0;
+      if (motion > 0.0f) {
+        dir_x = static_cast<int>(std::lround(256.0f * vector.dx * factor / motion));
+        dir_y = static_cast<int>(std::lround(256.0f * vector.dy * factor / motion));
+      }
+      int64_t energy = 0;
+      int64_t parallel = 0;
+      int64_t perpendicular = 0;
+      const int y_end = std::min(plane.height - 1, (by + 1) * block_extent);
+      const int x_end = std::min(plane.width - 1, (bx + 1) * block_extent);
+      for (int y = std::max(1, by * block_extent + factor / 2); y < y_end; y += 2 * factor) {
+        for (int x = std::max(1, bx * block_extent); x < x_end; ++x) {
+          const int gx = plane.at(x + 1, y) - plane.at(x - 1, y);
+          const int gy = plane.at(x, y + 1) - plane.at(x, y - 1);
+          energy += std::abs(gx) + std::abs(gy);
+          parallel += std::abs(gx * dir_x + gy * dir_y);
+          perpendicular += std::abs(gy * dir_x - gx * dir_y);
+        }
+      }
+      weight_sum += static_cast<double>(energy);
+      if (motion > 0.0f && parallel > 0) {
+        float blur = static_cast<float>(static_cast<double>(perpendicular) /
+                                        static_cast<double>(parallel)) - 1.0f;
+        blur = std::min(std::max(blur, 0.0f), motion);
+        weighted_blur += static_cast<double>(energy) * static_cast<double>(blur);
+      } else if (motion > 0.0f && perpendicular > 0) {
+        weighted_blur += static_cast<double>(energy) * static_cast<double>(motion);
+      }
+    }
+  }
+  if (weight_sum <= 0.0) {
+    return 0.0f;
+  }
+  return static_cast<float>(weighted_blur / weight_sum);
+}
+
+bool person_sharpness(const LumaPlane& plane, const VpFrameExtras& extras, float* out_raw) {
+  const int width = plane.width;
+  const int height = plane.height;
+  if (width < 3 || height < 3) {
+    return false;
+  }
+  const int box_count = std::min<int>(extras.box_count, VP_MAX_PERSON_BOXES);
+  auto in_region = [&](int x, int y) {
+    if (box_count <= 0) {
+      return true;
+    }
+    for (int i = 0; i < box_count; ++i) {
+      const VpRect& box = extras.boxes[i];
+      if (x >= box.x && x < box.x + box.width && y >= box.y && y < box.y + box.height) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  double sum = 0.0;
+  double sum_sq = 0.0;
+  double weight_sum = 0.0;
+  for (int y = 1; y < height - 1; ++y) {
+    for (int x = 1; x < width - 1; ++x) {
+      if (!in_region(x, y)) {
+        continue;
+      }
+      double weight = 1.0;
+      if (extras.mask) {
+        int mask_x = static_cast<int>(static_cast<int64_t>(x) * extras.mask_width / width);
+        int mask_y = static_cast<int>(static_cast<int64_t>(y) * extras.mask_height / height);
+        weight = extras.mask[static_cast<size_t>(mask_y) * extras.mask_stride + mask_x];
+        if (weight == 0.0) {
+          continue;
+        }
+      }
+      double value = static_cast<double>(laplacian(plane, x, y));
+      sum += weight * value;
+      sum_sq += weight * value * value;
+      weight_sum += weight;
+    }
+  }
+  if (weight_sum <= 0.0) {
+    return false;
+  }
+  *out_raw = variance(sum, sum_sq, weight_sum);
+  return true;
+}
+
+LumaPlane downsample(const LumaPlane& plane, int factor, int dst_width, int dst_height) {
+  LumaPlane out;
+  out.width = dst_width;
+  out.height = dst_height;
+  out.pixels.resize(static_cast<size_t>(dst_width) * dst_height);
+  const uint32_t area = static_cast<uint32_t>(factor * factor);
+  for (int y = 0; y < dst_height; ++y) {
+    for (int x = 0; x < dst_width; ++x) {
+      uint32_t total = 0;
+      for (int r = 0; r < factor; ++r) {
+        for (int i = 0; i < factor; ++i) {
+          total += static_cast<uint32_t>(plane.at(x * factor + i, y * factor + r));
+        }
+      }
+      out.pixels[static_cast<size_t>(y) * dst_width + x] =
+          static_cast<uint8_t>((total + area / 2) / area);
+    }
+  }
+  return out;
+}
+
+uint32_t sad_16xn(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int rows) {
+  uint32_t total = 0;
+  for (int y = 0; y < rows; ++y) {
+    for (int x = 0; x < 16; ++x) {
+      total += static_cast<uint32_t>(std::abs(a[y * a_stride + x] - b[y * b_stride + x]));
+    }
+  }
+  return total;
+}
+
+uint32_t sum_u8(const uint8_t* data, int count) {
+  uint32_t total = 0;
+  for (int i = 0; i < count; ++i) {
+    total += data[i];
+  }
+  return total;
+}
+
+void tiles(const LumaPlane& plane, const vp::TileFrameSums& layout, int low, int high,
+           TileValues* out) {
+  const int tile_count = layout.cols * layout.rows;
+  double sharp_sum[VP_MAX_TILES] = {};
+  double sharp_sum_sq[VP_MAX_TILES] = {};
+  int64_t sharp_count[VP_MAX_TILES] = {};
+  int64_t clipped[VP_MAX_TILES] = {};
+  int64_t exposure_count[VP_MAX_TILES] = {};
+  double noise_sum[VP_MAX_TILES] = {};
+  for (int y = 0; y < plane.height; ++y) {
+    const int tile_row = cell_of(layout.row_begin, layout.rows, y);
+    for (int x = 0; x < plane.width; ++x) {
+      const int tile = tile_row * layout.cols + cell_of(layout.col_begin, layout.cols, x);
+      if (x > 0 && x < plane.width - 1 && y > 0 && y < plane.height - 1) {
+        double value = static_cast<double>(laplacian(plane, x, y));
+        sharp_sum[tile] += value;
+        sharp_sum_sq[tile] += value * value;
+        ++sharp_count[tile];
+      }
+      clipped[tile] += is_clipped(plane.at(x, y), low, high) ? 1 : 0;
+      ++exposure_count[tile];
+      noise_sum[tile] += noise_at(plane, x, y);
+    }
+  }
+  for (int tile = 0; tile < tile_count; ++tile) {
+    out->sharpness[tile] =
+        sharp_count[tile] > 0
+            ? variance(sharp_sum[tile], sharp_sum_sq[tile], static_cast<double>(sharp_count[tile]))
+            : 0.0f;
+    out->exposure[tile] = exposure_count[tile] > 0 ? static_cast<float>(clipped[tile]) /
+                                                         static_cast<float>(exposure_count[tile])
+                                                   : 0.0f;
+    out->noise[tile] = exposure_count[tile] > 0
+                           ? static_cast<float>(noise_sum[tile] /
+                                                static_cast<double>(exposure_count[tile])) /
+                                 255.0f
+                           : 0.0f;
+  }
+}
+
+} // namespace vp_reference
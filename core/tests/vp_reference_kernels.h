@@ -0,0 +1,68 @@
+#ifndef VP_REFERENCE_KERNELS_H
+#define VP_REFERENCE_KERNELS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "vp_analyzer.h"
+#include "vp_motion.h"
+#include "vp_tiles.h"
+
+// Frozen scalar reference kernels. They restate the metric definitions in
+// the plainest form (one luma conversion, then straight loops over a packed
+// plane) and must not be optimized: the differential test holds the library
+// kernels to these results, and the perf gate measures speedups against them.
+namespace vp_reference {
+
+// Packed luma plane (stride == width).
+struct LumaPlane {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+
+  int at(int x, int y) const { return pixels[static_cast<size_t>(y) * width + x]; }
+};
+
+// BT.601 integer luma for packed RGB; the Y plane for GRAY8/NV12/I420.
+LumaPlane to_luma(const VpFrame& frame);
+void to_luma(const VpFrame& frame, LumaPlane* out);
+
+// Laplacian variance over the 3x3 stencil interior.
+float sharpness(const LumaPlane& plane);
+
+// Share of pixels at or below `low` or at or above `high`.
+float exposure(const LumaPlane& plane, int low, int high);
+
+// 256-bin luma histogram.
+void histogram(const LumaPlane& plane, uint32_t* bins);
+
+// Mean absolute difference to the clamped 3x3 mean, over 255.
+float noise(const LumaPlane& plane);
+
+// Motion blur from a block motion field (see vp_metric_kernels.h).
+float motion_blur(const LumaPlane& plane, const vp::MotionField& field);
+
+// Laplacian variance over the person region; false when it is empty.
+bool person_sharpness(const LumaPlane& plane, const VpFrameExtras& extras, float* out_raw);
+
+// Rounded box average of factor x factor blocks into dst_width x dst_height.
+LumaPlane downsample(const LumaPlane& plane, int factor, int dst_width, int dst_height);
+
+// Exact SAD of a 16 x rows block.
+uint32_t sad_16xn(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int rows);
+
+uint32_t sum_u8(const uint8_t* data, int count);
+
+// Per-tile sharpness, clipped share and noise for the grid in `layout`
+// (only cols, rows, col_begin and row_begin are read).
+struct TileValues {
+  float sharpness[VP_MAX_TILES];
+  float exposure[VP_MAX_TILES];
+  float noise[VP_MAX_TILES];
+};
+void tiles(const LumaPlane& plane, const vp::TileFrameSums& layout, int low, int high,
+           TileValues* out);
+
+} // namespace vp_reference
+
+#endif // VP_REFERENCE_KERNELS_H
@@ -0,0 +1,663 @@
+// Behavioural tests for the parts of the core that are not metric kernels.
+//
+//   vp_unit_test <suite>
+//
+// Each suite is one ctest entry (see CMakeLists.txt):
+//   stats     decoder-side stage counters and trace events land in the
+//             analyzer they are attached to
+//   sampler   adaptive sampling starts from both ends of the range
+//   tiles     tile means count only the frames that computed each metric
+//   signature signature index add/query, save/load, bad files, flat clips
+//             and recall of perturbed duplicates
+//   scheduler interactive jobs overtake background ones, queued jobs cancel
+//             without a slot, aged jobs are not preempted
+//   segment   best-segment search agrees with a brute-force window scan
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vp_analyzer.h"
+#include "vp_sampler.h"
+#include "vp_segment.h"
+#include "vp_stats.h"
+#include "vp_trace.h"
+
+namespace {
+
+struct Checker {
+  int checks = 0;
+  int failures = 0;
+
+  void expect(const char* what, bool ok) {
+    ++checks;
+    if (!ok) {
+      ++failures;
+      std::fprintf(stderr, "FAIL %s\n", what);
+    }
+  }
+};
+
+// What FfmpegDecoder::attach does, without needing FFmpeg: report decode and
+// convert from another thread through the analyzer's own sinks.
+void run_stats(Checker* checker) {
+  VpConfig config;
+  vp_default_config(&config);
+  config.enable_trace = 1;
+  VpAnalyzer* analyzer = vp_create(&config);
+  checker->expect("create", analyzer != nullptr);
+  if (!analyzer) {
+    return;
+  }
+  checker->expect("null analyzer has no stats", vp::analyzer_stats(nullptr) == nullptr);
+  checker->expect("null analyzer has no tracer", vp::analyzer_tracer(nullptr) == nullptr);
+
+  vp::Stats* stats = vp::analyzer_stats(analyzer);
+  vp::Tracer* tracer = vp::analyzer_tracer(analyzer);
+  checker->expect("stats attached", stats != nullptr);
+  checker->expect("tracer attached", tracer != nullptr);
+  std::thread decoder([stats, tracer] {
+    for (int frame = 0; frame < 3; ++frame) {
+      const uint64_t start_ns = vp::monotonic_ns();
+      stats->add_stage(VP_STAGE_DECODE, 1, 64 * 48, 0, 1000);
+      tracer->record("decode", "decoder", start_ns, vp::monotonic_ns() - start_ns, frame);
+      vp::TraceScope convert(tracer, "convert", "decoder", frame);
+      stats->add_stage(VP_STAGE_CONVERT, 1, 64 * 48, 64 * 48, 500);
+    }
+  });
+  decoder.join();
+
+  VpStats out{};
+  const int status = vp_get_stats(analyzer, &out);
+  if (vp::Stats::kEnabled) {
+    checker->expect("get_stats", status == VP_OK);
+    checker->expect("decode frames", out.stages[VP_STAGE_DECODE].frames == 3);
+    checker->expect("decode time", out.stages[VP_STAGE_DECODE].nanoseconds == 3000);
+    checker->expect("convert frames", out.stages[VP_STAGE_CONVERT].frames == 3);
+    checker->expect("convert bytes", out.stages[VP_STAGE_CONVERT].bytes_copied == 3 * 64 * 48);
+  } else {
+    checker->expect("get_stats unsupported", status == VP_ERR_UNSUPPORTED);
+  }
+
+  const char* path = "vp_unit_test_trace.json";
+  checker->expect("write_trace", vp_write_trace(analyzer, path) == VP_OK);
+  std::ifstream file(path);
+  const std::string trace((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  checker->expect("decode event", trace.find("\"decode\"") != std::string::npos);
+  checker->expect("convert event", trace.find("\"convert\"") != std::string::npos);
+  file.close();
+  std::remove(path);
+  vp_destroy(analyzer);
+}
+
+void run_sampler(Checker* checker) {
+  vp::AdaptiveSampler sampler;
+  for (int initial : {-1, 0, 1, 2}) {
+    sampler.reset(0.0, 10.0, initial, 6, 0.0);
+    double time_sec = 0.0;
+    int issued = 0;
+    while (sampler.next(&time_sec)) {
+      sampler.report(static_cast<float>(issued++ % 2));
+    }
+    checker->expect("budget spent", issued == 6);
+    checker->expect("starts at start", sampler.sample(0).time == 0.0);
+    checker->expect("then the end", sampler.sample(1).time == 10.0);
+  }
+
+  // A budget of one still takes the midpoint; an empty range its only point.
+  double time_sec = 0.0;
+  sampler.reset(0.0, 10.0, 9, 1, 0.0);
+  checker->expect("single sample", sampler.next(&time_sec) && time_sec == 5.0);
+  sampler.report(1.0f);
+  checker->expect("single sample ends", !sampler.next(&time_sec));
+  sampler.reset(4.0, 4.0, 9, 6, 0.0);
+  checker->expect("empty range", sampler.next(&time_sec) && time_sec == 4.0);
+  sampler.report(1.0f);
+  checker->expect("empty range ends", !sampler.next(&time_sec));
+}
+
+// Gray frames with a different texture each, so every tile differs per frame.
+std::vector<std::vector<uint8_t>> textured_frames(int count, int width, int height) {
+  std::vector<std::vector<uint8_t>> pixels(static_cast<size_t>(count));
+  for (int i = 0; i < count; ++i) {
+    pixels[i].resize(static_cast<size_t>(width) * height);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        pixels[i][static_cast<size_t>(y) * width + x] =
+            static_cast<uint8_t>(((x / (i + 2) + y / (i + 3)) & 1) ? 40 + 30 * i : 200 - 10 * i);
+      }
+    }
+  }
+  return pixels;
+}
+
+void analyze_grid(const std::vector<VpFrame>& frames, const std::vector<VpFrameMetrics>& metrics,
+                  VpTileGrid* out_grid, Checker* checker) {
+  VpConfig config;
+  vp_default_config(&config);
+  config.grid_cols = 2;
+  config.grid_rows = 2;
+  VpAnalyzer* analyzer = vp_create(&config);
+  VpAggregateResult result;
+  checker->expect("analyze", vp_analyze_frames_with_metrics(
+                                 analyzer, frames.data(), static_cast<int>(frames.size()),
+                                 metrics.empty() ? nullptr : metrics.data(),
+                                 static_cast<int>(metrics.size()), &result) == VP_OK);
+  checker->expect("tile grid", vp_get_tile_grid(analyzer, out_grid) == VP_OK);
+  vp_destroy(analyzer);
+}
+
+void run_tiles(Checker* checker) {
+  const int width = 64;
+  const int height = 48;
+  const auto pixels = textured_frames(4, width, height);
+  std::vector<VpFrame> frames;
+  for (const auto& frame_pixels : pixels) {
+    frames.push_back(VpFrame{width, height, width, VP_PIXEL_GRAY8, frame_pixels.data()});
+  }
+
+  // Sharpness supplied for frames 1 and 3: the sharpness tiles are the mean
+  // of frames 0 and 2 alone, the other metrics still cover all four.
+  const VpMetricValue sharpness{VP_METRIC_SHARPNESS, 1.0f};
+  const VpFrameMetrics none{0, nullptr};
+  const VpFrameMetrics supplied{1, &sharpness};
+  VpTileGrid mixed{};
+  analyze_grid(frames, {none, supplied, none, supplied}, &mixed, checker);
+  VpTileGrid computed{};
+  analyze_grid({frames[0], frames[2]}, {}, &computed, checker);
+  checker->expect("frame count", mixed.frame_count == 4);
+  checker->expect("sharpness frames", mixed.sharpness_frames == 2);
+  checker->expect("exposure frames", mixed.exposure_frames == 4);
+  checker->expect("noise frames", mixed.noise_frames == 4);
+  for (int tile = 0; tile < 4; ++tile) {
+    const float want = computed.sharpness[tile];
+    checker->expect("sharpness tiled", want > 0.0f);
+    checker->expect("sharpness mean",
+                    std::fabs(mixed.sharpness[tile] - want) <= 1e-5f * std::fabs(want));
+  }
+
+  // Never computed: unavailable rather than a mean of zeros.
+  VpTileGrid overridden{};
+  analyze_grid({frames[0], frames[1]}, {supplied, supplied}, &overridden, checker);
+  checker->expect("no sharpness frames", overridden.sharpness_frames == 0);
+  checker->expect("no sharpness tiles", overridden.sharpness[0] == 0.0f);
+  checker->expect("exposure still tiled", overridden.exposure_frames == 2);
+}
+
+// A clip of smooth, slowly moving content: a few random waves per clip.
+struct Clip {
+  static constexpr int kWidth = 96;
+  static constexpr int kHeight = 64;
+  static constexpr int kFrames = 24;
+  std::vector<std::vector<uint8_t>> pixels;
+  std::vector<VpFrame> frames;
+
+  void finish() {
+    frames.clear();
+    for (const auto& frame_pixels : pixels) {
+      frames.push_back(VpFrame{kWidth, kHeight, kWidth, VP_PIXEL_GRAY8, frame_pixels.data()});
+    }
+  }
+};
+
+Clip random_clip(std::mt19937& rng) {
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  float waves[4][4];
+  for (auto& wave : waves) {
+    wave[0] = 0.02f + 0.2f * unit(rng);  // x frequency
+    wave[1] = 0.02f + 0.2f * unit(rng);  // y frequency
+    wave[2] = 6.3f * unit(rng);          // phase
+    wave[3] = 0.05f + 0.2f * unit(rng);  // drift per frame
+  }
+  Clip clip;
+  clip.pixels.resize(Clip::kFrames);
+  for (int f = 0; f < Clip::kFrames; ++f) {
+    clip.pixels[f].resize(static_cast<size_t>(Clip::kWidth) * Clip::kHeight);
+    for (int y = 0; y < Clip::kHeight; ++y) {
+      for (int x = 0; x < Clip::kWidth; ++x) {
+        float value = 0.0f;
+        for (const auto& wave : waves) {
+          value += std::sin(wave[0] * x + wave[1] * y + wave[2] + wave[3] * f);
+        }
+        clip.pixels[f][static_cast<size_t>(y) * Clip::kWidth + x] =
+            static_cast<uint8_t>(128.0f + 30.0f * value);
+      }
+    }
+  }
+  clip.finish();
+  return clip;
+}
+
+// The same clip re-encoded: brightness shift plus pixel noise.
+Clip perturbed(const Clip& clip, std::mt19937& rng) {
+  std::uniform_int_distribution<int> noise(-6, 6);
+  Clip copy = clip;
+  for (auto& frame_pixels : copy.pixels) {
+    for (uint8_t& value : frame_pixels) {
+      value = static_cast<uint8_t>(std::min(255, std::max(0, value + 5 + noise(rng))));
+    }
+  }
+  copy.finish();
+  return copy;
+}
+
+bool signature_of(const Clip& clip, VpVideoSignature* out) {
+  return vp_compute_video_signature(clip.frames.data(), static_cast<int>(clip.frames.size()),
+                                    out) == VP_OK;
+}
+
+// Copies `path` with the byte at `offset` replaced, or cut to `offset` bytes
+// when `value` is negative.
+void write_damaged(const char* path, const char* out_path, size_t offset, int value) {
+  std::ifstream in(path, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (value < 0) {
+    bytes.resize(std::min(offset, bytes.size()));
+  } else if (offset < bytes.size()) {
+    bytes[offset] = static_cast<char>(value);
+  }
+  std::ofstream out(out_path, std::ios::binary);
+  out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+void run_signature(Checker* checker) {
+  std::mt19937 rng(20240601);
+  constexpr int kClips = 32;
+  std::vector<Clip> clips;
+  std::vector<VpVideoSignature> signatures(kClips);
+  VpSignatureIndex* index = vp_signature_index_create();
+  checker->expect("create", index != nullptr);
+  if (!index) {
+    return;
+  }
+  for (int i = 0; i < kClips; ++i) {
+    clips.push_back(random_clip(rng));
+    checker->expect("signature", signature_of(clips[i], &signatures[i]));
+    checker->expect("hashes", signatures[i].hash_count == VP_SIGNATURE_HASHES);
+    checker->expect("add", vp_signature_index_add(index, &signatures[i], 100 + i) == VP_OK);
+  }
+  checker->expect("size", vp_signature_index_size(index) == kClips);
+
+  VpSignatureQuery query;
+  vp_default_signature_query(&query);
+  VpSignatureMatch match{};
+  for (int i = 0; i < kClips; ++i) {
+    const int status = vp_signature_index_query(index, &signatures[i], &query, &match);
+    checker->expect("query", status == VP_OK);
+    checker->expect("exact match", match.found && match.total_distance == 0 &&
+                                       match.video_id == static_cast<uint64_t>(100 + i));
+  }
+
+  // Re-encoded copies should still find their source clip.
+  int recalled = 0;
+  for (int i = 0; i < kClips; ++i) {
+    VpVideoSignature copy{};
+    signature_of(perturbed(clips[i], rng), &copy);
+    if (vp_signature_index_query(index, &copy, &query, &match) == VP_OK && match.found &&
+        match.video_id == static_cast<uint64_t>(100 + i)) {
+      ++recalled;
+    }
+  }
+  std::printf("signature: recalled %d of %d perturbed clips\n", recalled, kClips);
+  checker->expect("perturbed recall", recalled >= kClips * 9 / 10);
+
+  // Flat clips carry no hashes and never match.
+  Clip flat;
+  flat.pixels.assign(Clip::kFrames,
+                     std::vector<uint8_t>(static_cast<size_t>(Clip::kWidth) * Clip::kHeight, 128));
+  flat.finish();
+  VpVideoSignature flat_signature{};
+  checker->expect("flat signature", signature_of(flat, &flat_signature));
+  checker->expect("flat hash_count", flat_signature.hash_count == 0);
+  checker->expect("flat query", vp_signature_index_query(index, &flat_signature, &query, &match) ==
+                                    VP_OK && !match.found);
+
+  const char* path = "vp_unit_test_index.bin";
+  const char* damaged = "vp_unit_test_damaged.bin";
+  checker->expect("save", vp_signature_index_save(index, path) == VP_OK);
+  VpSignatureIndex* loaded = nullptr;
+  checker->expect("load", vp_signature_index_load(path, &loaded) == VP_OK && loaded);
+  if (loaded) {
+    checker->expect("loaded size", vp_signature_index_size(loaded) == kClips);
+    for (int i = 0; i < kClips; ++i) {
+      checker->expect("loaded match",
+                      vp_signature_index_query(loaded, &signatures[i], &query, &match) == VP_OK &&
+                          match.found && match.video_id == static_cast<uint64_t>(100 + i));
+    }
+    vp_signature_index_destroy(loaded);
+  }
+
+  // Bad magic, a later format version and a truncated body.
+  const struct {
+    const char* what;
+    size_t offset;
+    int value;
+    int status;
+  } damages[] = {{"bad magic", 0, 'X', VP_ERR_IO},
+                 {"wrong version", 4, 2, VP_ERR_UNSUPPORTED},
+                 {"truncated", 40, -1, VP_ERR_IO}};
+  for (const auto& damage : damages) {
+    write_damaged(path, damaged, damage.offset, damage.value);
+    loaded = nullptr;
+    checker->expect(damage.what, vp_signature_index_load(damaged, &loaded) == damage.status);
+    checker->expect(damage.what, loaded == nullptr);
+    vp_signature_index_destroy(loaded);
+  }
+  std::remove(path);
+  std::remove(damaged);
+  vp_signature_index_destroy(index);
+}
+
+// One scheduled analysis. A held job blocks in its progress callback after
+// its first frame until released, which pins it (and its slot) mid-run.
+struct SchedulerJob {
+  static std::atomic<int> completions;
+
+  VpAnalyzer* analyzer = nullptr;
+  VpAnalysisTask* task = nullptr;
+  std::atomic<bool> hold{false};
+  std::atomic<bool> started{false};
+  std::atomic<int> status{-1};
+  // Position among all completions so far.
+  std::atomic<int> order{-1};
+
+  static void on_progress(void* user_data, int32_t frames_done, int32_t /*frames_total*/) {
+    auto* job = static_cast<SchedulerJob*>(user_data);
+    if (frames_done == 1) {
+      job->started.store(true);
+      while (job->hold.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  }
+
+  static void on_complete(void* user_data, int status, const VpAggregateResult* /*result*/) {
+    auto* job = static_cast<SchedulerJob*>(user_data);
+    job->status.store(status);
+    job->order.store(completions.fetch_add(1));
+  }
+
+  bool submit(VpScheduler* scheduler, VpPriority priority, const std::vector<VpFrame>& frames) {
+    VpConfig config;
+    vp_default_config(&config);
+    analyzer = vp_create(&config);
+    return analyzer &&
+           vp_scheduler_submit(scheduler, priority, analyzer, frames.data(),
+                               static_cast<int>(frames.size()), nullptr, 0, nullptr, on_progress,
+                               on_complete, this, &task) == VP_OK;
+  }
+
+  void wait_started() const {
+    while (!started.load()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  void destroy() {
+    vp_task_destroy(task);
+    vp_destroy(analyzer);
+  }
+};
+
+std::atomic<int> SchedulerJob::completions{0};
+
+VpScheduler* one_slot_scheduler(int aging_ms) {
+  VpSchedulerConfig config;
+  vp_default_scheduler_config(&config);
+  config.max_running = 1;
+  config.background_share = 1.0f;
+  config.aging_ms = aging_ms;
+  return vp_scheduler_create(&config);
+}
+
+void run_scheduler(Checker* checker) {
+  const auto pixels = textured_frames(1, 160, 120);
+  const std::vector<VpFrame> frames(48, VpFrame{160, 120, 160, VP_PIXEL_GRAY8, pixels[0].data()});
+
+  // A running background job yields its only slot to an interactive one at
+  // the next frame boundary and finishes after it.
+  {
+    VpScheduler* scheduler = one_slot_scheduler(0);
+    SchedulerJob background;
+    SchedulerJob interactive;
+    background.hold = true;
+    checker->expect("submit background",
+                    background.submit(scheduler, VP_PRIORITY_BACKGROUND, frames));
+    background.wait_started();
+    checker->expect("submit interactive",
+                    interactive.submit(scheduler, VP_PRIORITY_INTERACTIVE, frames));
+    background.hold = false;
+    vp_task_wait(interactive.task, nullptr);
+    vp_task_wait(background.task, nullptr);
+    checker->expect("interactive ok", interactive.status == VP_OK);
+    checker->expect("background ok", background.status == VP_OK);
+    checker->expect("interactive first", interactive.order < background.order);
+    interactive.destroy();
+    background.destroy();
+    vp_scheduler_destroy(scheduler);
+  }
+
+  // A queued job cancelled while the slot stays taken completes anyway.
+  {
+    VpScheduler* scheduler = one_slot_scheduler(0);
+    SchedulerJob running;
+    SchedulerJob queued;
+    running.hold = true;
+    checker->expect("submit running", running.submit(scheduler, VP_PRIORITY_BACKGROUND, frames));
+    running.wait_started();
+    checker->expect("submit queued", queued.submit(scheduler, VP_PRIORITY_BACKGROUND, frames));
+    vp_task_cancel(queued.task);
+    checker->expect("queued cancelled", vp_task_wait(queued.task, nullptr) == VP_ERR_CANCELLED);
+    checker->expect("queued never started", !queued.started);
+    running.hold = false;
+    checker->expect("running ok", vp_task_wait(running.task, nullptr) == VP_OK);
+    queued.destroy();
+    running.destroy();
+    vp_scheduler_destroy(scheduler);
+  }
+
+  // A background job that waited past aging_ms keeps its slot against a
+  // later interactive job.
+  {
+    VpScheduler* scheduler = one_slot_scheduler(50);
+    SchedulerJob first;
+    SchedulerJob aged;
+    SchedulerJob late;
+    first.hold = true;
+    checker->expect("submit first", first.submit(scheduler, VP_PRIORITY_INTERACTIVE, frames));
+    first.wait_started();
+    aged.hold = true;
+    checker->expect("submit aged", aged.submit(scheduler, VP_PRIORITY_BACKGROUND, frames));
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    first.hold = false;
+    aged.wait_started();
+    checker->expect("submit late", late.submit(scheduler, VP_PRIORITY_INTERACTIVE, frames));
+    aged.hold = false;
+    vp_task_wait(late.task, nullptr);
+    vp_task_wait(aged.task, nullptr);
+    checker->expect("aged ok", aged.status == VP_OK);
+    checker->expect("late ok", late.status == VP_OK);
+    checker->expect("aged not preempted", aged.order < late.order);
+    late.destroy();
+    aged.destroy();
+    first.destroy();
+    vp_scheduler_destroy(scheduler);
+  }
+}
+
+// Every window scored from scratch: the earliest window with the highest
+// mean composite, and in it the latest frame with the lowest score of each
+// metric (the one the finder's monotonic deque keeps). A clip shorter than
+// the window is one window.
+struct SegmentReference {
+  int start = 0;
+  int end = 0;
+  float score = 0.0f;
+  std::vector<vp::SegmentFinder::MetricWindow> metrics;
+};
+
+SegmentReference brute_force_segment(const std::vector<float>& scores,
+                                     const std::vector<float>& raws, int frames, int metrics,
+                                     const float* weights, int window) {
+  // Same normalization and summation order as SegmentFinder.
+  float normalized[VP_MAX_ITEMS];
+  float total_weight = 0.0f;
+  for (int m = 0; m < metrics; ++m) {
+    total_weight += weights[m];
+  }
+  for (int m = 0; m < metrics; ++m) {
+    normalized[m] = total_weight > 0.0f ? weights[m] / total_weight
+                                        : 1.0f / static_cast<float>(metrics);
+  }
+  std::vector<float> composites(static_cast<size_t>(frames));
+  for (int f = 0; f < frames; ++f) {
+    float composite = 0.0f;
+    for (int m = 0; m < metrics; ++m) {
+      composite += normalized[m] * scores[static_cast<size_t>(f) * metrics + m];
+    }
+    composites[f] = composite;
+  }
+
+  const int length = std::min(window, frames);
+  SegmentReference best;
+  double best_mean = 0.0;
+  for (int start = 0; start + length <= frames; ++start) {
+    double sum = 0.0;
+    for (int f = start; f < start + length; ++f) {
+      sum += composites[f];
+    }
+    const double mean = sum / length;
+    if (start == 0 || mean > best_mean) {
+      best_mean = mean;
+      best.start = start;
+    }
+  }
+  best.end = best.start + length;
+  best.score = static_cast<float>(best_mean);
+  best.metrics.resize(static_cast<size_t>(metrics));
+  for (int m = 0; m < metrics; ++m) {
+    double score_sum = 0.0;
+    double raw_sum = 0.0;
+    int worst = best.start;
+    for (int f = best.start; f < best.end; ++f) {
+      const size_t at = static_cast<size_t>(f) * metrics + m;
+      score_sum += scores[at];
+      raw_sum += raws[at];
+      if (scores[at] <= scores[static_cast<size_t>(worst) * metrics + m]) {
+        worst = f;
+      }
+    }
+    const size_t worst_at = static_cast<size_t>(worst) * metrics + m;
+    best.metrics[m] = {static_cast<float>(score_sum / length), static_cast<float>(raw_sum / length),
+                       scores[worst_at], raws[worst_at]};
+  }
+  return best;
+}
+
+// Values are multiples of a power of two and weights sum to one, so every sum
+// is exact and the finder's running sums cannot drift from the rescans;
+// distinct window means then differ by far more than its tie epsilon.
+void run_segment(Checker* checker) {
+  std::mt19937 rng(20240601);
+  auto range = [&rng](int lo, int hi) { return lo + static_cast<int>(rng() % (hi - lo + 1)); };
+  vp::SegmentFinder finder;
+  for (int iteration = 0; iteration < 2000; ++iteration) {
+    const int frames = range(1, 64);
+    const int metrics = range(1, 4);
+    // Coarse steps make many equal scores and equal windows.
+    const float step = iteration % 2 ? 1.0f / 256.0f : 0.25f;
+    const int levels = static_cast<int>(1.0f / step);
+    std::vector<float> scores(static_cast<size_t>(frames) * metrics);
+    std::vector<float> raws(scores.size());
+    for (size_t i = 0; i < scores.size(); ++i) {
+      scores[i] = static_cast<float>(range(0, levels)) * step;
+      raws[i] = static_cast<float>(range(0, 16000)) / 16.0f;
+    }
+    // Integer weights topped up to a power-of-two total; all zero (equal
+    // weights) only where 1/metrics is exact.
+    float weights[VP_MAX_ITEMS] = {};
+    int total = 0;
+    for (int m = 0; m < metrics; ++m) {
+      weights[m] = static_cast<float>(range(0, 3));
+      total += static_cast<int>(weights[m]);
+    }
+    if (total == 0 && metrics == 3) {
+      weights[0] = 1.0f;
+      total = 1;
+    }
+    int power = 1;
+    while (power < total) {
+      power *= 2;
+    }
+    if (total > 0) {
+      weights[metrics - 1] += static_cast<float>(power - total);
+    }
+
+    const int windows[] = {1, frames, frames + range(1, 8), range(1, frames)};
+    for (int window : windows) {
+      finder.reset(window, metrics, weights);
+      for (int f = 0; f < frames; ++f) {
+        const size_t at = static_cast<size_t>(f) * metrics;
+        finder.push(&scores[at], &raws[at]);
+      }
+      checker->expect("finish", finder.finish());
+      const SegmentReference want =
+          brute_force_segment(scores, raws, frames, metrics, weights, window);
+      checker->expect("start", finder.start() == want.start);
+      checker->expect("end", finder.end() == want.end);
+      checker->expect("score", finder.score() == want.score);
+      for (int m = 0; m < metrics; ++m) {
+        const vp::SegmentFinder::MetricWindow& got = finder.metric(m);
+        checker->expect("mean score", got.mean_score == want.metrics[m].mean_score);
+        checker->expect("mean raw", got.mean_raw == want.metrics[m].mean_raw);
+        checker->expect("worst score", got.worst_score == want.metrics[m].worst_score);
+        checker->expect("worst raw", got.worst_raw == want.metrics[m].worst_raw);
+      }
+    }
+  }
+  const float weight = 1.0f;
+  finder.reset(4, 1, &weight);
+  checker->expect("empty clip", !finder.finish());
+}
+
+void print_usage(const char* program) {
+  std::fprintf(stderr, "Usage: %s stats|sampler|tiles|signature|scheduler|segment\n", program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  Checker checker;
+  if (std::strcmp(argv[1], "stats") == 0) {
+    run_stats(&checker);
+  } else if (std::strcmp(argv[1], "sampler") == 0) {
+    run_sampler(&checker);
+  } else if (std::strcmp(argv[1], "tiles") == 0) {
+    run_tiles(&checker);
+  } else if (std::strcmp(argv[1], "signature") == 0) {
+    run_signature(&checker);
+  } else if (std::strcmp(argv[1], "scheduler") == 0) {
+    run_scheduler(&checker);
+  } else if (std::strcmp(argv[1], "segment") == 0) {
+    run_segment(&checker);
+  } else {
+    print_usage(argv[0]);
+    return 1;
+  }
+  std::printf("%s: %d checks, %d failures\n", argv[1], checker.checks, checker.failures);
+  return checker.failures == 0 ? 0 : 1;
+}
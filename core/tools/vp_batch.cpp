@@ -0,0 +1,265 @@
+#include "vp_batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vp_analyzer.h"
+#include "vp_frame_source.h"
+#include "vp_json.h"
+
+namespace vp_tools {
+
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// Directories contribute supported files only, sorted for stable output.
+// Lists are taken as given, so unsupported entries are reported per line.
+bool collect_inputs(const std::string& source, std::vector<Input>* out) {
+  std::error_code ec;
+  if (fs::is_directory(source, ec)) {
+    for (fs::recursive_directory_iterator it(source, ec), end; !ec && it != end;
+         it.increment(ec)) {
+      if (it->is_regular_file(ec)) {
+        Input input = classify_input(it->path().string());
+        if (input.kind != InputKind::kUnsupported) {
+          out->push_back(input);
+        }
+      }
+    }
+    std::sort(out->begin(), out->end(),
+              [](const Input& a, const Input& b) { return a.path < b.path; });
+    return !ec;
+  }
+  std::ifstream list(source);
+  if (!list) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(list, line)) {
+    while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back()))) {
+      line.pop_back();
+    }
+    if (!line.empty() && line[0] != '#') {
+      out->push_back(classify_input(line));
+    }
+  }
+  return true;
+}
+
+double elapsed_ms(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+struct BatchTotals {
+  int files_ok = 0;
+  int files_failed = 0;
+  int duplicates = 0;
+  long long frames = 0;
+};
+
+class BatchRunner {
+ public:
+  BatchRunner(const BatchOptions& options, const std::vector<Input>& inputs, std::FILE* out)
+      : options_(options), inputs_(inputs), out_(out) {
+    if (options_.dedup) {
+      vp_default_signature_query(&query_);
+      index_ = vp_signature_index_create();
+      results_.resize(inputs_.size());
+    }
+  }
+
+  ~BatchRunner() { vp_signature_index_destroy(index_); }
+
+  BatchRunner(const BatchRunner&) = delete;
+  BatchRunner& operator=(const BatchRunner&) = delete;
+
+  void worker() {
+    VpConfig config;
+    vp_default_config(&config);
+    config.max_frames = options_.max_frames;
+    VpAnalyzer* analyzer = vp_create(&config);
+
+    size_t index;
+    while ((index = next_.fetch_add(1)) < inputs_.size()) {
+      score(analyzer, index);
+    }
+    vp_destroy(analyzer);
+  }
+
+  const BatchTotals& totals() const { return totals_; }
+
+ private:
+  void score(VpAnalyzer* analyzer, size_t index) {
+    const Input& input = inputs_[index];
+    const Clock::time_point start = Clock::now();
+    std::string error;
+    int rc = VP_OK;
+    int frame_count = 0;
+    VpAggregateResult result{};
+
+    FrameSequence sequence;
+    bool opened = false;
+    if (!analyzer) {
+      rc = VP_ERR_ALLOC;
+      error = "Failed to create analyzer";
+    } else {
+      rc = sequence.open_input(input, options_.raw_width, options_.raw_height, options_.max_frames,
+                               &error);
+      opened = rc == VP_OK;
+    }
+    const Clock::time_point opened_at = Clock::now();
+
+    const Input* duplicate_of = nullptr;
+    VpVideoSignature signature{};
+    if (opened) {
+      frame_count = static_cast<int>(sequence.frames().size());
+      if (options_.max_frames > 0) {
+        frame_count = std::min(frame_count, options_.max_frames);
+      }
+      if (index_ &&
+          vp_compute_video_signature(sequence.frames().data(), frame_count, &signature) == VP_OK) {
+        duplicate_of = find_duplicate(signature, &result);
+      }
+      if (!duplicate_of) {
+        rc = vp_analyze_frames(analyzer, sequence.frames().data(), frame_count, &result);
+        if (rc != VP_OK) {
+          error = "Analyze failed";
+        }
+      }
+    }
+    const Clock::time_point done = Clock::now();
+    const bool ok = opened && rc == VP_OK;
+    if (ok && index_ && !duplicate_of) {
+      remember(index, signature, result);
+    }
+
+    std::string line = "{\"file\":";
+    append_json_string(&line, input.path);
+    char buffer[160];
+    if (ok) {
+      std::snprintf(buffer, sizeof(buffer),
+                    ",\"status\":\"ok\",\"frames\":%d,\"open_ms\":%.3f,\"analyze_ms\":%.3f",
+                    frame_count, elapsed_ms(start, opened_at), elapsed_ms(opened_at, done));
+      line.append(buffer);
+      if (duplicate_of) {
+        line.append(",\"duplicate_of\":");
+        append_json_string(&line, duplicate_of->path);
+      }
+      append_items(&line, "mean", result.mean, result.item_count);
+      append_items(&line, "worst", result.worst, result.item_count);
+    } else {
+      line.append(",\"status\":\"error\",\"error\":");
+      append_json_string(&line, error);
+      std::snprintf(buffer, sizeof(buffer), ",\"code\":%d", rc);
+      line.append(buffer);
+    }
+    line.append("}\n");
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::fwrite(line.data(), 1, line.size(), out_);
+    if (ok) {
+      ++totals_.files_ok;
+      totals_.frames += frame_count;
+      totals_.duplicates += duplicate_of ? 1 : 0;
+    } else {
+      ++totals_.files_failed;
+    }
+  }
+
+  // A file still being scored on another worker is not found; both copies
+  // are then scored.
+  const Input* find_duplicate(const VpVideoSignature& signature, VpAggregateResult* out_result) {
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    VpSignatureMatch match{};
+    if (vp_signature_index_query(index_, &signature, &query_, &match) != VP_OK || !match.found) {
+      return nullptr;
+    }
+    *out_result = results_[match.video_id];
+    return &inputs_[match.video_id];
+  }
+
+  void remember(size_t index, const VpVideoSignature& signature, const VpAggregateResult& result) {
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    results_[index] = result;
+    vp_signature_index_add(index_, &signature, index);
+  }
+
+  const BatchOptions& options_;
+  const std::vector<Input>& inputs_;
+  std::FILE* out_;
+  std::atomic<size_t> next_{0};
+  std::mutex mutex_;
+  BatchTotals totals_;
+  // --dedup: signatures of scored files, keyed by input index.
+  VpSignatureIndex* index_ = nullptr;
+  VpSignatureQuery query_{};
+  std::vector<VpAggregateResult> results_;
+  std::mutex index_mutex_;
+};
+
+} // namespace
+
+int run_batch(const BatchOptions& options) {
+  std::vector<Input> inputs;
+  if (!collect_inputs(options.input, &inputs)) {
+    std::fprintf(stderr, "Failed to read batch input: %s\n", options.input.c_str());
+    return 1;
+  }
+  if (inputs.empty()) {
+    std::fprintf(stderr, "No input files in %s\n", options.input.c_str());
+    return 1;
+  }
+
+  std::FILE* out = stdout;
+  if (options.output != "-") {
+    out = std::fopen(options.output.c_str(), "wb");
+    if (!out) {
+      std::fprintf(stderr, "Failed to open output: %s\n", options.output.c_str());
+      return 1;
+    }
+  }
+
+  int jobs = options.jobs > 0 ? options.jobs : static_cast<int>(std::thread::hardware_concurrency());
+  jobs = std::max(1, std::min(jobs, static_cast<int>(inputs.size())));
+
+  const Clock::time_point start = Clock::now();
+  BatchRunner runner(options, inputs, out);
+  std::vector<std::thread> workers;
+  workers.reserve(static_cast<size_t>(jobs - 1));
+  for (int i = 1; i < jobs; ++i) {
+    workers.emplace_back(&BatchRunner::worker, &runner);
+  }
+  runner.worker();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  const double seconds = elapsed_ms(start, Clock::now()) / 1000.0;
+
+  if (out != stdout) {
+    std::fclose(out);
+  } else {
+    std::fflush(out);
+  }
+
+  const BatchTotals& totals = runner.totals();
+  const int files = totals.files_ok + totals.files_failed;
+  std::fprintf(stderr,
+               "Batch: %d files (%d failed, %d duplicates), %lld frames in %.3f s with %d jobs: "
+               "%.2f files/s, %.1f frames/s\n",
+               files, totals.files_failed, totals.duplicates, totals.frames, seconds, jobs,
+               seconds > 0.0 ? files / seconds : 0.0,
+               seconds > 0.0 ? static_cast<double>(totals.frames) / seconds : 0.0);
+  return totals.files_failed == 0 ? 0 : 1;
+}
+
+} // namespace vp_tools
@@ -0,0 +1,31 @@
+#ifndef VP_BATCH_H
+#define VP_BATCH_H
+
+#include <string>
+
+namespace vp_tools {
+
+struct BatchOptions {
+  // A directory (scanned recursively) or a text file listing one path per line.
+  std::string input;
+  // "-" writes the JSON lines to stdout.
+  std::string output = "-";
+  // Worker threads; 0 uses the hardware concurrency.
+  int jobs = 0;
+  int max_frames = 0;
+  // Geometry for headerless raw files (.gray/.nv12/.i420); 0 skips them.
+  int raw_width = 0;
+  int raw_height = 0;
+  // Looks up each file's clip signature before scoring; a near-duplicate of
+  // a file already scored in this run reuses that file's result.
+  bool dedup = false;
+};
+
+// Scores every supported file on a worker pool, one analyzer per worker, and
+// writes one JSON object per file. Prints a throughput summary to stderr.
+// Returns 0 when every file was scored.
+int run_batch(const BatchOptions& options);
+
+} // namespace vp_tools
+
+#endif // VP_BATCH_H
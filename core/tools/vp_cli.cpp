@@ -1,40 +1,157 @@
 #include <cstdio>
 #include <cstdlib>
-#include <fstream>
+#include <cstring>
+#include <string>
 #include <vector>
 
 #include "vp_analyzer.h"
+#include "vp_batch.h"
+#include "vp_frame_source.h"
+#include "vp_server.h"
+
+static void print_usage(const char* program) {
+  std::fprintf(stderr,
+               "Usage: %s [options] <width> <height> <raw_file>\n"
+               "       %s [options] <file.y4m | ->\n"
+               "       %s --batch <dir | list.txt> [--jobs <n>] [--output <out.jsonl>]\n"
+               "          [--size <width>x<height>] [--max-frames <n>] [--dedup]\n"
+               "       %s --serve <socket> [--jobs <n>] [--queue <n>]\n"
+               "       %s --autotune <profile.txt>\n"
+               "Options:\n"
+               "  --trace <trace.json>  write a Chrome trace of the run\n"
+               "  --format <gray8|nv12|i420>  layout of raw files (default gray8)\n"
+               "  --max-frames <n>      score at most n frames (default: all; 300 from stdin)\n"
+               "  --best-segment <n>    also report the best window of n consecutive frames\n"
+               "Raw files hold back-to-back frames and are memory-mapped, as are .y4m\n"
+               "files. \"-\" reads a YUV4MPEG2 stream from stdin.\n"
+               "Batch mode scores .y4m and raw (.gray/.nv12/.i420/.yuv, needs --size)\n"
+               "files concurrently and writes one JSON line per file. --dedup reuses the\n"
+               "result of an earlier file whose clip signature matches (\"duplicate_of\").\n"
+               "Serve mode keeps one analyzer per worker and scores JSON-line jobs sent to\n"
+               "a Unix socket until SIGINT/SIGTERM or {\"op\":\"shutdown\"}.\n"
+               "--autotune benchmarks the kernel variants on this CPU and saves the winners\n"
+               "to the profile; set VP_TUNING_PROFILE to it for later runs.\n",
+               program, program, program, program, program);
+}
 
 int main(int argc, char** argv) {
-  if (argc < 4) {
-    std::fprintf(stderr, "Usage: %s <width> <height> <gray8_file>\n", argv[0]);
-    return 1;
+  const char* trace_path = nullptr;
+  VpPixelFormat raw_format = VP_PIXEL_GRAY8;
+  int max_frames = 0;
+  int segment_frames = 0;
+  vp_tools::BatchOptions batch;
+  bool batch_mode = false;
+  vp_tools::ServeOptions serve;
+  std::vector<const char*> positional;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--trace") == 0 && has_value) {
+      trace_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--format") == 0 && has_value) {
+      if (!vp_tools::parse_raw_format(argv[++i], &raw_format)) {
+        std::fprintf(stderr, "Unknown raw format: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (std::strcmp(argv[i], "--max-frames") == 0 && has_value) {
+      max_frames = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--best-segment") == 0 && has_value) {
+      segment_frames = std::atoi(argv[++i]);
+      if (segment_frames <= 0) {
+        std::fprintf(stderr, "Invalid segment length: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (std::strcmp(argv[i], "--batch") == 0 && has_value) {
+      batch_mode = true;
+      batch.input = argv[++i];
+    } else if (std::strcmp(argv[i], "--autotune") == 0 && has_value) {
+      const char* profile_path = argv[++i];
+      int rc = vp_autotune(profile_path, 0, 0);
+      if (rc != VP_OK) {
+        std::fprintf(stderr, "Failed to write tuning profile %s: %d\n", profile_path, rc);
+        return 1;
+      }
+      std::printf("Tuning profile written to %s\n", profile_path);
+      return 0;
+    } else if (std::strcmp(argv[i], "--serve") == 0 && has_value) {
+      serve.socket_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--queue") == 0 && has_value) {
+      serve.queue_capacity = std::atoi(argv[++i]);
+      if (serve.queue_capacity <= 0) {
+        std::fprintf(stderr, "Invalid queue length: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (std::strcmp(argv[i], "--jobs") == 0 && has_value) {
+      batch.jobs = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--dedup") == 0) {
+      batch.dedup = true;
+    } else if (std::strcmp(argv[i], "--output") == 0 && has_value) {
+      batch.output = argv[++i];
+    } else if (std::strcmp(argv[i], "--size") == 0 && has_value) {
+      if (std::sscanf(argv[++i], "%dx%d", &batch.raw_width, &batch.raw_height) != 2) {
+        std::fprintf(stderr, "Invalid size: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+      print_usage(argv[0]);
+      return 1;
+    } else {
+      positional.push_back(argv[i]);
+    }
   }
-
-  int width = std::atoi(argv[1]);
-  int height = std::atoi(argv[2]);
-  if (width <= 0 || height <= 0) {
-    std::fprintf(stderr, "Invalid dimensions\n");
-    return 1;
+  if (!serve.socket_path.empty()) {
+    if (batch_mode || !positional.empty() || trace_path || segment_frames > 0) {
+      print_usage(argv[0]);
+      return 1;
+    }
+    serve.jobs = batch.jobs;
+    return vp_tools::run_server(serve);
   }
-
-  std::ifstream input(argv[3], std::ios::binary);
-  if (!input) {
-    std::fprintf(stderr, "Failed to open file: %s\n", argv[3]);
+  if (batch_mode) {
+    if (!positional.empty() || trace_path || segment_frames > 0) {
+      print_usage(argv[0]);
+      return 1;
+    }
+    batch.max_frames = max_frames;
+    return vp_tools::run_batch(batch);
+  }
+  if (positional.size() != 1 && positional.size() != 3) {
+    print_usage(argv[0]);
     return 1;
   }
 
-  size_t size = static_cast<size_t>(width) * static_cast<size_t>(height);
-  std::vector<uint8_t> buffer(size);
-  input.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(size));
-  if (input.gcount() != static_cast<std::streamsize>(size)) {
-    std::fprintf(stderr, "Expected %zu bytes, got %lld bytes\n", size,
-                 static_cast<long long>(input.gcount()));
+  vp_tools::FrameSequence sequence;
+  std::string error;
+  bool opened = false;
+  if (positional.size() == 1) {
+    opened = sequence.open_y4m(positional[0], max_frames, &error);
+  } else {
+    int width = std::atoi(positional[0]);
+    int height = std::atoi(positional[1]);
+    if (width <= 0 || height <= 0) {
+      std::fprintf(stderr, "Invalid dimensions\n");
+      return 1;
+    }
+    opened = sequence.open_raw(positional[2], width, height, raw_format, &error);
+  }
+  if (!opened) {
+    std::fprintf(stderr, "%s\n", error.c_str());
     return 1;
   }
+  if (sequence.stream_capped()) {
+    std::fprintf(stderr, "Stopped reading stdin after %zu frames; pass --max-frames to score more\n",
+                 sequence.frames().size());
+  }
+  if (sequence.trailing_bytes() > 0) {
+    std::fprintf(stderr, "Ignoring %zu trailing bytes (incomplete frame)\n",
+                 sequence.trailing_bytes());
+  }
 
   VpConfig config;
   vp_default_config(&config);
+  config.max_frames = max_frames;
+  if (trace_path) {
+    config.enable_trace = 1;
+  }
 
   VpAnalyzer* analyzer = vp_create(&config);
   if (!analyzer) {
@@ -42,15 +159,24 @@ int main(int argc, char** argv) {
     return 1;
   }
 
-  VpFrame frame{};
-  frame.width = width;
-  frame.height = height;
-  frame.stride_bytes = width;
-  frame.format = VP_PIXEL_GRAY8;
-  frame.data = buffer.data();
+  const std::vector<VpFrame>& frames = sequence.frames();
+  int frame_count = static_cast<int>(frames.size());
+  if (max_frames > 0 && frame_count > max_frames) {
+    frame_count = max_frames;
+  }
+  std::printf("Frames: %d\n", frame_count);
 
   VpAggregateResult result{};
-  int rc = vp_analyze_frames(analyzer, &frame, 1, &result);
+  VpSegmentResult segment{};
+  int rc = VP_OK;
+  if (segment_frames > 0) {
+    VpSegmentQuery query;
+    vp_default_segment_query(&query);
+    query.window_frames = segment_frames;
+    rc = vp_analyze_best_segment(analyzer, frames.data(), frame_count, &query, &segment, &result);
+  } else {
+    rc = vp_analyze_frames(analyzer, frames.data(), frame_count, &result);
+  }
   if (rc != VP_OK) {
     std::fprintf(stderr, "Analyze failed: %d\n", rc);
     vp_destroy(analyzer);
@@ -67,6 +193,24 @@ int main(int argc, char** argv) {
     std::printf("  %s score=%.3f raw=%.5f\n", result.worst[i].id_str, result.worst[i].score, result.worst[i].raw);
   }
 
+  if (segment_frames > 0) {
+    std::printf("Best segment: frames %d-%d score=%.3f\n", segment.start_frame,
+                segment.end_frame - 1, segment.score);
+    for (int i = 0; i < segment.item_count; ++i) {
+      std::printf("  %s mean=%.3f worst=%.3f\n", segment.mean[i].id_str, segment.mean[i].score,
+                  segment.worst[i].score);
+    }
+  }
+
+  if (trace_path) {
+    rc = vp_write_trace(analyzer, trace_path);
+    if (rc != VP_OK) {
+      std::fprintf(stderr, "Failed to write trace %s: %d\n", trace_path, rc);
+      vp_destroy(analyzer);
+      return 1;
+    }
+  }
+
   vp_destroy(analyzer);
   return 0;
 }
@@ -0,0 +1,380 @@
+#include "vp_frame_source.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+namespace vp_tools {
+
+namespace {
+
+constexpr char kY4mMagic[] = "YUV4MPEG2";
+constexpr char kY4mFrameTag[] = "FRAME";
+// Pipes keep luma planes in blocks of at least this size.
+constexpr size_t kLumaBlockBytes = 32u << 20;
+
+struct Y4mHeader {
+  int width = 0;
+  int height = 0;
+  size_t chroma_bytes = 0;
+  bool is_420 = false;
+};
+
+// Parses the tokens after the magic of a stream header line (without the
+// newline). Only 8-bit layouts are accepted.
+bool parse_y4m_header(const char* line, size_t length, Y4mHeader* out, std::string* error) {
+  std::string colorspace = "420jpeg";
+  size_t pos = 0;
+  while (pos < length) {
+    while (pos < length && line[pos] == ' ') {
+      ++pos;
+    }
+    size_t end = pos;
+    while (end < length && line[end] != ' ') {
+      ++end;
+    }
+    if (end > pos) {
+      std::string token(line + pos, end - pos);
+      if (token[0] == 'W') {
+        out->width = std::atoi(token.c_str() + 1);
+      } else if (token[0] == 'H') {
+        out->height = std::atoi(token.c_str() + 1);
+      } else if (token[0] == 'C') {
+        colorspace = token.substr(1);
+      }
+    }
+    pos = end;
+  }
+  if (out->width <= 0 || out->height <= 0) {
+    *error = "Y4M header has no valid W/H";
+    return false;
+  }
+
+  const size_t w = static_cast<size_t>(out->width);
+  const size_t h = static_cast<size_t>(out->height);
+  // High bit depth layouts carry a "p<bits>" suffix (420p10, 444p16).
+  size_t depth = colorspace.find('p');
+  bool high_depth = depth != std::string::npos && depth + 1 < colorspace.size() &&
+                    std::isdigit(static_cast<unsigned char>(colorspace[depth + 1]));
+  if (high_depth) {
+    *error = "Only 8-bit Y4M is supported: " + colorspace;
+    return false;
+  }
+  if (colorspace.compare(0, 3, "420") == 0) {
+    out->chroma_bytes = 2 * ((w + 1) / 2) * ((h + 1) / 2);
+    out->is_420 = true;
+  } else if (colorspace == "422") {
+    out->chroma_bytes = 2 * ((w + 1) / 2) * h;
+  } else if (colorspace == "444") {
+    out->chroma_bytes = 2 * w * h;
+  } else if (colorspace == "444alpha") {
+    out->chroma_bytes = 3 * w * h;
+  } else if (colorspace == "411") {
+    out->chroma_bytes = 2 * ((w + 3) / 4) * h;
+  } else if (colorspace == "mono") {
+    out->chroma_bytes = 0;
+  } else {
+    *error = "Unsupported Y4M colorspace: " + colorspace;
+    return false;
+  }
+  return true;
+}
+
+VpFrame luma_view(const Y4mHeader& header, const uint8_t* data) {
+  VpFrame frame{};
+  frame.width = header.width;
+  frame.height = header.height;
+  frame.stride_bytes = header.width;
+  frame.format = header.is_420 ? VP_PIXEL_I420 : VP_PIXEL_GRAY8;
+  frame.data = data;
+  return frame;
+}
+
+bool has_prefix(const uint8_t* data, size_t size, const char* prefix) {
+  size_t length = std::strlen(prefix);
+  return size >= length && std::memcmp(data, prefix, length) == 0;
+}
+
+} // namespace
+
+Input classify_input(const std::string& path) {
+  Input input;
+  input.path = path;
+  std::string ext = std::filesystem::path(path).extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  if (ext == ".y4m") {
+    input.kind = InputKind::kY4m;
+  } else if (ext == ".gray" || ext == ".gray8") {
+    input.kind = InputKind::kRaw;
+    input.raw_format = VP_PIXEL_GRAY8;
+  } else if (ext == ".nv12") {
+    input.kind = InputKind::kRaw;
+    input.raw_format = VP_PIXEL_NV12;
+  } else if (ext == ".i420" || ext == ".yuv") {
+    input.kind = InputKind::kRaw;
+    input.raw_format = VP_PIXEL_I420;
+  }
+  return input;
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+}
+
+bool MappedFile::open(const char* path, std::string* error) {
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    *error = std::string("Failed to open file: ") + path + ": " + std::strerror(errno);
+    return false;
+  }
+  return map(fd, path, error);
+}
+
+bool MappedFile::open_shared_memory(const char* name, std::string* error) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    *error = std::string("Failed to open shared memory: ") + name + ": " + std::strerror(errno);
+    return false;
+  }
+  return map(fd, name, error);
+}
+
+// Takes ownership of `fd`.
+bool MappedFile::map(int fd, const char* label, std::string* error) {
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+    *error = std::string("Empty or unreadable file: ") + label;
+    close(fd);
+    return false;
+  }
+  size_t size = static_cast<size_t>(info.st_size);
+  void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    *error = std::string("mmap failed: ") + label + ": " + std::strerror(errno);
+    return false;
+  }
+  // Frames are scored front to back; let the kernel read ahead aggressively.
+  madvise(mapped, size, MADV_SEQUENTIAL);
+  data_ = static_cast<const uint8_t*>(mapped);
+  size_ = size;
+  return true;
+}
+
+size_t raw_frame_bytes(int width, int height, VpPixelFormat format) {
+  const size_t w = static_cast<size_t>(width);
+  const size_t h = static_cast<size_t>(height);
+  switch (format) {
+    case VP_PIXEL_GRAY8:
+      return w * h;
+    case VP_PIXEL_NV12:
+    case VP_PIXEL_I420:
+      return w * h + 2 * ((w + 1) / 2) * ((h + 1) / 2);
+    default:
+      return 0;
+  }
+}
+
+bool parse_raw_format(const char* name, VpPixelFormat* out) {
+  if (std::strcmp(name, "gray8") == 0) {
+    *out = VP_PIXEL_GRAY8;
+  } else if (std::strcmp(name, "nv12") == 0) {
+    *out = VP_PIXEL_NV12;
+  } else if (std::strcmp(name, "i420") == 0) {
+    *out = VP_PIXEL_I420;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool FrameSequence::open_raw(const char* path, int width, int height, VpPixelFormat format,
+                             std::string* error) {
+  if (width <= 0 || height <= 0 || raw_frame_bytes(width, height, format) == 0) {
+    *error = "Invalid raw frame geometry";
+    return false;
+  }
+  return mapping_.open(path, error) && view_raw_frames(width, height, format, error);
+}
+
+bool FrameSequence::open_shared_memory(const char* name, int width, int height,
+                                       VpPixelFormat format, std::string* error) {
+  if (width <= 0 || height <= 0 || raw_frame_bytes(width, height, format) == 0) {
+    *error = "Invalid raw frame geometry";
+    return false;
+  }
+  return mapping_.open_shared_memory(name, error) && view_raw_frames(width, height, format, error);
+}
+
+int FrameSequence::open_input(const Input& input, int raw_width, int raw_height, int max_frames,
+                              std::string* error) {
+  if (input.kind == InputKind::kY4m) {
+    return open_y4m(input.path.c_str(), max_frames, error) ? VP_OK : VP_ERR_IO;
+  }
+  if (input.kind == InputKind::kRaw) {
+    if (raw_width <= 0 || raw_height <= 0) {
+      *error = "Raw input needs --size <width>x<height>";
+      return VP_ERR_INVALID_ARGUMENT;
+    }
+    return open_raw(input.path.c_str(), raw_width, raw_height, input.raw_format, error)
+               ? VP_OK
+               : VP_ERR_IO;
+  }
+  *error = "Unsupported file type";
+  return VP_ERR_UNSUPPORTED;
+}
+
+bool FrameSequence::view_raw_frames(int width, int height, VpPixelFormat format,
+                                    std::string* error) {
+  const size_t frame_bytes = raw_frame_bytes(width, height, format);
+  size_t count = mapping_.size() / frame_bytes;
+  if (count == 0) {
+    *error = "File is smaller than one frame";
+    return false;
+  }
+  trailing_bytes_ = mapping_.size() - count * frame_bytes;
+  frames_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    VpFrame& frame = frames_[i];
+    frame.width = width;
+    frame.height = height;
+    frame.stride_bytes = width;
+    frame.format = format;
+    frame.data = mapping_.data() + i * frame_bytes;
+  }
+  return true;
+}
+
+bool FrameSequence::open_y4m(const char* path, int max_frames, std::string* error) {
+  if (std::strcmp(path, "-") == 0) {
+    return read_y4m_stream(stdin, max_frames, error);
+  }
+  if (!mapping_.open(path, error)) {
+    return false;
+  }
+  const uint8_t* data = mapping_.data();
+  const size_t size = mapping_.size();
+  const uint8_t* newline = static_cast<const uint8_t*>(std::memchr(data, '\n', size));
+  if (!has_prefix(data, size, kY4mMagic) || !newline) {
+    *error = "Not a YUV4MPEG2 file";
+    return false;
+  }
+  Y4mHeader header;
+  const size_t magic_length = sizeof(kY4mMagic) - 1;
+  if (!parse_y4m_header(reinterpret_cast<const char*>(data) + magic_length,
+                        static_cast<size_t>(newline - data) - magic_length, &header, error)) {
+    return false;
+  }
+  const size_t luma_bytes = static_cast<size_t>(header.width) * header.height;
+  const size_t payload = luma_bytes + header.chroma_bytes;
+
+  size_t pos = static_cast<size_t>(newline - data) + 1;
+  while (pos < size) {
+    if (!has_prefix(data + pos, size - pos, kY4mFrameTag)) {
+      *error = "Malformed Y4M frame header";
+      return false;
+    }
+    const uint8_t* frame_newline =
+        static_cast<const uint8_t*>(std::memchr(data + pos, '\n', size - pos));
+    if (!frame_newline) {
+      break;
+    }
+    pos = static_cast<size_t>(frame_newline - data) + 1;
+    if (size - pos < payload) {
+      trailing_bytes_ = size - pos;
+      break;
+    }
+    frames_.push_back(luma_view(header, data + pos));
+    pos += payload;
+  }
+  if (frames_.empty()) {
+    *error = "Y4M file has no complete frame";
+    return false;
+  }
+  return true;
+}
+
+uint8_t* FrameSequence::allocate_luma(size_t bytes) {
+  if (blocks_.empty() || block_size_ - block_used_ < bytes) {
+    block_size_ = std::max(bytes, kLumaBlockBytes);
+    blocks_.emplace_back(new uint8_t[block_size_]);
+    block_used_ = 0;
+  }
+  uint8_t* out = blocks_.back().get() + block_used_;
+  block_used_ += bytes;
+  return out;
+}
+
+bool FrameSequence::read_y4m_stream(std::FILE* stream, int max_frames, std::string* error) {
+  // Must precede the first read; larger reads keep up with fast producers.
+  std::setvbuf(stream, nullptr, _IOFBF, 1u << 20);
+  std::string line;
+  auto read_line = [&](size_t limit) {
+    line.clear();
+    int c;
+    while ((c = std::fgetc(stream)) != EOF && c != '\n') {
+      if (line.size() >= limit) {
+        return false;
+      }
+      line.push_back(static_cast<char>(c));
+    }
+    return c == '\n';
+  };
+
+  const size_t magic_length = sizeof(kY4mMagic) - 1;
+  if (!read_line(4096) || line.compare(0, magic_length, kY4mMagic) != 0) {
+    *error = "Not a YUV4MPEG2 stream";
+    return false;
+  }
+  Y4mHeader header;
+  if (!parse_y4m_header(line.data() + magic_length, line.size() - magic_length, &header,
+                        error)) {
+    return false;
+  }
+  const size_t luma_bytes = static_cast<size_t>(header.width) * header.height;
+  std::vector<uint8_t> chroma(header.chroma_bytes);
+
+  const bool default_limit = max_frames <= 0;
+  if (default_limit) {
+    VpConfig defaults;
+    vp_default_config(&defaults);
+    max_frames = defaults.max_frames;
+  }
+  while (static_cast<int>(frames_.size()) < max_frames) {
+    if (!read_line(4096)) {
+      break;
+    }
+    if (line.compare(0, sizeof(kY4mFrameTag) - 1, kY4mFrameTag) != 0) {
+      *error = "Malformed Y4M frame header";
+      return false;
+    }
+    uint8_t* luma = allocate_luma(luma_bytes);
+    if (std::fread(luma, 1, luma_bytes, stream) != luma_bytes ||
+        std::fread(chroma.data(), 1, chroma.size(), stream) != chroma.size()) {
+      // Truncated last frame, e.g. the producer was interrupted.
+      break;
+    }
+    frames_.push_back(luma_view(header, luma));
+  }
+  if (frames_.empty()) {
+    *error = "Y4M stream has no complete frame";
+    return false;
+  }
+  if (default_limit && static_cast<int>(frames_.size()) == max_frames) {
+    stream_capped_ = std::fgetc(stream) != EOF;
+  }
+  return true;
+}
+
+} // namespace vp_tools
@@ -0,0 +1,107 @@
+#ifndef VP_FRAME_SOURCE_H
+#define VP_FRAME_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "vp_analyzer.h"
+
+namespace vp_tools {
+
+enum class InputKind { kUnsupported, kY4m, kRaw };
+
+struct Input {
+  std::string path;
+  InputKind kind = InputKind::kUnsupported;
+  VpPixelFormat raw_format = VP_PIXEL_GRAY8;
+};
+
+// Classifies a path by extension: .y4m, or raw .gray/.gray8 (GRAY8), .nv12,
+// and .i420/.yuv (I420).
+Input classify_input(const std::string& path);
+
+// Read-only private mapping of a whole file (POSIX mmap).
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool open(const char* path, std::string* error);
+  // Maps a POSIX shared-memory object by its shm_open name.
+  bool open_shared_memory(const char* name, std::string* error);
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  bool map(int fd, const char* label, std::string* error);
+
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// A decoded frame sequence exposed as VpFrame views. For mapped files the
+// views point straight into the mapping; for pipes only the luma planes are
+// kept, in blocks that never move once filled. Views stay valid for the
+// lifetime of the source.
+class FrameSequence {
+ public:
+  const std::vector<VpFrame>& frames() const { return frames_; }
+  // Bytes at the end of a raw file that do not form a whole frame.
+  size_t trailing_bytes() const { return trailing_bytes_; }
+  // A Y4M pipe read without max_frames stopped at the default limit with
+  // frames still left in it.
+  bool stream_capped() const { return stream_capped_; }
+
+  // Headerless back-to-back frames of one format. NV12/I420 frames are the
+  // Y plane followed by the 4:2:0 chroma planes, with no row padding.
+  bool open_raw(const char* path, int width, int height, VpPixelFormat format,
+                std::string* error);
+
+  // YUV4MPEG2 file, or standard input when path is "-". 8-bit mono, 4:2:0,
+  // 4:2:2 and 4:4:4 streams are accepted; only the Y plane is scored.
+  // max_frames > 0 stops reading a pipe after that many frames. Otherwise a
+  // pipe stops at the analyzer default (VpConfig.max_frames), since every
+  // frame read is held in memory until scoring starts.
+  bool open_y4m(const char* path, int max_frames, std::string* error);
+
+  // Frames in the raw layout of open_raw, back to back in a shared-memory
+  // object written by another process. The writer must not modify or unlink
+  // it while the frames are in use.
+  bool open_shared_memory(const char* name, int width, int height, VpPixelFormat format,
+                          std::string* error);
+
+  // Opens a classified file: Y4M, or raw when raw_width/raw_height are set.
+  // Returns a VpErrorCode (VP_ERR_IO for unreadable files).
+  int open_input(const Input& input, int raw_width, int raw_height, int max_frames,
+                 std::string* error);
+
+ private:
+  bool view_raw_frames(int width, int height, VpPixelFormat format, std::string* error);
+  bool read_y4m_stream(std::FILE* stream, int max_frames, std::string* error);
+  uint8_t* allocate_luma(size_t bytes);
+
+  MappedFile mapping_;
+  std::vector<std::unique_ptr<uint8_t[]>> blocks_;
+  size_t block_used_ = 0;
+  size_t block_size_ = 0;
+  std::vector<VpFrame> frames_;
+  size_t trailing_bytes_ = 0;
+  bool stream_capped_ = false;
+};
+
+// Size of one raw frame in bytes, or 0 for an unsupported format.
+size_t raw_frame_bytes(int width, int height, VpPixelFormat format);
+
+// Parses "gray8", "nv12" or "i420".
+bool parse_raw_format(const char* name, VpPixelFormat* out);
+
+} // namespace vp_tools
+
+#endif // VP_FRAME_SOURCE_H
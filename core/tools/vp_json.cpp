@@ -0,0 +1,282 @@
+#include "vp_json.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+namespace vp_tools {
+
+namespace {
+
+class FlatParser {
+ public:
+  explicit FlatParser(const std::string& text) : text_(text) {}
+
+  bool parse(JsonObject* out, std::string* error) {
+    skip_space();
+    if (!consume('{')) {
+      return fail("Expected '{'", error);
+    }
+    skip_space();
+    if (consume('}')) {
+      return at_end(error);
+    }
+    while (true) {
+      std::string key;
+      skip_space();
+      if (!parse_string(&key)) {
+        return fail("Expected a string key", error);
+      }
+      skip_space();
+      if (!consume(':')) {
+        return fail("Expected ':'", error);
+      }
+      skip_space();
+      JsonField field;
+      if (peek() == '"') {
+        field.is_string = true;
+        if (!parse_string(&field.text)) {
+          return fail("Malformed string", error);
+        }
+      } else if (!parse_literal(&field.text)) {
+        return fail("Expected a string, number, true, false or null", error);
+      }
+      (*out)[key] = field;
+      skip_space();
+      if (consume('}')) {
+        return at_end(error);
+      }
+      if (!consume(',')) {
+        return fail("Expected ',' or '}'", error);
+      }
+    }
+  }
+
+ private:
+  char peek() const { return pos_ < text_.size() ? text_[pos_] : '\0'; }
+
+  bool consume(char c) {
+    if (peek() != c) {
+      return false;
+    }
+    ++pos_;
+    return true;
+  }
+
+  void skip_space() {
+    while (pos_ < text_.size() &&
+           (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\r' || text_[pos_] == '\n')) {
+      ++pos_;
+    }
+  }
+
+  bool at_end(std::string* error) {
+    skip_space();
+    return pos_ == text_.size() || fail("Trailing characters after the object", error);
+  }
+
+  bool fail(const char* message, std::string* error) const {
+    char buffer[96];
+    std::snprintf(buffer, sizeof(buffer), "%s at offset %zu", message, pos_);
+    *error = buffer;
+    return false;
+  }
+
+  bool parse_hex4(unsigned* out) {
+    if (text_.size() - pos_ < 4) {
+      return false;
+    }
+    unsigned value = 0;
+    for (int i = 0; i < 4; ++i) {
+      char c = text_[pos_++];
+      value <<= 4;
+      if (c >= '0' && c <= '9') {
+        value |= static_cast<unsigned>(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        value |= static_cast<unsigned>(c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        value |= static_cast<unsigned>(c - 'A' + 10);
+      } else {
+        return false;
+      }
+    }
+    *out = value;
+    return true;
+  }
+
+  static void append_utf8(unsigned code, std::string* out) {
+    if (code < 0x80) {
+      out->push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+      out->push_back(static_cast<char>(0xC0 | (code >> 6)));
+      out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+      out->push_back(static_cast<char>(0xE0 | (code >> 12)));
+      out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+      out->push_back(static_cast<char>(0xF0 | (code >> 18)));
+      out->push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+  }
+
+  bool parse_string(std::string* out) {
+    if (!consume('"')) {
+      return false;
+    }
+    while (pos_ < text_.size()) {
+      char c = text_[pos_++];
+      if (c == '"') {
+        return true;
+      }
+      if (static_cast<unsigned char>(c) < 0x20) {
+        return false;
+      }
+      if (c != '\\') {
+        out->push_back(c);
+        continue;
+      }
+      if (pos_ >= text_.size()) {
+        return false;
+      }
+      switch (text_[pos_++]) {
+        case '"':
+          out->push_back('"');
+          break;
+        case '\\':
+          out->push_back('\\');
+          break;
+        case '/':
+          out->push_back('/');
+          break;
+        case 'b':
+          out->push_back('\b');
+          break;
+        case 'f':
+          out->push_back('\f');
+          break;
+        case 'n':
+          out->push_back('\n');
+          break;
+        case 'r':
+          out->push_back('\r');
+          break;
+        case 't':
+          out->push_back('\t');
+          break;
+        case 'u': {
+          unsigned code = 0;
+          if (!parse_hex4(&code)) {
+            return false;
+          }
+          // A high surrogate must be followed by its low half.
+          if (code >= 0xD800 && code < 0xDC00) {
+            unsigned low = 0;
+            if (!consume('\\') || !consume('u') || !parse_hex4(&low) || low < 0xDC00 ||
+                low >= 0xE000) {
+              return false;
+            }
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+          } else if (code >= 0xDC00 && code < 0xE000) {
+            return false;
+          }
+          append_utf8(code, out);
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    return false;
+  }
+
+  bool parse_literal(std::string* out) {
+    for (const char* word : {"true", "false", "null"}) {
+      size_t length = std::strlen(word);
+      if (text_.compare(pos_, length, word) == 0) {
+        *out = word;
+        pos_ += length;
+        return true;
+      }
+    }
+    // JSON number grammar only: the text is echoed into replies verbatim, so
+    // strtod extras such as "inf", "nan" or hex must not get through.
+    const size_t begin = pos_;
+    consume('-');
+    if (consume('0')) {
+      // No leading zeros.
+    } else if (!consume_digits()) {
+      return false;
+    }
+    if (consume('.') && !consume_digits()) {
+      return false;
+    }
+    if (consume('e') || consume('E')) {
+      if (!consume('+')) {
+        consume('-');
+      }
+      if (!consume_digits()) {
+        return false;
+      }
+    }
+    out->assign(text_, begin, pos_ - begin);
+    return true;
+  }
+
+  // One or more decimal digits.
+  bool consume_digits() {
+    const size_t begin = pos_;
+    while (pos_ < text_.size() && std::isdigit(static_cast<unsigned char>(text_[pos_]))) {
+      ++pos_;
+    }
+    return pos_ > begin;
+  }
+
+  const std::string& text_;
+  size_t pos_ = 0;
+};
+
+} // namespace
+
+void append_json_string(std::string* out, const std::string& value) {
+  out->push_back('"');
+  for (unsigned char c : value) {
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(static_cast<char>(c));
+    } else if (c < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out->append(escaped);
+    } else {
+      out->push_back(static_cast<char>(c));
+    }
+  }
+  out->push_back('"');
+}
+
+void append_items(std::string* out, const char* key, const VpItemResult* items, int count) {
+  char buffer[96];
+  out->append(",\"");
+  out->append(key);
+  out->append("\":{");
+  for (int i = 0; i < count; ++i) {
+    if (i > 0) {
+      out->push_back(',');
+    }
+    append_json_string(out, items[i].id_str);
+    std::snprintf(buffer, sizeof(buffer), ":{\"score\":%.6g,\"raw\":%.6g}", items[i].score,
+                  items[i].raw);
+    out->append(buffer);
+  }
+  out->push_back('}');
+}
+
+bool parse_flat_json_object(const std::string& text, JsonObject* out, std::string* error) {
+  out->clear();
+  return FlatParser(text).parse(out, error);
+}
+
+} // namespace vp_tools
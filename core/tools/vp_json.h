@@ -0,0 +1,33 @@
+#ifndef VP_JSON_H
+#define VP_JSON_H
+
+#include <map>
+#include <string>
+
+#include "vp_analyzer.h"
+
+namespace vp_tools {
+
+// Appends `value` as a JSON string literal.
+void append_json_string(std::string* out, const std::string& value);
+
+// Appends ,"<key>":{"<id_str>":{"score":..,"raw":..},...} for `count` items.
+void append_items(std::string* out, const char* key, const VpItemResult* items, int count);
+
+// One value of a flat JSON object: strings hold their unescaped text;
+// numbers, true, false and null their literal text.
+struct JsonField {
+  std::string text;
+  bool is_string = false;
+};
+
+using JsonObject = std::map<std::string, JsonField>;
+
+// Parses a single object whose values are all scalars (no nested objects or
+// arrays), as used by the line-based tool protocols. Returns false and a
+// message in *error for anything else.
+bool parse_flat_json_object(const std::string& text, JsonObject* out, std::string* error);
+
+} // namespace vp_tools
+
+#endif // VP_JSON_H
@@ -0,0 +1,609 @@
+#include "vp_server.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "vp_analyzer.h"
+#include "vp_frame_source.h"
+#include "vp_json.h"
+
+namespace vp_tools {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Longest request line; a client sending more without a newline is dropped.
+constexpr size_t kMaxRequestBytes = 64u << 10;
+
+// Write end of the stop pipe, for the signal handler.
+volatile sig_atomic_t g_stop_fd = -1;
+
+extern "C" void handle_stop_signal(int) {
+  const int saved_errno = errno;
+  const char byte = 0;
+  if (g_stop_fd >= 0) {
+    (void)!write(g_stop_fd, &byte, 1);
+  }
+  errno = saved_errno;
+}
+
+double elapsed_ms(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// One client socket, shared by its reader thread and the jobs it queued so
+// results can still be written after the client stops sending. The socket is
+// closed when the last reference goes away.
+class Connection {
+ public:
+  explicit Connection(int fd) : fd_(fd) {}
+  ~Connection() { close(fd_); }
+
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+
+  int fd() const { return fd_; }
+
+  // Writes one whole line; lines from different threads never interleave.
+  // Returns false once the peer has gone away.
+  bool send_line(const std::string& line) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    return write_all(line);
+  }
+
+  // Holds back every other writer, e.g. a worker's result line, until the
+  // returned lock is released; write with send_line_locked meanwhile.
+  std::unique_lock<std::mutex> lock_writes() { return std::unique_lock<std::mutex>(write_mutex_); }
+
+  bool send_line_locked(const std::string& line) { return write_all(line); }
+
+ private:
+  bool write_all(const std::string& line) {
+    size_t offset = 0;
+    while (offset < line.size()) {
+      ssize_t written = send(fd_, line.data() + offset, line.size() - offset, MSG_NOSIGNAL);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      offset += static_cast<size_t>(written);
+    }
+    return true;
+  }
+
+  const int fd_;
+  std::mutex write_mutex_;
+};
+
+struct Job {
+  std::shared_ptr<Connection> connection;
+  // The request's "id" as JSON text, echoed in every reply.
+  std::string id;
+  Input input;
+  std::string shm_name;
+  int width = 0;
+  int height = 0;
+  VpPixelFormat shm_format = VP_PIXEL_GRAY8;
+  int max_frames = 0;
+  int near_duplicate_distance = 0;
+  int segment_frames = 0;
+  Clock::time_point queued_at;
+};
+
+class JobQueue {
+ public:
+  explicit JobQueue(size_t capacity) : capacity_(capacity) {}
+
+  // Returns false when the queue is full or closed; *depth receives the
+  // number of queued jobs including this one.
+  bool try_push(Job job, size_t* depth) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (closed_ || jobs_.size() >= capacity_) {
+        return false;
+      }
+      jobs_.push_back(std::move(job));
+      *depth = jobs_.size();
+    }
+    ready_.notify_one();
+    return true;
+  }
+
+  // Blocks for the next job. Returns false once closed and drained.
+  bool pop(Job* job) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_.wait(lock, [this] { return closed_ || !jobs_.empty(); });
+    if (jobs_.empty()) {
+      return false;
+    }
+    *job = std::move(jobs_.front());
+    jobs_.pop_front();
+    return true;
+  }
+
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    ready_.notify_all();
+  }
+
+ private:
+  const size_t capacity_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<Job> jobs_;
+  bool closed_ = false;
+};
+
+bool read_int(const JsonObject& request, const char* key, int* out, std::string* error) {
+  JsonObject::const_iterator it = request.find(key);
+  if (it == request.end()) {
+    return true;
+  }
+  char* end = nullptr;
+  errno = 0;
+  long value = std::strtol(it->second.text.c_str(), &end, 10);
+  if (it->second.is_string || *end != '\0' || errno != 0 || value < -1000000000L ||
+      value > 1000000000L) {
+    *error = std::string("\"") + key + "\" must be an integer";
+    return false;
+  }
+  *out = static_cast<int>(value);
+  return true;
+}
+
+bool read_string(const JsonObject& request, const char* key, std::string* out,
+                 std::string* error) {
+  JsonObject::const_iterator it = request.find(key);
+  if (it == request.end()) {
+    return true;
+  }
+  if (!it->second.is_string) {
+    *error = std::string("\"") + key + "\" must be a string";
+    return false;
+  }
+  *out = it->second.text;
+  return true;
+}
+
+std::string reply_prefix(const std::string& id) {
+  std::string line = "{\"id\":";
+  line.append(id.empty() ? "null" : id);
+  return line;
+}
+
+std::string error_reply(const std::string& id, int code, const std::string& message) {
+  std::string line = reply_prefix(id);
+  line.append(",\"status\":\"error\",\"error\":");
+  append_json_string(&line, message);
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), ",\"code\":%d}\n", code);
+  line.append(buffer);
+  return line;
+}
+
+// Reader threads are detached and share this with the server, so the last
+// one can still signal while the server is being torn down.
+struct Readers {
+  std::mutex mutex;
+  std::condition_variable done;
+  std::set<Connection*> connections;
+  int active = 0;
+};
+
+class Server {
+ public:
+  explicit Server(const ServeOptions& options)
+      : options_(options), queue_(static_cast<size_t>(std::max(1, options.queue_capacity))) {
+    vp_default_config(&defaults_);
+  }
+
+  ~Server() {
+    if (listen_fd_ >= 0) {
+      close(listen_fd_);
+    }
+    if (stop_pipe_[0] >= 0) {
+      close(stop_pipe_[0]);
+      close(stop_pipe_[1]);
+    }
+  }
+
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+
+  int run() {
+    if (pipe(stop_pipe_) != 0) {
+      std::fprintf(stderr, "pipe failed: %s\n", std::strerror(errno));
+      return 1;
+    }
+    fcntl(stop_pipe_[0], F_SETFD, FD_CLOEXEC);
+    fcntl(stop_pipe_[1], F_SETFD, FD_CLOEXEC);
+    fcntl(stop_pipe_[1], F_SETFL, O_NONBLOCK);
+    if (!listen_on(options_.socket_path)) {
+      return 1;
+    }
+
+    int jobs = options_.jobs;
+    if (jobs <= 0) {
+      jobs = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    std::vector<std::thread> workers;
+    for (int i = 0; i < jobs; ++i) {
+      workers.emplace_back(&Server::worker, this);
+    }
+    std::fprintf(stderr, "Listening on %s: %d workers, queue of %d\n",
+                 options_.socket_path.c_str(), jobs, std::max(1, options_.queue_capacity));
+
+    g_stop_fd = stop_pipe_[1];
+    struct sigaction action {};
+    action.sa_handler = handle_stop_signal;
+    sigemptyset(&action.sa_mask);
+    struct sigaction old_int {}, old_term {}, old_pipe {};
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+    action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &action, &old_pipe);
+
+    accept_loop();
+
+    // Stop taking work: no new clients, no further requests from the
+    // connected ones, then let the workers drain what was already queued.
+    close(listen_fd_);
+    listen_fd_ = -1;
+    unlink(options_.socket_path.c_str());
+    {
+      std::unique_lock<std::mutex> lock(readers_->mutex);
+      for (Connection* connection : readers_->connections) {
+        shutdown(connection->fd(), SHUT_RD);
+      }
+      readers_->done.wait(lock, [this] { return readers_->active == 0; });
+    }
+    queue_.close();
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+
+    sigaction(SIGINT, &old_int, nullptr);
+    sigaction(SIGTERM, &old_term, nullptr);
+    sigaction(SIGPIPE, &old_pipe, nullptr);
+    g_stop_fd = -1;
+
+    std::fprintf(stderr, "Served %ld jobs (%ld failed), %ld rejected as busy\n",
+                 totals_ok_ + totals_failed_, totals_failed_, totals_busy_);
+    return 0;
+  }
+
+ private:
+  bool listen_on(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+      std::fprintf(stderr, "Invalid socket path: %s\n", path.c_str());
+      return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+      std::fprintf(stderr, "socket failed: %s\n", std::strerror(errno));
+      return false;
+    }
+    // A socket file nobody answers on is left over from a server that did
+    // not shut down cleanly.
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+      if (connect(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) {
+        std::fprintf(stderr, "Another server is listening on %s\n", path.c_str());
+        return false;
+      }
+      unlink(path.c_str());
+    }
+    // Only the owner may connect: jobs name arbitrary local files.
+    mode_t old_mask = umask(0177);
+    int rc = bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    umask(old_mask);
+    if (rc != 0 || listen(listen_fd_, SOMAXCONN) != 0) {
+      std::fprintf(stderr, "Failed to listen on %s: %s\n", path.c_str(), std::strerror(errno));
+      return false;
+    }
+    return true;
+  }
+
+  void accept_loop() {
+    pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {stop_pipe_[0], POLLIN, 0}};
+    while (true) {
+      if (poll(fds, 2, -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        std::fprintf(stderr, "poll failed: %s\n", std::strerror(errno));
+        return;
+      }
+      if (fds[1].revents != 0) {
+        return;
+      }
+      if (fds[0].revents == 0) {
+        continue;
+      }
+      int fd = accept(listen_fd_, nullptr, nullptr);
+      if (fd < 0) {
+        continue;
+      }
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+      auto connection = std::make_shared<Connection>(fd);
+      {
+        std::lock_guard<std::mutex> lock(readers_->mutex);
+        readers_->connections.insert(connection.get());
+        ++readers_->active;
+      }
+      std::thread(&Server::read_loop, this, std::move(connection), readers_).detach();
+    }
+  }
+
+  void read_loop(std::shared_ptr<Connection> connection, std::shared_ptr<Readers> readers) {
+    std::string pending;
+    char buffer[4096];
+    while (true) {
+      ssize_t received = recv(connection->fd(), buffer, sizeof(buffer), 0);
+      if (received < 0 && errno == EINTR) {
+        continue;
+      }
+      if (received <= 0) {
+        break;
+      }
+      pending.append(buffer, static_cast<size_t>(received));
+      size_t start = 0;
+      size_t newline;
+      while ((newline = pending.find('\n', start)) != std::string::npos) {
+        handle_request(connection, pending.substr(start, newline - start));
+        start = newline + 1;
+      }
+      pending.erase(0, start);
+      if (pending.size() > kMaxRequestBytes) {
+        connection->send_line(error_reply("", VP_ERR_INVALID_ARGUMENT, "Request too long"));
+        break;
+      }
+    }
+
+    // The server may be gone as soon as the count reaches zero; only the
+    // shared reader state is touched from here on.
+    std::lock_guard<std::mutex> lock(readers->mutex);
+    readers->connections.erase(connection.get());
+    --readers->active;
+    readers->done.notify_all();
+  }
+
+  void handle_request(const std::shared_ptr<Connection>& connection, const std::string& text) {
+    if (text.find_first_not_of(" \t\r") == std::string::npos) {
+      return;
+    }
+    JsonObject request;
+    std::string error;
+    if (!parse_flat_json_object(text, &request, &error)) {
+      connection->send_line(error_reply("", VP_ERR_INVALID_ARGUMENT, error));
+      return;
+    }
+
+    Job job;
+    JsonObject::const_iterator id = request.find("id");
+    if (id != request.end()) {
+      if (id->second.is_string) {
+        append_json_string(&job.id, id->second.text);
+      } else {
+        job.id = id->second.text;
+      }
+    }
+
+    std::string op = "score";
+    if (!read_string(request, "op", &op, &error)) {
+      connection->send_line(error_reply(job.id, VP_ERR_INVALID_ARGUMENT, error));
+      return;
+    }
+    if (op == "shutdown") {
+      connection->send_line(reply_prefix(job.id) + ",\"status\":\"stopping\"}\n");
+      const char byte = 0;
+      (void)!write(stop_pipe_[1], &byte, 1);
+      return;
+    }
+    if (op != "score") {
+      connection->send_line(error_reply(job.id, VP_ERR_INVALID_ARGUMENT, "Unknown op: " + op));
+      return;
+    }
+
+    std::string file;
+    std::string format;
+    job.near_duplicate_distance = defaults_.near_duplicate_distance;
+    if (!read_string(request, "file", &file, &error) ||
+        !read_string(request, "shm", &job.shm_name, &error) ||
+        !read_string(request, "format", &format, &error) ||
+        !read_int(request, "width", &job.width, &error) ||
+        !read_int(request, "height", &job.height, &error) ||
+        !read_int(request, "max_frames", &job.max_frames, &error) ||
+        !read_int(request, "near_duplicate_distance", &job.near_duplicate_distance, &error) ||
+        !read_int(request, "best_segment", &job.segment_frames, &error)) {
+      connection->send_line(error_reply(job.id, VP_ERR_INVALID_ARGUMENT, error));
+      return;
+    }
+    if (file.empty() == job.shm_name.empty()) {
+      connection->send_line(
+          error_reply(job.id, VP_ERR_INVALID_ARGUMENT, "Exactly one of \"file\" or \"shm\" is needed"));
+      return;
+    }
+    if (!format.empty() && !parse_raw_format(format.c_str(), &job.shm_format)) {
+      connection->send_line(
+          error_reply(job.id, VP_ERR_INVALID_ARGUMENT, "Unknown raw format: " + format));
+      return;
+    }
+    if (!file.empty()) {
+      job.input = classify_input(file);
+      if (job.input.kind == InputKind::kRaw && !format.empty()) {
+        job.input.raw_format = job.shm_format;
+      }
+    }
+    if ((!job.shm_name.empty() || job.input.kind == InputKind::kRaw) &&
+        (job.width <= 0 || job.height <= 0)) {
+      connection->send_line(error_reply(job.id, VP_ERR_INVALID_ARGUMENT,
+                                        "Raw frames need \"width\" and \"height\""));
+      return;
+    }
+
+    std::string reply = reply_prefix(job.id);
+    job.connection = connection;
+    job.queued_at = Clock::now();
+    size_t depth = 0;
+    // A worker may pick the job up at once; holding the writes keeps its
+    // result line behind the "queued" acknowledgement.
+    std::unique_lock<std::mutex> writes = connection->lock_writes();
+    if (!queue_.try_push(std::move(job), &depth)) {
+      writes.unlock();
+      {
+        std::lock_guard<std::mutex> lock(totals_mutex_);
+        ++totals_busy_;
+      }
+      connection->send_line(reply + ",\"status\":\"busy\"}\n");
+      return;
+    }
+    char buffer[48];
+    std::snprintf(buffer, sizeof(buffer), ",\"status\":\"queued\",\"depth\":%zu}\n", depth);
+    connection->send_line_locked(reply + buffer);
+  }
+
+  // Each worker keeps its analyzer across jobs and only recreates it when a
+  // job asks for a different frame limit or near-duplicate distance. Like
+  // vp_cli, max_frames 0 scores every frame of the input.
+  void worker() {
+    VpAnalyzer* analyzer = nullptr;
+    int analyzer_max_frames = 0;
+    int analyzer_distance = 0;
+    Job job;
+    while (queue_.pop(&job)) {
+      if (!analyzer || analyzer_max_frames != job.max_frames ||
+          analyzer_distance != job.near_duplicate_distance) {
+        vp_destroy(analyzer);
+        VpConfig config = defaults_;
+        config.max_frames = job.max_frames;
+        config.near_duplicate_distance = job.near_duplicate_distance;
+        analyzer = vp_create(&config);
+        analyzer_max_frames = job.max_frames;
+        analyzer_distance = job.near_duplicate_distance;
+      }
+      bool ok = false;
+      std::string line = score(analyzer, job, &ok);
+      job.connection->send_line(line);
+      job.connection.reset();
+      std::lock_guard<std::mutex> lock(totals_mutex_);
+      ++(ok ? totals_ok_ : totals_failed_);
+    }
+    vp_destroy(analyzer);
+  }
+
+  std::string score(VpAnalyzer* analyzer, const Job& job, bool* ok) {
+    const Clock::time_point start = Clock::now();
+    std::string error;
+    int rc = VP_OK;
+    FrameSequence sequence;
+    if (!analyzer) {
+      rc = VP_ERR_ALLOC;
+      error = "Failed to create analyzer";
+    } else if (!job.shm_name.empty()) {
+      rc = sequence.open_shared_memory(job.shm_name.c_str(), job.width, job.height,
+                                       job.shm_format, &error)
+               ? VP_OK
+               : VP_ERR_IO;
+    } else {
+      rc = sequence.open_input(job.input, job.width, job.height, job.max_frames, &error);
+    }
+    if (rc != VP_OK) {
+      *ok = false;
+      return error_reply(job.id, rc, error);
+    }
+    const Clock::time_point opened_at = Clock::now();
+
+    int frame_count = static_cast<int>(sequence.frames().size());
+    if (job.max_frames > 0) {
+      frame_count = std::min(frame_count, job.max_frames);
+    }
+    VpAggregateResult result{};
+    VpSegmentResult segment{};
+    if (job.segment_frames > 0) {
+      VpSegmentQuery query;
+      vp_default_segment_query(&query);
+      query.window_frames = job.segment_frames;
+      rc = vp_analyze_best_segment(analyzer, sequence.frames().data(), frame_count, &query,
+                                   &segment, &result);
+    } else {
+      rc = vp_analyze_frames(analyzer, sequence.frames().data(), frame_count, &result);
+    }
+    if (rc != VP_OK) {
+      *ok = false;
+      return error_reply(job.id, rc, "Analyze failed");
+    }
+    const Clock::time_point done = Clock::now();
+
+    std::string line = reply_prefix(job.id);
+    char buffer[192];
+    std::snprintf(buffer, sizeof(buffer),
+                  ",\"status\":\"ok\",\"frames\":%d,\"queue_ms\":%.3f,\"open_ms\":%.3f,"
+                  "\"analyze_ms\":%.3f",
+                  frame_count, elapsed_ms(job.queued_at, start), elapsed_ms(start, opened_at),
+                  elapsed_ms(opened_at, done));
+    line.append(buffer);
+    append_items(&line, "mean", result.mean, result.item_count);
+    append_items(&line, "worst", result.worst, result.item_count);
+    if (job.segment_frames > 0) {
+      std::snprintf(buffer, sizeof(buffer),
+                    ",\"segment\":{\"start\":%d,\"end\":%d,\"score\":%.6g}", segment.start_frame,
+                    segment.end_frame, segment.score);
+      line.append(buffer);
+    }
+    line.append("}\n");
+    *ok = true;
+    return line;
+  }
+
+  const ServeOptions& options_;
+  VpConfig defaults_;
+  JobQueue queue_;
+  int listen_fd_ = -1;
+  int stop_pipe_[2] = {-1, -1};
+
+  std::shared_ptr<Readers> readers_ = std::make_shared<Readers>();
+
+  std::mutex totals_mutex_;
+  long totals_ok_ = 0;
+  long totals_failed_ = 0;
+  long totals_busy_ = 0;
+};
+
+} // namespace
+
+int run_server(const ServeOptions& options) {
+  Server server(options);
+  return server.run();
+}
+
+} // namespace vp_tools
@@ -0,0 +1,28 @@
+#ifndef VP_SERVER_H
+#define VP_SERVER_H
+
+#include <string>
+
+namespace vp_tools {
+
+struct ServeOptions {
+  // Filesystem path of the Unix domain socket; a stale socket left by a
+  // crashed server is replaced, a live one is an error.
+  std::string socket_path;
+  // Worker threads, each keeping one analyzer warm; 0 uses the hardware
+  // concurrency.
+  int jobs = 0;
+  // Jobs accepted but not yet started; further jobs are answered "busy".
+  int queue_capacity = 64;
+};
+
+// Serves scoring jobs over a Unix domain socket until SIGINT, SIGTERM or a
+// {"op":"shutdown"} request. Each line a client writes is one JSON request;
+// the server answers with a "queued" (or "busy"/"error") line right away and
+// with the result line once a worker has scored the job. Jobs already queued
+// at shutdown are still scored. Returns 0 on a clean shutdown.
+int run_server(const ServeOptions& options);
+
+} // namespace vp_tools
+
+#endif // VP_SERVER_H
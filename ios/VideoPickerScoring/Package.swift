@@ -18,7 +18,19 @@ let package = Package(
             path: "Sources/VideoPickerScoringCore",
             sources: [
                 "vp_analyzer.cpp",
+                "vp_autotune.cpp",
+                "vp_histogram.cpp",
                 "vp_metrics.cpp",
+                "vp_motion.cpp",
+                "vp_phash.cpp",
+                "vp_pipeline.cpp",
+                "vp_sampler.cpp",
+                "vp_scheduler.cpp",
+                "vp_scratch.cpp",
+                "vp_segment.cpp",
+                "vp_signature.cpp",
+                "vp_stats.cpp",
+                "vp_trace.cpp",
                 "vp_analyzer_stub.c"
             ],
             publicHeadersPath: "include",
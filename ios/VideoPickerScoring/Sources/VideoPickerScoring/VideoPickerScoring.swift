@@ -31,6 +31,21 @@ public enum VideoPickerScoringError: Error {
     case unsupportedPixelFormat(OSType)
 }
 
+/// Scheduling class of an analyzeAsync call (see vp_scheduler_submit).
+public enum ScoringPriority {
+    /// The clip the user is looking at; started first.
+    case interactive
+    /// Library scans; pause between frames while interactive work waits.
+    case background
+
+    var vpPriority: VpPriority {
+        switch self {
+        case .interactive: return VP_PRIORITY_INTERACTIVE
+        case .background: return VP_PRIORITY_BACKGROUND
+        }
+    }
+}
+
 public struct FrameInput {
     public let pixelBuffer: CVPixelBuffer
     public let timestamp: CMTime
@@ -43,6 +58,9 @@ public struct FrameInput {
 
 public final class VideoPickerScoring {
     private static let logger = Logger(subsystem: "VideoPickerScoring", category: "OpenCV")
+    /// Shared by every prioritized analyzeAsync call in the process; lives
+    /// until exit.
+    private static let scheduler: OpaquePointer? = vp_scheduler_create(nil)
     private let analyzer: OpaquePointer
 
     public convenience init() throws {
@@ -72,80 +90,173 @@ public final class VideoPickerScoring {
             throw VideoPickerScoringError.emptyFrames
         }
 
-        var vpFrames: [VpFrame] = []
-        vpFrames.reserveCapacity(frames.count)
-        var lockedBuffers: [CVPixelBuffer] = []
-        lockedBuffers.reserveCapacity(frames.count)
+        let (vpFrames, lockedBuffers) = try Self.lockFrames(frames)
+        defer { Self.unlock(lockedBuffers) }
 
-        do {
-            for frame in frames {
-                let pixelBuffer = frame.pixelBuffer
-                guard !CVPixelBufferIsPlanar(pixelBuffer) else {
-                    throw VideoPickerScoringError.unsupportedPixelFormat(
-                        CVPixelBufferGetPixelFormatType(pixelBuffer)
-                    )
-                }
+        var result = VpAggregateResult()
+        let code = vpFrames.withUnsafeBufferPointer { buffer in
+            vp_analyze_frames(analyzer, buffer.baseAddress, Int32(buffer.count), &result)
+        }
+        if code != 0 {
+            throw VideoPickerScoringError.analyzeFailed(code: code)
+        }
+        return Self.aggregate(from: result)
+    }
 
-                CVPixelBufferLockBaseAddress(pixelBuffer, .readOnly)
-                lockedBuffers.append(pixelBuffer)
+    public func analyze(frames: [FrameInput], personBlurScores: [Float]) throws -> VideoQualityAggregate {
+        Self.logger.info("Person blur source: external scores provided by app. count=\(personBlurScores.count)")
+        guard !frames.isEmpty else {
+            throw VideoPickerScoringError.emptyFrames
+        }
+        guard frames.count == personBlurScores.count else {
+            throw VideoPickerScoringError.metricCountMismatch(
+                expected: frames.count,
+                actual: personBlurScores.count
+            )
+        }
 
-                guard let baseAddress = CVPixelBufferGetBaseAddress(pixelBuffer) else {
-                    throw VideoPickerScoringError.invalidFrame
-                }
+        let (vpFrames, lockedBuffers) = try Self.lockFrames(frames)
+        defer { Self.unlock(lockedBuffers) }
 
-                let formatType = CVPixelBufferGetPixelFormatType(pixelBuffer)
-                guard let vpFormat = Self.vpPixelFormat(for: formatType) else {
-                    throw VideoPickerScoringError.unsupportedPixelFormat(formatType)
-                }
-
-                let width = CVPixelBufferGetWidth(pixelBuffer)
-                let height = CVPixelBufferGetHeight(pixelBuffer)
-                let bytesPerRow = CVPixelBufferGetBytesPerRow(pixelBuffer)
+        var metricValues: [VpMetricValue] = personBlurScores.map { score in
+            VpMetricValue(metric_id: Int32(VP_METRIC_PERSON_BLUR.rawValue), raw: score)
+        }
+        var frameMetrics: [VpFrameMetrics] = Array(
+            repeating: VpFrameMetrics(count: 0, values: nil),
+            count: frames.count
+        )
 
-                let vpFrame = VpFrame(
-                    width: Int32(width),
-                    height: Int32(height),
-                    stride_bytes: Int32(bytesPerRow),
-                    format: vpFormat,
-                    data: baseAddress.assumingMemoryBound(to: UInt8.self)
-                )
-                vpFrames.append(vpFrame)
+        var result = VpAggregateResult()
+        let code: Int32 = metricValues.withUnsafeMutableBufferPointer { metricsBuffer in
+            guard let baseMetrics = metricsBuffer.baseAddress else {
+                return Int32(VP_ERR_ALLOC.rawValue)
             }
-        } catch {
-            for buffer in lockedBuffers {
-                CVPixelBufferUnlockBaseAddress(buffer, .readOnly)
+            for index in 0..<frameMetrics.count {
+                frameMetrics[index] = VpFrameMetrics(
+                    count: 1,
+                    values: baseMetrics.advanced(by: index)
+                )
             }
-            throw error
-        }
-
-        defer {
-            for buffer in lockedBuffers {
-                CVPixelBufferUnlockBaseAddress(buffer, .readOnly)
+            return frameMetrics.withUnsafeBufferPointer { frameMetricsBuffer in
+                return vpFrames.withUnsafeBufferPointer { frameBuffer in
+                    Int32(vp_analyze_frames_with_metrics(
+                        analyzer,
+                        frameBuffer.baseAddress,
+                        Int32(frameBuffer.count),
+                        frameMetricsBuffer.baseAddress,
+                        Int32(frameMetricsBuffer.count),
+                        &result
+                    ))
+                }
             }
         }
-
-        var result = VpAggregateResult()
-        let code = vpFrames.withUnsafeBufferPointer { buffer in
-            vp_analyze_frames(analyzer, buffer.baseAddress, Int32(buffer.count), &result)
-        }
         if code != 0 {
             throw VideoPickerScoringError.analyzeFailed(code: code)
         }
         return Self.aggregate(from: result)
     }
 
-    public func analyze(frames: [FrameInput], personBlurScores: [Float]) throws -> VideoQualityAggregate {
-        Self.logger.info("Person blur source: external scores provided by app. count=\(personBlurScores.count)")
+    /// Scores the frames on a background thread of the core. Cancelling the
+    /// calling task stops the analysis between frames (or between the metrics
+    /// of a frame) and throws CancellationError; the core then releases its
+    /// working memory right away. `progress` receives (framesDone, framesTotal)
+    /// on the analysis thread. With a `priority` the analysis runs on the
+    /// process-wide scheduler instead of its own thread, so interactive calls
+    /// overtake background ones.
+    public func analyzeAsync(
+        frames: [FrameInput],
+        personBlurScores: [Float]? = nil,
+        priority: ScoringPriority? = nil,
+        progress: ((Int, Int) -> Void)? = nil
+    ) async throws -> VideoQualityAggregate {
         guard !frames.isEmpty else {
             throw VideoPickerScoringError.emptyFrames
         }
-        guard frames.count == personBlurScores.count else {
+        if let personBlurScores, personBlurScores.count != frames.count {
             throw VideoPickerScoringError.metricCountMismatch(
                 expected: frames.count,
                 actual: personBlurScores.count
             )
         }
+        try Task.checkCancellation()
+
+        let (vpFrames, lockedBuffers) = try Self.lockFrames(frames)
+        defer { Self.unlock(lockedBuffers) }
+        guard let token = vp_cancel_token_create() else {
+            throw VideoPickerScoringError.analyzeFailed(code: Int32(VP_ERR_ALLOC.rawValue))
+        }
+        defer { vp_cancel_token_destroy(token) }
+        // Declared last so it is destroyed (joined) before the buffers unlock.
+        var task: OpaquePointer?
+        defer {
+            if let task {
+                vp_task_destroy(task)
+            }
+        }
+
+        let context = AsyncAnalysis(personBlurScores: personBlurScores, progress: progress)
+        let result: VpAggregateResult = try await withTaskCancellationHandler {
+            try await withCheckedThrowingContinuation { continuation in
+                context.continuation = continuation
+                let userData = Unmanaged.passRetained(context).toOpaque()
+                let progressCallback: VpProgressCallback = { userData, framesDone, framesTotal in
+                    guard let userData else { return }
+                    let context = Unmanaged<AsyncAnalysis>.fromOpaque(userData).takeUnretainedValue()
+                    context.progress?(Int(framesDone), Int(framesTotal))
+                }
+                let completionCallback: VpCompletionCallback = { userData, status, result in
+                    guard let userData else { return }
+                    let context = Unmanaged<AsyncAnalysis>.fromOpaque(userData).takeRetainedValue()
+                    context.finish(status: status, result: result?.pointee)
+                }
+                let code = vpFrames.withUnsafeBufferPointer { frameBuffer -> Int32 in
+                    guard let priority else {
+                        return vp_analyze_frames_async(
+                            analyzer,
+                            frameBuffer.baseAddress,
+                            Int32(frameBuffer.count),
+                            context.frameMetricsPointer,
+                            Int32(context.frameMetrics.count),
+                            token,
+                            progressCallback,
+                            completionCallback,
+                            userData,
+                            &task
+                        )
+                    }
+                    guard let scheduler = Self.scheduler else {
+                        return Int32(VP_ERR_ALLOC.rawValue)
+                    }
+                    return vp_scheduler_submit(
+                        scheduler,
+                        priority.vpPriority,
+                        analyzer,
+                        frameBuffer.baseAddress,
+                        Int32(frameBuffer.count),
+                        context.frameMetricsPointer,
+                        Int32(context.frameMetrics.count),
+                        token,
+                        progressCallback,
+                        completionCallback,
+                        userData,
+                        &task
+                    )
+                }
+                if code != 0 {
+                    Unmanaged<AsyncAnalysis>.fromOpaque(userData).release()
+                    context.continuation = nil
+                    continuation.resume(throwing: VideoPickerScoringError.analyzeFailed(code: code))
+                }
+            }
+        } onCancel: {
+            vp_cancel_token_cancel(token)
+        }
+        return Self.aggregate(from: result)
+    }
 
+    /// Locks every pixel buffer and returns VpFrame views into them. The caller
+    /// unlocks the returned buffers once the core no longer reads the frames.
+    private static func lockFrames(_ frames: [FrameInput]) throws -> ([VpFrame], [CVPixelBuffer]) {
         var vpFrames: [VpFrame] = []
         vpFrames.reserveCapacity(frames.count)
         var lockedBuffers: [CVPixelBuffer] = []
@@ -172,68 +283,26 @@ public final class VideoPickerScoring {
                     throw VideoPickerScoringError.unsupportedPixelFormat(formatType)
                 }
 
-                let width = CVPixelBufferGetWidth(pixelBuffer)
-                let height = CVPixelBufferGetHeight(pixelBuffer)
-                let bytesPerRow = CVPixelBufferGetBytesPerRow(pixelBuffer)
-
                 let vpFrame = VpFrame(
-                    width: Int32(width),
-                    height: Int32(height),
-                    stride_bytes: Int32(bytesPerRow),
+                    width: Int32(CVPixelBufferGetWidth(pixelBuffer)),
+                    height: Int32(CVPixelBufferGetHeight(pixelBuffer)),
+                    stride_bytes: Int32(CVPixelBufferGetBytesPerRow(pixelBuffer)),
                     format: vpFormat,
                     data: baseAddress.assumingMemoryBound(to: UInt8.self)
                 )
                 vpFrames.append(vpFrame)
             }
         } catch {
-            for buffer in lockedBuffers {
-                CVPixelBufferUnlockBaseAddress(buffer, .readOnly)
-            }
+            unlock(lockedBuffers)
             throw error
         }
+        return (vpFrames, lockedBuffers)
+    }
 
-        defer {
-            for buffer in lockedBuffers {
-                CVPixelBufferUnlockBaseAddress(buffer, .readOnly)
-            }
-        }
-
-        var metricValues: [VpMetricValue] = personBlurScores.map { score in
-            VpMetricValue(metric_id: Int32(VP_METRIC_PERSON_BLUR.rawValue), raw: score)
-        }
-        var frameMetrics: [VpFrameMetrics] = Array(
-            repeating: VpFrameMetrics(count: 0, values: nil),
-            count: frames.count
-        )
-
-        var result = VpAggregateResult()
-        let code: Int32 = metricValues.withUnsafeMutableBufferPointer { metricsBuffer in
-            guard let baseMetrics = metricsBuffer.baseAddress else {
-                return Int32(VP_ERR_ALLOC.rawValue)
-            }
-            for index in 0..<frameMetrics.count {
-                frameMetrics[index] = VpFrameMetrics(
-                    count: 1,
-                    values: baseMetrics.advanced(by: index)
-                )
-            }
-            return frameMetrics.withUnsafeBufferPointer { frameMetricsBuffer in
-                return vpFrames.withUnsafeBufferPointer { frameBuffer in
-                    Int32(vp_analyze_frames_with_metrics(
-                        analyzer,
-                        frameBuffer.baseAddress,
-                        Int32(frameBuffer.count),
-                        frameMetricsBuffer.baseAddress,
-                        Int32(frameMetricsBuffer.count),
-                        &result
-                    ))
-                }
-            }
-        }
-        if code != 0 {
-            throw VideoPickerScoringError.analyzeFailed(code: code)
+    private static func unlock(_ buffers: [CVPixelBuffer]) {
+        for buffer in buffers {
+            CVPixelBufferUnlockBaseAddress(buffer, .readOnly)
         }
-        return Self.aggregate(from: result)
     }
 
     public static func defaultConfig() -> VpConfig {
@@ -285,3 +354,47 @@ public final class VideoPickerScoring {
         return VideoQualityAggregate(mean: meanItems, worst: worstItems)
     }
 }
+
+/// State shared with the C callbacks of one analyzeAsync call. The metric
+/// values must outlive the background task, so they live here rather than in
+/// withUnsafeBufferPointer scopes.
+private final class AsyncAnalysis {
+    let progress: ((Int, Int) -> Void)?
+    var continuation: CheckedContinuation<VpAggregateResult, Error>?
+    let frameMetrics: UnsafeMutableBufferPointer<VpFrameMetrics>
+    private let metricValues: UnsafeMutableBufferPointer<VpMetricValue>
+
+    init(personBlurScores: [Float]?, progress: ((Int, Int) -> Void)?) {
+        self.progress = progress
+        let scores = personBlurScores ?? []
+        metricValues = .allocate(capacity: scores.count)
+        frameMetrics = .allocate(capacity: scores.count)
+        for (index, score) in scores.enumerated() {
+            metricValues[index] = VpMetricValue(metric_id: Int32(VP_METRIC_PERSON_BLUR.rawValue), raw: score)
+            frameMetrics[index] = VpFrameMetrics(
+                count: 1,
+                values: UnsafePointer(metricValues.baseAddress!.advanced(by: index))
+            )
+        }
+    }
+
+    deinit {
+        metricValues.deallocate()
+        frameMetrics.deallocate()
+    }
+
+    var frameMetricsPointer: UnsafePointer<VpFrameMetrics>? {
+        frameMetrics.isEmpty ? nil : UnsafePointer(frameMetrics.baseAddress)
+    }
+
+    func finish(status: Int32, result: VpAggregateResult?) {
+        if status == Int32(VP_OK.rawValue), let result {
+            continuation?.resume(returning: result)
+        } else if status == Int32(VP_ERR_CANCELLED.rawValue) {
+            continuation?.resume(throwing: CancellationError())
+        } else {
+            continuation?.resume(throwing: VideoPickerScoringError.analyzeFailed(code: status))
+        }
+        continuation = nil
+    }
+}
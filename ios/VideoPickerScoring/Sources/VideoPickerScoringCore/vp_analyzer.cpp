@@ -1,31 +1,71 @@
 #include "vp_analyzer.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <new>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "vp_autotune.h"
+#include "vp_histogram.h"
 #include "vp_metrics.h"
+#include "vp_motion.h"
+#include "vp_phash.h"
+#include "vp_pipeline.h"
+#include "vp_pixel_access.h"
+#include "vp_sampler.h"
+#include "vp_scheduler.h"
+#include "vp_scratch.h"
+#include "vp_segment.h"
+#include "vp_signature.h"
+#include "vp_stats.h"
+#include "vp_trace.h"
 
 namespace vp {
 
 struct MetricDefinition {
-  VpMetricId id;
+  // A VpMetricId for built-ins, the registered id for custom metrics.
+  int32_t id;
   VpThreshold threshold;
-  float (*compute)(const GrayFrame& frame, const GrayFrame* prev);
+  // Custom metrics only (see vp_register_metric); built-ins are computed by
+  // the format pipeline.
+  VpMetricKernel kernel = nullptr;
+  void* user_data = nullptr;
+  float cost_hint = 0.0f;
+  bool needs_previous_frame = false;
+  char name[VP_METRIC_ID_MAX_LEN] = {};
 };
 
+static const char* metric_name(const MetricDefinition& metric) {
+  return metric.kernel ? metric.name : metric_id_to_string(metric.id);
+}
+
 struct MetricAggregate {
   float sum_raw = 0.0f;
   float sum_score = 0.0f;
   float min_score = 1.0f;
   float raw_at_min = 0.0f;
+  float total_weight = 0.0f;
   int count = 0;
 
-  void update(float raw, float score) {
-    sum_raw += raw;
-    sum_score += score;
+  void update(float raw, float score, float weight) {
+    sum_raw += raw * weight;
+    sum_score += score * weight;
+    total_weight += weight;
     if (score < min_score || count == 0) {
       min_score = score;
       raw_at_min = raw;
@@ -34,34 +74,29 @@ struct MetricAggregate {
   }
 };
 
-static float compute_sharpness_wrapper(const GrayFrame& frame, const GrayFrame*) {
-  return compute_sharpness(frame);
-}
-
-static float compute_exposure_wrapper(const GrayFrame& frame, const GrayFrame*) {
-  return compute_exposure_clipping(frame);
-}
-
-static float compute_motion_blur_wrapper(const GrayFrame& frame, const GrayFrame* prev) {
-  return compute_motion_blur(frame, prev);
-}
-
-static float compute_noise_wrapper(const GrayFrame& frame, const GrayFrame*) {
-  return compute_noise_estimate(frame);
-}
+struct TileTotals {
+  double sharpness[VP_MAX_TILES] = {};
+  double exposure[VP_MAX_TILES] = {};
+  double noise[VP_MAX_TILES] = {};
+  // Frames that added tile sums for each metric.
+  int sharpness_frames = 0;
+  int exposure_frames = 0;
+  int noise_frames = 0;
+};
 
-static float compute_person_blur_wrapper(const GrayFrame& frame, const GrayFrame*) {
-  return compute_sharpness(frame);
+// Mean of `frames` per-frame sums; 0 when the metric was never computed.
+static float tile_mean(double total, int frames) {
+  return frames > 0 ? static_cast<float>(total / frames) : 0.0f;
 }
 
-static bool lookup_metric_override(const VpFrameMetrics* frame_metrics, VpMetricId metric_id,
+static bool lookup_metric_override(const VpFrameMetrics* frame_metrics, int32_t metric_id,
                                    float* out_raw) {
   if (!frame_metrics || !frame_metrics->values || frame_metrics->count <= 0 || !out_raw) {
     return false;
   }
   for (int i = 0; i < frame_metrics->count; ++i) {
     const VpMetricValue& value = frame_metrics->values[i];
-    if (value.metric_id == static_cast<int32_t>(metric_id)) {
+    if (value.metric_id == metric_id) {
       *out_raw = value.raw;
       return true;
     }
@@ -69,6 +104,18 @@ static bool lookup_metric_override(const VpFrameMetrics* frame_metrics, VpMetric
   return false;
 }
 
+static bool is_valid_extras(const VpFrameExtras& extras) {
+  if (extras.box_count < 0 || extras.box_count > VP_MAX_PERSON_BOXES ||
+      (extras.box_count > 0 && !extras.boxes)) {
+    return false;
+  }
+  if (extras.mask && (extras.mask_width <= 0 || extras.mask_height <= 0 ||
+                      extras.mask_stride < extras.mask_width)) {
+    return false;
+  }
+  return true;
+}
+
 static VpThreshold threshold_for_metric(const VpConfig& config, VpMetricId id) {
   int index = static_cast<int>(id);
   if (index < 0 || index >= VP_MAX_ITEMS) {
@@ -77,80 +124,77 @@ static VpThreshold threshold_for_metric(const VpConfig& config, VpMetricId id) {
   return config.thresholds[index];
 }
 
-static bool prepare_gray_frame(const VpFrame& input, std::vector<uint8_t>& buffer, GrayFrame* out) {
-  if (!out || !input.data || input.width <= 0 || input.height <= 0) {
-    return false;
-  }
-
-  int bytes_per_pixel = 0;
-  switch (input.format) {
-    case VP_PIXEL_GRAY8:
-      bytes_per_pixel = 1;
-      break;
-    case VP_PIXEL_RGBA8888:
-    case VP_PIXEL_BGRA8888:
-      bytes_per_pixel = 4;
-      break;
-    default:
-      return false;
-  }
-
-  if (input.stride_bytes <= 0 || input.stride_bytes < input.width * bytes_per_pixel) {
-    return false;
-  }
-
-  buffer.assign(static_cast<size_t>(input.width) * static_cast<size_t>(input.height), 0);
-
-  for (int y = 0; y < input.height; ++y) {
-    const uint8_t* row = input.data + static_cast<size_t>(y) * static_cast<size_t>(input.stride_bytes);
-    uint8_t* dst = buffer.data() + static_cast<size_t>(y) * static_cast<size_t>(input.width);
-    if (input.format == VP_PIXEL_GRAY8) {
-      std::copy(row, row + input.width, dst);
-    } else {
-      for (int x = 0; x < input.width; ++x) {
-        int offset = x * 4;
-        uint8_t r = 0;
-        uint8_t g = 0;
-        uint8_t b = 0;
-        if (input.format == VP_PIXEL_RGBA8888) {
-          r = row[offset];
-          g = row[offset + 1];
-          b = row[offset + 2];
-        } else {
-          b = row[offset];
-          g = row[offset + 1];
-          r = row[offset + 2];
-        }
-        dst[x] = static_cast<uint8_t>((299 * r + 587 * g + 114 * b) / 1000);
-      }
-    }
-  }
+// Deadline mode: auto downscale aims for at least this many frames per
+// budget, never below this short side, and never beyond this factor.
+constexpr int kDeadlineMinFrames = 3;
+constexpr int kDeadlineMinShortSide = 64;
+constexpr int kDeadlineMaxFactor = 16;
+// Cost-model seed before the first measurement (full pipeline, one core).
+constexpr double kDeadlineInitialNsPerPixel = 4.0;
 
-  out->width = input.width;
-  out->height = input.height;
-  out->stride = input.width;
-  out->data = buffer.data();
-  return true;
-}
+// Progress reporting, cancellation and best-segment search for one analyze
+// call; all optional.
+struct AnalyzeControl {
+  const std::atomic<bool>* cancel = nullptr;
+  std::atomic<int32_t>* frames_done = nullptr;
+  VpProgressCallback progress = nullptr;
+  void* user_data = nullptr;
+  // Fed every scored frame; prepared with begin_segment().
+  SegmentFinder* segment = nullptr;
+  // Scheduled tasks may be preempted between frames.
+  Scheduler* scheduler = nullptr;
+  ScheduledJob* job = nullptr;
+};
 
 class AnalyzerImpl {
  public:
   explicit AnalyzerImpl(const VpConfig& config)
       : config_(config) {
-    metrics_.push_back({VP_METRIC_SHARPNESS, threshold_for_metric(config_, VP_METRIC_SHARPNESS),
-                        compute_sharpness_wrapper});
-    metrics_.push_back({VP_METRIC_EXPOSURE, threshold_for_metric(config_, VP_METRIC_EXPOSURE),
-                        compute_exposure_wrapper});
-    metrics_.push_back({VP_METRIC_MOTION_BLUR, threshold_for_metric(config_, VP_METRIC_MOTION_BLUR),
-                        compute_motion_blur_wrapper});
-    metrics_.push_back(
-        {VP_METRIC_NOISE, threshold_for_metric(config_, VP_METRIC_NOISE), compute_noise_wrapper});
-    metrics_.push_back({VP_METRIC_PERSON_BLUR, threshold_for_metric(config_, VP_METRIC_PERSON_BLUR),
-                        compute_person_blur_wrapper});
+    // Trace events keep pointers to custom metric names, so the definitions
+    // must never move.
+    metrics_.reserve(VP_MAX_ITEMS);
+    for (int id = 0; id < kBuiltinMetricCount; ++id) {
+      metrics_.push_back({id, threshold_for_metric(config_, static_cast<VpMetricId>(id))});
+    }
+    const char* profile_path =
+        config_.tuning_profile ? config_.tuning_profile : std::getenv("VP_TUNING_PROFILE");
+    const TuningProfile profile = resolve_tuning_profile(profile_path, config_.autotune != 0);
+    for (int format = 0; format < kPixelFormatCount; ++format) {
+      pipelines_[format] =
+          select_pipeline(static_cast<VpPixelFormat>(format), profile.pipelines[format]);
+      hashers_[format] = select_frame_hash(static_cast<VpPixelFormat>(format));
+    }
+    if (config_.exposure_clip_low >= 0 && config_.exposure_clip_high <= kHistogramBins - 1 &&
+        config_.exposure_clip_low < config_.exposure_clip_high) {
+      clip_levels_.low = config_.exposure_clip_low;
+      clip_levels_.high = config_.exposure_clip_high;
+    }
+    grid_cols_ = std::max(0, std::min(config_.grid_cols, VP_MAX_GRID_DIM));
+    grid_rows_ = std::max(0, std::min(config_.grid_rows, VP_MAX_GRID_DIM));
+    if (grid_cols_ == 0 || grid_rows_ == 0) {
+      grid_cols_ = 0;
+      grid_rows_ = 0;
+    }
+
+    const char* env_trace_path = nullptr;
+    bool env_trace = trace_enabled_from_env(&env_trace_path);
+    if (config_.enable_trace != 0 || env_trace) {
+      tracer_.reset(new (std::nothrow) Tracer());
+    }
+    if (env_trace_path) {
+      trace_path_ = env_trace_path;
+    }
+  }
+
+  ~AnalyzerImpl() {
+    if (tracer_ && !trace_path_.empty()) {
+      tracer_->write_chrome_json(trace_path_.c_str());
+    }
   }
 
   int analyze(const VpFrame* frames, int frame_count, const VpFrameMetrics* frame_metrics,
-              int frame_metrics_count, VpAggregateResult* out_result) {
+              int frame_metrics_count, const VpFrameExtras* extras, int extras_count,
+              VpAggregateResult* out_result, const AnalyzeControl& control = AnalyzeControl()) {
     if (!frames || frame_count <= 0 || !out_result) {
       return VP_ERR_INVALID_ARGUMENT;
     }
@@ -158,79 +202,721 @@ class AnalyzerImpl {
         (!frame_metrics && frame_metrics_count != 0)) {
       return VP_ERR_INVALID_ARGUMENT;
     }
+    if ((extras && extras_count != frame_count) || (!extras && extras_count != 0)) {
+      return VP_ERR_INVALID_ARGUMENT;
+    }
 
-    int max_frames = config_.max_frames > 0 ? config_.max_frames : frame_count;
-    int frames_to_process = std::min(frame_count, max_frames);
+    TraceScope analyze_trace(tracer_.get(), "analyze", "analyzer");
+
+    int frames_to_process = frame_limit(frame_count);
     if (frames_to_process <= 0) {
       return VP_ERR_INVALID_ARGUMENT;
     }
 
-    std::vector<MetricAggregate> aggregates(metrics_.size());
-    std::vector<uint8_t> current_gray;
-    std::vector<uint8_t> previous_gray;
-    GrayFrame previous_frame{};
-    bool has_previous = false;
-
+    SequenceState state;
+    begin_sequence(&state);
+    cancel_ = control.cancel;
     for (int i = 0; i < frames_to_process; ++i) {
-      GrayFrame frame{};
-      if (!prepare_gray_frame(frames[i], current_gray, &frame)) {
-        return VP_ERR_UNSUPPORTED;
+      float raw_values[VP_MAX_ITEMS] = {};
+      const VpFrame* prev_ptr = i > 0 ? &frames[i - 1] : nullptr;
+      int rc = is_cancelled() ? VP_ERR_CANCELLED
+                              : score_frame(frames[i], prev_ptr, extras ? &extras[i] : nullptr,
+                                            frame_metrics ? &frame_metrics[i] : nullptr, i,
+                                            &state, raw_values);
+      if (rc == VP_OK && is_cancelled()) {
+        rc = VP_ERR_CANCELLED;
       }
+      if (rc != VP_OK) {
+        cancel_ = nullptr;
+        if (rc == VP_ERR_CANCELLED) {
+          release_working_memory();
+        }
+        return rc;
+      }
+      accumulate(&state, i, raw_values, 1.0f);
+      if (control.segment) {
+        push_segment(control.segment, raw_values);
+      }
+      if (control.frames_done) {
+        control.frames_done->store(i + 1, std::memory_order_relaxed);
+      }
+      if (control.progress) {
+        control.progress(control.user_data, i + 1, frames_to_process);
+      }
+      if (control.scheduler && i + 1 < frames_to_process) {
+        control.scheduler->checkpoint(control.job);
+      }
+    }
+    cancel_ = nullptr;
+    record_signature(frames, frames_to_process);
+    return finish_sequence(state, out_result);
+  }
+
+  // Number of frames an analyze call over frame_count frames scores.
+  int frame_limit(int frame_count) const {
+    int max_frames = config_.max_frames > 0 ? config_.max_frames : frame_count;
+    return std::min(frame_count, max_frames);
+  }
+
+  // Claimed by a background task for its whole run.
+  bool try_acquire() { return !busy_.exchange(true, std::memory_order_acquire); }
+  void release() { busy_.store(false, std::memory_order_release); }
+  bool busy() const { return busy_.load(std::memory_order_acquire); }
+
+  int analyze_adaptive(const VpAdaptiveSampling& sampling, VpFrameProvider provider,
+                       void* user_data, VpAggregateResult* out_result, double* out_times,
+                       int out_times_capacity, int* out_sample_count) {
+    if (!provider || !out_result || (!out_times && out_times_capacity != 0) ||
+        out_times_capacity < 0 || !(sampling.end_sec >= sampling.start_sec) ||
+        sampling.min_interval_sec < 0.0 || sampling.motion_offset_sec < 0.0) {
+      return VP_ERR_INVALID_ARGUMENT;
+    }
+    int budget = sampling.frame_budget > 0 ? sampling.frame_budget : config_.max_frames;
+    if (budget <= 0) {
+      return VP_ERR_INVALID_ARGUMENT;
+    }
+
+    Tracer* tracer = tracer_.get();
+    TraceScope analyze_trace(tracer, "analyze_adaptive", "analyzer");
+
+    SequenceState state;
+    begin_sequence(&state);
+    sampler_.reset(sampling.start_sec, sampling.end_sec, sampling.initial_samples, budget,
+                   sampling.min_interval_sec);
+    sample_raw_.resize(static_cast<size_t>(budget));
 
-      GrayFrame* prev_ptr = has_previous ? &previous_frame : nullptr;
-      const VpFrameMetrics* metrics_for_frame =
-          frame_metrics ? &frame_metrics[i] : nullptr;
-      for (size_t metric_index = 0; metric_index < metrics_.size(); ++metric_index) {
-        const MetricDefinition& metric = metrics_[metric_index];
-        float raw = 0.0f;
-        if (!lookup_metric_override(metrics_for_frame, metric.id, &raw)) {
-          raw = metric.compute(frame, prev_ptr);
+    double time_sec = 0.0;
+    while (sampler_.next(&time_sec)) {
+      int index = static_cast<int>(sampler_.sample_count());
+      VpFrame reference{};
+      const VpFrame* prev_ptr = nullptr;
+      double reference_sec = std::max(0.0, time_sec - sampling.motion_offset_sec);
+      if (sampling.motion_offset_sec > 0.0 && reference_sec < time_sec) {
+        int rc = fetch_motion_reference(provider, user_data, reference_sec, index, &reference);
+        if (rc != VP_OK) {
+          return rc;
         }
-        float score = normalize_score(raw, metrics_[metric_index].threshold);
-        aggregates[metric_index].update(raw, score);
-        if (config_.log_frame_details != 0) {
-          std::fprintf(stderr, "vp_scoring frame=%d metric=%s score=%.6f raw=%.6f\n", i,
-                       metric_id_to_string(metrics_[metric_index].id), score, raw);
+        prev_ptr = &reference;
+      }
+
+      // Samples are not consecutive, and the provider may reuse its buffers.
+      motion_.reset();
+      VpFrame frame{};
+      int rc = provider(user_data, time_sec, &frame);
+      if (rc != VP_OK) {
+        return rc;
+      }
+      float* raw_values = sample_raw_[index].data();
+      std::fill(raw_values, raw_values + VP_MAX_ITEMS, 0.0f);
+      rc = score_frame(frame, prev_ptr, nullptr, nullptr, index, &state, raw_values);
+      if (rc != VP_OK) {
+        return rc;
+      }
+
+      float composite = 0.0f;
+      for (const MetricDefinition& metric : metrics_) {
+        composite += normalize_score(raw_values[metric.id], metric.threshold);
+      }
+      sampler_.report(composite / static_cast<float>(metrics_.size()));
+    }
+
+    // Refined regions hold more samples; weighting by the time each sample
+    // covers keeps the mean an estimate over the whole clip.
+    sampler_.ordered(&sample_order_, &sample_spans_);
+    int sample_count = static_cast<int>(sample_order_.size());
+    for (int i = 0; i < sample_count; ++i) {
+      int index = sample_order_[i];
+      accumulate(&state, i, sample_raw_[index].data(), static_cast<float>(sample_spans_[i]));
+      if (i < out_times_capacity) {
+        out_times[i] = sampler_.sample(static_cast<size_t>(index)).time;
+      }
+    }
+    if (out_sample_count) {
+      *out_sample_count = sample_count;
+    }
+    return finish_sequence(state, out_result);
+  }
+
+  int analyze_deadline(const VpFrame* frames, int frame_count, const VpDeadline& deadline,
+                       VpAggregateResult* out_result, VpDeadlineReport* out_report) {
+    if (!frames || frame_count <= 0 || !out_result || !(deadline.budget_ms > 0.0) ||
+        deadline.max_short_side < 0) {
+      return VP_ERR_INVALID_ARGUMENT;
+    }
+    const Clock::time_point start = Clock::now();
+    TraceScope analyze_trace(tracer_.get(), "analyze_deadline", "analyzer");
+
+    const int frames_total = frame_limit(frame_count);
+    if (!is_valid_frame(frames[0])) {
+      return VP_ERR_UNSUPPORTED;
+    }
+    const int factor = deadline_factor(frames[0], deadline);
+    const double pixels_per_frame = static_cast<double>(frames[0].width / factor) *
+                                    static_cast<double>(frames[0].height / factor);
+    const double budget_ns = deadline.budget_ms * 1e6;
+
+    SequenceState state;
+    begin_sequence(&state);
+    progressive_order(frames_total, &progressive_order_, &progressive_seen_);
+    sample_raw_.resize(static_cast<size_t>(frames_total));
+
+    // Predicted cost of the next frame: the cost model first, then a running
+    // average of the frames measured in this call.
+    double frame_ns = ns_per_pixel_ * pixels_per_frame;
+    double scoring_ns = 0.0;
+    int covered = 0;
+    for (; covered < frames_total; ++covered) {
+      const Clock::time_point frame_start = Clock::now();
+      if (covered > 0 && elapsed_ns(start, frame_start) + frame_ns > budget_ns) {
+        break;
+      }
+      const int index = progressive_order_[covered];
+      VpFrame frame = frames[index];
+      VpFrame prev = index > 0 ? frames[index - 1] : VpFrame{};
+      if (factor > 1) {
+        int rc = downscale_frame(frames[index], factor, kScratchDeadlineCurrent, &frame);
+        if (rc == VP_OK && index > 0) {
+          rc = downscale_frame(frames[index - 1], factor, kScratchDeadlinePrevious, &prev);
+        }
+        if (rc != VP_OK) {
+          return rc;
         }
       }
+      // Sampled frames are not consecutive, and downscaled planes reuse the
+      // same scratch slots.
+      motion_.reset();
+      float* raw_values = sample_raw_[covered].data();
+      std::fill(raw_values, raw_values + VP_MAX_ITEMS, 0.0f);
+      int rc = score_frame(frame, index > 0 ? &prev : nullptr, nullptr, nullptr, index, &state,
+                           raw_values);
+      if (rc != VP_OK) {
+        return rc;
+      }
+      const double measured_ns = elapsed_ns(frame_start, Clock::now());
+      scoring_ns += measured_ns;
+      frame_ns = covered == 0 ? measured_ns : 0.5 * (frame_ns + measured_ns);
+    }
+    // The first call of an analyzer also pays for scratch growth, so the
+    // model moves only halfway towards each measurement.
+    ns_per_pixel_ = 0.5 * (ns_per_pixel_ + scoring_ns / (covered * pixels_per_frame));
 
-      previous_gray.swap(current_gray);
-      previous_frame = frame;
-      previous_frame.data = previous_gray.data();
-      has_previous = true;
+    // Each scored frame stands for half the distance to its scored neighbours.
+    sample_order_.resize(static_cast<size_t>(covered));
+    sample_spans_.resize(static_cast<size_t>(covered));
+    for (int i = 0; i < covered; ++i) {
+      sample_order_[i] = i;
+    }
+    std::sort(sample_order_.begin(), sample_order_.end(), [this](int a, int b) {
+      return progressive_order_[a] < progressive_order_[b];
+    });
+    double total_span = 0.0;
+    for (int i = 0; i < covered; ++i) {
+      int before = progressive_order_[sample_order_[i > 0 ? i - 1 : i]];
+      int after = progressive_order_[sample_order_[i + 1 < covered ? i + 1 : i]];
+      sample_spans_[i] = 0.5 * (after - before);
+      total_span += sample_spans_[i];
     }
+    for (int i = 0; i < covered; ++i) {
+      float weight = total_span > 0.0 ? static_cast<float>(sample_spans_[i]) : 1.0f;
+      accumulate(&state, progressive_order_[sample_order_[i]], sample_raw_[sample_order_[i]].data(),
+                 weight);
+    }
+
+    record_signature(frames, frames_total);
+    int rc = finish_sequence(state, out_result);
+    if (out_report) {
+      out_report->frames_covered = covered;
+      out_report->frames_total = frames_total;
+      out_report->downscale_factor = factor;
+      out_report->elapsed_ms = elapsed_ns(start, Clock::now()) / 1e6;
+    }
+    return rc;
+  }
+
+  int get_tile_grid(VpTileGrid* out_grid) const {
+    if (grid_cols_ == 0) {
+      return VP_ERR_UNSUPPORTED;
+    }
+    if (grid_.frame_count == 0) {
+      return VP_ERR_DECODE;
+    }
+    *out_grid = grid_;
+    return VP_OK;
+  }
+
+  int analyze_best_segment(const VpFrame* frames, int frame_count, const VpSegmentQuery& query,
+                           VpSegmentResult* out_segment, VpAggregateResult* out_result) {
+    int window = query.window_frames;
+    if (window <= 0 && query.window_sec > 0.0f && config_.fps > 0.0f) {
+      window = std::max(1, static_cast<int>(std::lround(query.window_sec * config_.fps)));
+    }
+    if (!out_segment || window <= 0) {
+      return VP_ERR_INVALID_ARGUMENT;
+    }
+    float weights[VP_MAX_ITEMS] = {};
+    for (size_t metric_index = 0; metric_index < metrics_.size(); ++metric_index) {
+      weights[metric_index] = query.weights[metrics_[metric_index].id];
+      if (!(weights[metric_index] >= 0.0f)) {
+        return VP_ERR_INVALID_ARGUMENT;
+      }
+    }
+
+    segment_.reset(window, static_cast<int>(metrics_.size()), weights);
+    AnalyzeControl control;
+    control.segment = &segment_;
+    VpAggregateResult whole{};
+    int rc = analyze(frames, frame_count, nullptr, 0, nullptr, 0, out_result ? out_result : &whole,
+                     control);
+    if (rc != VP_OK) {
+      return rc;
+    }
+    segment_.finish();
+
+    *out_segment = VpSegmentResult{};
+    out_segment->start_frame = segment_.start();
+    out_segment->end_frame = segment_.end();
+    if (config_.fps > 0.0f) {
+      out_segment->start_sec = segment_.start() / static_cast<double>(config_.fps);
+      out_segment->end_sec = segment_.end() / static_cast<double>(config_.fps);
+    }
+    out_segment->score = segment_.score();
+    out_segment->item_count = static_cast<int32_t>(metrics_.size());
+    for (size_t metric_index = 0; metric_index < metrics_.size(); ++metric_index) {
+      const SegmentFinder::MetricWindow& window_stats = segment_.metric(static_cast<int>(metric_index));
+      fill_item(metrics_[metric_index], window_stats.mean_score, window_stats.mean_raw,
+                &out_segment->mean[metric_index]);
+      fill_item(metrics_[metric_index], window_stats.worst_score, window_stats.worst_raw,
+                &out_segment->worst[metric_index]);
+    }
+    return VP_OK;
+  }
+
+  int get_video_signature(VpVideoSignature* out_signature) const {
+    if (!has_signature_) {
+      return VP_ERR_DECODE;
+    }
+    *out_signature = signature_;
+    return VP_OK;
+  }
+
+  int get_exposure_stats(VpExposureStats* out_stats) const {
+    if (exposure_.frame_count == 0) {
+      return VP_ERR_DECODE;
+    }
+    *out_stats = exposure_;
+    return VP_OK;
+  }
+
+  int register_metric(const VpCustomMetric& custom) {
+    if (custom.metric_id < VP_METRIC_CUSTOM_FIRST || custom.metric_id >= VP_MAX_ITEMS ||
+        !custom.kernel || custom.id_str[0] == '\0' ||
+        !std::memchr(custom.id_str, '\0', VP_METRIC_ID_MAX_LEN) || !(custom.cost_hint >= 0.0f)) {
+      return VP_ERR_INVALID_ARGUMENT;
+    }
+    for (const MetricDefinition& metric : metrics_) {
+      if (metric.id == custom.metric_id) {
+        return VP_ERR_INVALID_ARGUMENT;
+      }
+    }
+    MetricDefinition metric{custom.metric_id, custom.threshold};
+    metric.kernel = custom.kernel;
+    metric.user_data = custom.user_data;
+    metric.cost_hint = custom.cost_hint;
+    metric.needs_previous_frame = custom.needs_previous_frame != 0;
+    std::memcpy(metric.name, custom.id_str, VP_METRIC_ID_MAX_LEN);
+    metrics_.push_back(metric);
+
+    // Cheapest first, registration order among equals.
+    const int metric_index = static_cast<int>(metrics_.size() - 1);
+    custom_order_.insert(std::upper_bound(custom_order_.begin(), custom_order_.end(), metric_index,
+                                          [this](int a, int b) {
+                                            return metrics_[a].cost_hint < metrics_[b].cost_hint;
+                                          }),
+                         metric_index);
+    if (metric.needs_previous_frame) {
+      previous_frame_metrics_ |= metric_bit(metric.id);
+    }
+    // Until deadline mode measures a frame with the metric, trust the hint.
+    ns_per_pixel_ += custom.cost_hint;
+    return VP_OK;
+  }
+
+  // Stats only knows the built-in names.
+  void name_custom_metric_stats(VpStats* stats) const {
+    for (int i = 0; i < stats->metric_count; ++i) {
+      for (const MetricDefinition& metric : metrics_) {
+        if (metric.kernel && metric.id == stats->metrics[i].metric_id) {
+          std::snprintf(stats->metrics[i].id_str, VP_METRIC_ID_MAX_LEN, "%s", metric.name);
+        }
+      }
+    }
+  }
+
+  Stats& stats() { return stats_; }
+  const Tracer* tracer() const { return tracer_.get(); }
+  Tracer* tracer() { return tracer_.get(); }
+  ScratchArena& scratch() { return scratch_; }
+
+ private:
+  // Per-call state shared by the frame loop of each analyze entry point.
+  struct SequenceState {
+    std::array<MetricAggregate, VP_MAX_ITEMS> aggregates{};
+    int frame_count = 0;
+    // Last fully scored frame, for near-duplicate reuse.
+    bool has_reference = false;
+    uint64_t reference_hash = 0;
+    int reference_width = 0;
+    int reference_height = 0;
+    uint32_t reference_mask = 0;
+    float reference_raw[VP_MAX_ITEMS] = {};
+  };
+
+  void record_signature(const VpFrame* frames, int frame_count) {
+    TraceScope trace(tracer_.get(), "signature", "analyzer");
+    has_signature_ = compute_signature(frames, frame_count, &signature_) == VP_OK;
+  }
+
+  void begin_sequence(SequenceState* state) {
+    *state = SequenceState{};
+    motion_.reset();
+    std::fill(std::begin(histogram_totals_), std::end(histogram_totals_), 0);
+    histogram_frames_ = 0;
+    if (grid_cols_ * grid_rows_ > 0) {
+      tile_totals_ = TileTotals{};
+    }
+  }
+
+  // Scores one frame into raw_values[metric_id]; `index` labels trace events.
+  int score_frame(const VpFrame& frame, const VpFrame* prev, const VpFrameExtras* extras,
+                  const VpFrameMetrics* frame_metrics, int index, SequenceState* state,
+                  float* raw_values) {
+    Tracer* tracer = tracer_.get();
+    TraceScope frame_trace(tracer, "frame", "analyzer", index);
+    if (!is_valid_frame(frame)) {
+      return VP_ERR_UNSUPPORTED;
+    }
+    FramePipeline pipeline = pipelines_[frame.format];
+    if (!pipeline) {
+      return VP_ERR_UNSUPPORTED;
+    }
+    if (extras && !is_valid_extras(*extras)) {
+      return VP_ERR_INVALID_ARGUMENT;
+    }
+
+    const bool dedup = config_.near_duplicate_distance > 0;
+    uint64_t hash = 0;
+    uint32_t reuse_mask = 0;
+    if (dedup) {
+      TraceScope hash_trace(tracer, "phash", "analyzer", index);
+      hash = hashers_[frame.format](frame);
+      if (state->has_reference && frame.width == state->reference_width &&
+          frame.height == state->reference_height &&
+          hamming_distance(hash, state->reference_hash) < config_.near_duplicate_distance) {
+        reuse_mask = state->reference_mask & ~previous_frame_metrics_;
+        if (has_person_region(extras)) {
+          reuse_mask &= ~metric_bit(VP_METRIC_PERSON_BLUR);
+        }
+        stats_.add_near_duplicate();
+      }
+    }
+
+    uint32_t compute_mask = 0;
+    for (size_t metric_index = 0; metric_index < metrics_.size(); ++metric_index) {
+      const MetricDefinition& metric = metrics_[metric_index];
+      if (lookup_metric_override(frame_metrics, metric.id, &raw_values[metric.id])) {
+        stats_.add_metric_override(metric.id, metric.id);
+      } else if (reuse_mask & metric_bit(metric.id)) {
+        raw_values[metric.id] = state->reference_raw[metric.id];
+      } else {
+        compute_mask |= metric_bit(metric.id);
+      }
+    }
+
+    StageTimer frame_timer;
+    const int tile_count = grid_cols_ * grid_rows_;
+    PipelineContext context{&stats_, tracer, index, nullptr, &motion_, clip_levels_,
+                            &frame_histogram_, cancel_, &scratch_};
+    // Reused frames keep the reference frame's tile sums.
+    if (tile_count > 0 && reuse_mask == 0) {
+      tile_sums_.begin_frame(grid_cols_, grid_rows_, frame.width, frame.height);
+      context.tiles = &tile_sums_;
+    }
+    pipeline(frame, prev, extras, compute_mask, raw_values, context);
+    int rc = run_custom_metrics(frame, prev, compute_mask, index, raw_values);
+    if (rc != VP_OK) {
+      return rc;
+    }
+    if (dedup && reuse_mask == 0) {
+      state->has_reference = true;
+      state->reference_hash = hash;
+      state->reference_width = frame.width;
+      state->reference_height = frame.height;
+      state->reference_mask = compute_mask;
+      std::copy(raw_values, raw_values + VP_MAX_ITEMS, state->reference_raw);
+    }
+    // A reused exposure value comes with the reference frame's histogram,
+    // which is still the last one computed.
+    if ((compute_mask | reuse_mask) & metric_bit(VP_METRIC_EXPOSURE)) {
+      for (int bin = 0; bin < kHistogramBins; ++bin) {
+        histogram_totals_[bin] += frame_histogram_.bins[bin];
+      }
+      ++histogram_frames_;
+    }
+    // tile_sums_ holds this frame's tiles for the metrics it computed, or the
+    // reference frame's for the metrics it reused; overridden ones have none.
+    const uint32_t tiled_mask = reuse_mask ? reuse_mask : compute_mask;
+    if (tile_count > 0 && (tiled_mask & metric_bit(VP_METRIC_SHARPNESS))) {
+      for (int tile = 0; tile < tile_count; ++tile) {
+        tile_totals_.sharpness[tile] += tile_sums_.sharpness(tile);
+      }
+      ++tile_totals_.sharpness_frames;
+    }
+    if (tile_count > 0 && (tiled_mask & metric_bit(VP_METRIC_EXPOSURE))) {
+      for (int tile = 0; tile < tile_count; ++tile) {
+        tile_totals_.exposure[tile] += tile_sums_.exposure(tile);
+      }
+      ++tile_totals_.exposure_frames;
+    }
+    if (tile_count > 0 && (tiled_mask & metric_bit(VP_METRIC_NOISE))) {
+      for (int tile = 0; tile < tile_count; ++tile) {
+        tile_totals_.noise[tile] += tile_sums_.noise(tile);
+      }
+      ++tile_totals_.noise_frames;
+    }
+    stats_.add_stage(VP_STAGE_METRICS, 1,
+                     static_cast<uint64_t>(frame.width) * static_cast<uint64_t>(frame.height), 0,
+                     frame_timer.stop());
+    ++state->frame_count;
+    return VP_OK;
+  }
+
+  // Runs the custom metrics selected in compute_mask, cheapest first, on the
+  // frame the pipeline just scored.
+  int run_custom_metrics(const VpFrame& frame, const VpFrame* prev, uint32_t compute_mask,
+                         int index, float* raw_values) {
+    for (int metric_index : custom_order_) {
+      const MetricDefinition& metric = metrics_[metric_index];
+      if (!(compute_mask & metric_bit(metric.id))) {
+        continue;
+      }
+      if (is_cancelled()) {
+        return VP_OK;
+      }
+      TraceScope trace(tracer_.get(), metric.name, "metric", index);
+      StageTimer timer;
+      int rc = metric.kernel(metric.user_data, &frame, metric.needs_previous_frame ? prev : nullptr,
+                             &raw_values[metric.id]);
+      stats_.add_metric(metric.id, metric.id, timer.stop());
+      if (rc != VP_OK) {
+        return rc;
+      }
+    }
+    return VP_OK;
+  }
+
+  void accumulate(SequenceState* state, int index, const float* raw_values, float weight) {
+    for (size_t metric_index = 0; metric_index < metrics_.size(); ++metric_index) {
+      float raw = raw_values[metrics_[metric_index].id];
+      float score = normalize_score(raw, metrics_[metric_index].threshold);
+      state->aggregates[metric_index].update(raw, score, weight);
+      if (config_.log_frame_details != 0) {
+        std::fprintf(stderr, "vp_scoring frame=%d metric=%s score=%.6f raw=%.6f\n", index,
+                     metric_name(metrics_[metric_index]), score, raw);
+      }
+    }
+  }
+
+  void push_segment(SegmentFinder* segment, const float* raw_values) const {
+    float scores[VP_MAX_ITEMS];
+    float raws[VP_MAX_ITEMS];
+    for (size_t metric_index = 0; metric_index < metrics_.size(); ++metric_index) {
+      raws[metric_index] = raw_values[metrics_[metric_index].id];
+      scores[metric_index] = normalize_score(raws[metric_index], metrics_[metric_index].threshold);
+    }
+    segment->push(scores, raws);
+  }
+
+  static void fill_item(const MetricDefinition& metric, float score, float raw,
+                        VpItemResult* out_item) {
+    out_item->id = metric.id;
+    std::snprintf(out_item->id_str, VP_METRIC_ID_MAX_LEN, "%s", metric_name(metric));
+    out_item->score = score;
+    out_item->raw = raw;
+  }
+
+  bool is_cancelled() const { return cancel_ && cancel_->load(std::memory_order_relaxed); }
+
+  // After a cancel the caller has moved on, so hand the working memory back
+  // right away instead of keeping it for the next call.
+  void release_working_memory() {
+    motion_.reset();
+    scratch_.trim(0);
+    std::vector<std::array<float, VP_MAX_ITEMS>>().swap(sample_raw_);
+    std::vector<int>().swap(sample_order_);
+    std::vector<double>().swap(sample_spans_);
+    std::vector<int>().swap(progressive_order_);
+    std::vector<uint8_t>().swap(progressive_seen_);
+  }
 
-    if (!has_previous) {
+  int finish_sequence(const SequenceState& state, VpAggregateResult* out_result) {
+    if (state.frame_count == 0) {
       return VP_ERR_DECODE;
     }
 
+    TraceScope aggregate_trace(tracer_.get(), "aggregate", "analyzer");
+    const int tile_count = grid_cols_ * grid_rows_;
+    if (tile_count > 0) {
+      grid_.cols = grid_cols_;
+      grid_.rows = grid_rows_;
+      grid_.frame_count = state.frame_count;
+      grid_.sharpness_frames = tile_totals_.sharpness_frames;
+      grid_.exposure_frames = tile_totals_.exposure_frames;
+      grid_.noise_frames = tile_totals_.noise_frames;
+      const TileTotals& totals = tile_totals_;
+      for (int tile = 0; tile < tile_count; ++tile) {
+        grid_.sharpness[tile] = tile_mean(totals.sharpness[tile], totals.sharpness_frames);
+        grid_.exposure[tile] = tile_mean(totals.exposure[tile], totals.exposure_frames);
+        grid_.noise[tile] = tile_mean(totals.noise[tile], totals.noise_frames);
+      }
+    }
+
+    if (histogram_frames_ > 0) {
+      summarize_histogram(histogram_totals_, clip_levels_, &exposure_);
+      exposure_.frame_count = histogram_frames_;
+    }
+
     int item_count = static_cast<int>(metrics_.size());
     out_result->item_count = item_count;
 
     for (int i = 0; i < item_count; ++i) {
       const MetricDefinition& metric = metrics_[i];
-      const MetricAggregate& agg = aggregates[i];
+      const MetricAggregate& agg = state.aggregates[i];
+
+      float mean_raw = agg.sum_raw / agg.total_weight;
+      float mean_score = agg.sum_score / agg.total_weight;
+
+      fill_item(metric, mean_score, mean_raw, &out_result->mean[i]);
+      fill_item(metric, agg.min_score, agg.raw_at_min, &out_result->worst[i]);
+    }
+
+    return VP_OK;
+  }
 
-      float mean_raw = agg.sum_raw / static_cast<float>(agg.count);
-      float mean_score = agg.sum_score / static_cast<float>(agg.count);
+  using Clock = std::chrono::steady_clock;
 
-      out_result->mean[i].id = static_cast<int32_t>(metric.id);
-      std::snprintf(out_result->mean[i].id_str, VP_METRIC_ID_MAX_LEN, "%s", metric_id_to_string(metric.id));
-      out_result->mean[i].raw = mean_raw;
-      out_result->mean[i].score = mean_score;
+  static double elapsed_ns(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::nano>(end - start).count();
+  }
 
-      out_result->worst[i].id = static_cast<int32_t>(metric.id);
-      std::snprintf(out_result->worst[i].id_str, VP_METRIC_ID_MAX_LEN, "%s", metric_id_to_string(metric.id));
-      out_result->worst[i].raw = agg.raw_at_min;
-      out_result->worst[i].score = agg.min_score;
+  // Power-of-two factor honouring max_short_side, then halved further while
+  // the cost model predicts fewer than kDeadlineMinFrames frames per budget.
+  int deadline_factor(const VpFrame& frame, const VpDeadline& deadline) const {
+    const int short_side = std::min(frame.width, frame.height);
+    int factor = 1;
+    if (deadline.max_short_side > 0) {
+      while (factor < kDeadlineMaxFactor && short_side / factor > deadline.max_short_side) {
+        factor *= 2;
+      }
+    }
+    if (deadline.auto_downscale != 0) {
+      const double frame_budget_ns = deadline.budget_ms * 1e6 / kDeadlineMinFrames;
+      while (factor < kDeadlineMaxFactor && short_side / (factor * 2) >= kDeadlineMinShortSide &&
+             ns_per_pixel_ * (frame.width / factor) * (frame.height / factor) > frame_budget_ns) {
+        factor *= 2;
+      }
     }
+    return factor;
+  }
 
+  // Box-downscales the luma of `frame` into `slot` as a GRAY8 frame.
+  int downscale_frame(const VpFrame& frame, int factor, ScratchSlot slot, VpFrame* out_frame) {
+    if (!is_valid_frame(frame)) {
+      return VP_ERR_UNSUPPORTED;
+    }
+    const int width = frame.width / factor;
+    const int height = frame.height / factor;
+    if (width <= 0 || height <= 0) {
+      return VP_ERR_UNSUPPORTED;
+    }
+    bool grew = false;
+    uint8_t* plane = scratch_.acquire(slot, static_cast<size_t>(width) * height, &grew);
+    if (!plane) {
+      return VP_ERR_ALLOC;
+    }
+    if (grew) {
+      stats_.add_allocation(VP_STAGE_METRICS);
+    }
+    downsample_luma_plane(frame, factor, plane, width, height);
+    *out_frame = VpFrame{width, height, width, VP_PIXEL_GRAY8, plane};
+    return VP_OK;
+  }
+
+  // Fetches the motion reference frame and copies its pixel rows into scratch,
+  // since the provider only keeps one frame alive at a time.
+  int fetch_motion_reference(VpFrameProvider provider, void* user_data, double time_sec, int index,
+                             VpFrame* out_frame) {
+    TraceScope reference_trace(tracer_.get(), "motion_reference", "analyzer", index);
+    VpFrame frame{};
+    int rc = provider(user_data, time_sec, &frame);
+    if (rc != VP_OK) {
+      return rc;
+    }
+    if (!is_valid_frame(frame)) {
+      return VP_ERR_UNSUPPORTED;
+    }
+    size_t row_bytes = static_cast<size_t>(frame.width) * bytes_per_pixel(frame.format);
+    size_t bytes = static_cast<size_t>(frame.stride_bytes) * (frame.height - 1) + row_bytes;
+    bool grew = false;
+    uint8_t* copy = scratch_.acquire(kScratchMotionReference, bytes, &grew);
+    if (!copy) {
+      return VP_ERR_ALLOC;
+    }
+    if (grew) {
+      stats_.add_allocation(VP_STAGE_METRICS);
+    }
+    std::memcpy(copy, frame.data, bytes);
+    *out_frame = frame;
+    out_frame->data = copy;
     return VP_OK;
   }
 
- private:
   VpConfig config_;
   std::vector<MetricDefinition> metrics_;
+  // Indices into metrics_ of the custom metrics in execution order.
+  std::vector<int> custom_order_;
+  // Metrics that read the previous frame and so are never reused on a
+  // near-duplicate frame.
+  uint32_t previous_frame_metrics_ = metric_bit(VP_METRIC_MOTION_BLUR);
+  FramePipeline pipelines_[kPixelFormatCount] = {};
+  FrameHashFn hashers_[kPixelFormatCount] = {};
+  int grid_cols_ = 0;
+  int grid_rows_ = 0;
+  TileFrameSums tile_sums_;
+  TileTotals tile_totals_;
+  VpTileGrid grid_{};
+  ClipLevels clip_levels_;
+  LumaHistogram frame_histogram_{};
+  uint64_t histogram_totals_[kHistogramBins] = {};
+  int histogram_frames_ = 0;
+  VpExposureStats exposure_{};
+  VpVideoSignature signature_{};
+  bool has_signature_ = false;
+  ScratchArena scratch_;
+  MotionEstimator motion_{&scratch_};
+  AdaptiveSampler sampler_;
+  std::vector<std::array<float, VP_MAX_ITEMS>> sample_raw_;
+  std::vector<int> sample_order_;
+  std::vector<double> sample_spans_;
+  std::vector<int> progressive_order_;
+  std::vector<uint8_t> progressive_seen_;
+  SegmentFinder segment_;
+  // Measured scoring cost in ns per (downscaled) pixel; seeds deadline mode.
+  double ns_per_pixel_ = kDeadlineInitialNsPerPixel;
+  Stats stats_;
+  std::unique_ptr<Tracer> tracer_;
+  std::string trace_path_;
+  const std::atomic<bool>* cancel_ = nullptr;
+  std::atomic<bool> busy_{false};
 };
 
 } // namespace vp
@@ -239,6 +925,85 @@ struct VpAnalyzer {
   vp::AnalyzerImpl* impl;
 };
 
+struct VpCancelToken {
+  std::atomic<bool> cancelled{false};
+};
+
+struct VpAnalysisTask {
+  VpAnalyzer* analyzer = nullptr;
+  std::vector<VpFrame> frames;
+  std::vector<VpFrameMetrics> frame_metrics;
+  VpCancelToken own_token;
+  VpCancelToken* token = nullptr;
+  VpProgressCallback progress = nullptr;
+  VpCompletionCallback completion = nullptr;
+  void* user_data = nullptr;
+  int32_t frames_total = 0;
+  std::atomic<int32_t> frames_done{0};
+  std::atomic<bool> finished{false};
+  int status = VP_OK;
+  VpAggregateResult result{};
+  std::thread thread;
+  // Set for vp_scheduler_submit tasks, which run on a scheduler worker;
+  // vp_task_wait then waits on `done` instead of joining.
+  vp::Scheduler* scheduler = nullptr;
+  vp::ScheduledJob job;
+  std::mutex done_mutex;
+  std::condition_variable done;
+
+  void run() {
+    vp::AnalyzeControl control;
+    control.cancel = &token->cancelled;
+    control.frames_done = &frames_done;
+    control.progress = progress;
+    control.user_data = user_data;
+    if (scheduler) {
+      control.scheduler = scheduler;
+      control.job = &job;
+    }
+    status = analyzer->impl->analyze(frames.data(), static_cast<int>(frames.size()),
+                                     frame_metrics.empty() ? nullptr : frame_metrics.data(),
+                                     static_cast<int>(frame_metrics.size()), nullptr, 0, &result,
+                                     control);
+    analyzer->impl->release();
+    if (scheduler) {
+      scheduler->finish(&job);
+    }
+    if (completion) {
+      completion(user_data, status, status == VP_OK ? &result : nullptr);
+    }
+    // Notified under the lock: a waiter may free the task once it sees
+    // `finished`.
+    std::lock_guard<std::mutex> lock(done_mutex);
+    finished.store(true, std::memory_order_release);
+    done.notify_all();
+  }
+
+  static void run_scheduled(void* owner) {
+    static_cast<VpAnalysisTask*>(owner)->run();
+  }
+};
+
+struct VpScheduler {
+  vp::Scheduler* impl;
+};
+
+namespace vp {
+
+Stats* analyzer_stats(VpAnalyzer* analyzer) {
+  return analyzer && analyzer->impl ? &analyzer->impl->stats() : nullptr;
+}
+
+Tracer* analyzer_tracer(VpAnalyzer* analyzer) {
+  return analyzer && analyzer->impl ? analyzer->impl->tracer() : nullptr;
+}
+
+} // namespace vp
+
+static bool is_available(const VpAnalyzer* analyzer) {
+  return analyzer && analyzer->impl && !analyzer->impl->busy();
+}
+
 extern "C" {
 void vp_default_config(VpConfig* config) {
   if (!config) {
@@ -248,12 +1013,21 @@ void vp_default_config(VpConfig* config) {
   config->fps = 5.0f;
   config->normalize = {360, 0};
   config->log_frame_details = 0;
+  config->enable_trace = 0;
+  config->grid_cols = 0;
+  config->grid_rows = 0;
+  config->near_duplicate_distance = 0;
+  config->exposure_clip_low = 5;
+  config->exposure_clip_high = 250;
+  config->tuning_profile = nullptr;
+  config->autotune = 0;
   for (int i = 0; i < VP_MAX_ITEMS; ++i) {
     config->thresholds[i] = {0.0f, 0.0f};
   }
   config->thresholds[VP_METRIC_SHARPNESS] = {20.0f, 2.0f};
   config->thresholds[VP_METRIC_EXPOSURE] = {0.002f, 0.02f};
-  config->thresholds[VP_METRIC_MOTION_BLUR] = {0.2f, 1.5f};
+  // Gradient anisotropy along the motion: ~0.05 at 2 px of blur, ~0.5 at 16 px.
+  config->thresholds[VP_METRIC_MOTION_BLUR] = {0.05f, 0.5f};
   config->thresholds[VP_METRIC_NOISE] = {0.001f, 0.01f};
   config->thresholds[VP_METRIC_PERSON_BLUR] = {20.0f, 2.0f};
 }
@@ -274,21 +1048,368 @@ VpAnalyzer* vp_create(const VpConfig* config) {
   return analyzer;
 }
 
+int vp_autotune(const char* profile_path, int32_t width, int32_t height) {
+  if (width < 0 || height < 0 || (width == 0) != (height == 0)) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  if (width == 0) {
+    width = vp::kCalibrationWidth;
+    height = vp::kCalibrationHeight;
+  }
+  const vp::TuningProfile profile = vp::calibrate_pipelines(width, height);
+  vp::set_process_tuning_profile(profile);
+  if (profile_path && !vp::save_tuning_profile(profile_path, vp::cpu_profile_key(), profile)) {
+    return VP_ERR_IO;
+  }
+  return VP_OK;
+}
+
+int vp_register_metric(VpAnalyzer* analyzer, const VpCustomMetric* metric) {
+  if (!is_available(analyzer) || !metric) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  return analyzer->impl->register_metric(*metric);
+}
+
 int vp_analyze_frames(VpAnalyzer* analyzer, const VpFrame* frames, int frame_count,
                       VpAggregateResult* out_result) {
-  if (!analyzer || !analyzer->impl) {
+  if (!is_available(analyzer)) {
     return VP_ERR_INVALID_ARGUMENT;
   }
-  return analyzer->impl->analyze(frames, frame_count, nullptr, 0, out_result);
+  return analyzer->impl->analyze(frames, frame_count, nullptr, 0, nullptr, 0, out_result);
 }
 
 int vp_analyze_frames_with_metrics(VpAnalyzer* analyzer, const VpFrame* frames, int frame_count,
                                    const VpFrameMetrics* frame_metrics, int frame_metrics_count,
                                    VpAggregateResult* out_result) {
+  if (!is_available(analyzer)) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  return analyzer->impl->analyze(frames, frame_count, frame_metrics, frame_metrics_count, nullptr, 0,
+                                 out_result);
+}
+
+int vp_analyze_frames_ex(VpAnalyzer* analyzer, const VpFrame* frames, int frame_count,
+                         const VpFrameExtras* extras, int extras_count,
+                         VpAggregateResult* out_result) {
+  if (!is_available(analyzer)) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  return analyzer->impl->analyze(frames, frame_count, nullptr, 0, extras, extras_count, out_result);
+}
+
+void vp_default_adaptive_sampling(VpAdaptiveSampling* sampling) {
+  if (!sampling) {
+    return;
+  }
+  sampling->start_sec = 0.0;
+  sampling->end_sec = 0.0;
+  sampling->initial_samples = 9;
+  sampling->frame_budget = 0;
+  sampling->min_interval_sec = 1.0 / 30.0;
+  sampling->motion_offset_sec = 0.2;
+}
+
+int vp_analyze_adaptive(VpAnalyzer* analyzer, const VpAdaptiveSampling* sampling,
+                        VpFrameProvider provider, void* user_data,
+                        VpAggregateResult* out_result, double* out_times,
+                        int out_times_capacity, int* out_sample_count) {
+  if (!is_available(analyzer) || !sampling) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  return analyzer->impl->analyze_adaptive(*sampling, provider, user_data, out_result, out_times,
+                                          out_times_capacity, out_sample_count);
+}
+
+void vp_default_deadline(VpDeadline* deadline) {
+  if (!deadline) {
+    return;
+  }
+  deadline->budget_ms = 50.0;
+  deadline->max_short_side = 360;
+  deadline->auto_downscale = 1;
+}
+
+int vp_analyze_frames_deadline(VpAnalyzer* analyzer, const VpFrame* frames, int frame_count,
+                               const VpDeadline* deadline, VpAggregateResult* out_result,
+                               VpDeadlineReport* out_report) {
+  if (!is_available(analyzer) || !deadline) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  return analyzer->impl->analyze_deadline(frames, frame_count, *deadline, out_result, out_report);
+}
+
+void vp_default_segment_query(VpSegmentQuery* query) {
+  if (!query) {
+    return;
+  }
+  query->window_frames = 0;
+  query->window_sec = 3.0f;
+  for (int i = 0; i < VP_MAX_ITEMS; ++i) {
+    query->weights[i] = 1.0f;
+  }
+}
+
+int vp_analyze_best_segment(VpAnalyzer* analyzer, const VpFrame* frames, int frame_count,
+                            const VpSegmentQuery* query, VpSegmentResult* out_segment,
+                            VpAggregateResult* out_result) {
+  if (!is_available(analyzer) || !query) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  return analyzer->impl->analyze_best_segment(frames, frame_count, *query, out_segment,
+                                              out_result);
+}
+
+VpCancelToken* vp_cancel_token_create(void) {
+  return new (std::nothrow) VpCancelToken();
+}
+
+void vp_cancel_token_cancel(VpCancelToken* token) {
+  if (token) {
+    token->cancelled.store(true, std::memory_order_relaxed);
+  }
+}
+
+int vp_cancel_token_is_cancelled(const VpCancelToken* token) {
+  return token && token->cancelled.load(std::memory_order_relaxed) ? 1 : 0;
+}
+
+void vp_cancel_token_destroy(VpCancelToken* token) {
+  delete token;
+}
+
+// Validates the arguments shared by the async entry points and copies them
+// into a new task; the analyzer is not acquired yet.
+static int make_task(VpAnalyzer* analyzer, const VpFrame* frames, int frame_count,
+                     const VpFrameMetrics* frame_metrics, int frame_metrics_count,
+                     VpCancelToken* cancel, VpProgressCallback progress,
+                     VpCompletionCallback completion, void* user_data, VpAnalysisTask** out_task,
+                     std::unique_ptr<VpAnalysisTask>* out) {
+  if (!analyzer || !analyzer->impl || !frames || frame_count <= 0 || !out_task ||
+      (frame_metrics && frame_metrics_count != frame_count) ||
+      (!frame_metrics && frame_metrics_count != 0)) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  std::unique_ptr<VpAnalysisTask> task(new (std::nothrow) VpAnalysisTask());
+  if (!task) {
+    return VP_ERR_ALLOC;
+  }
+  try {
+    task->frames.assign(frames, frames + frame_count);
+    if (frame_metrics) {
+      task->frame_metrics.assign(frame_metrics, frame_metrics + frame_metrics_count);
+    }
+  } catch (const std::bad_alloc&) {
+    return VP_ERR_ALLOC;
+  }
+  task->analyzer = analyzer;
+  task->token = cancel ? cancel : &task->own_token;
+  task->progress = progress;
+  task->completion = completion;
+  task->user_data = user_data;
+  task->frames_total = analyzer->impl->frame_limit(frame_count);
+  *out = std::move(task);
+  return VP_OK;
+}
+
+int vp_analyze_frames_async(VpAnalyzer* analyzer, const VpFrame* frames, int frame_count,
+                            const VpFrameMetrics* frame_metrics, int frame_metrics_count,
+                            VpCancelToken* cancel, VpProgressCallback progress,
+                            VpCompletionCallback completion, void* user_data,
+                            VpAnalysisTask** out_task) {
+  std::unique_ptr<VpAnalysisTask> task;
+  int rc = make_task(analyzer, frames, frame_count, frame_metrics, frame_metrics_count, cancel,
+                     progress, completion, user_data, out_task, &task);
+  if (rc != VP_OK) {
+    return rc;
+  }
+  if (!analyzer->impl->try_acquire()) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  try {
+    task->thread = std::thread(&VpAnalysisTask::run, task.get());
+  } catch (const std::system_error&) {
+    analyzer->impl->release();
+    return VP_ERR_ALLOC;
+  }
+  *out_task = task.release();
+  return VP_OK;
+}
+
+int vp_task_poll(const VpAnalysisTask* task, VpTaskProgress* out_progress) {
+  if (!task || !out_progress) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  bool finished = task->finished.load(std::memory_order_acquire);
+  out_progress->frames_done = task->frames_done.load(std::memory_order_relaxed);
+  out_progress->frames_total = task->frames_total;
+  out_progress->finished = finished ? 1 : 0;
+  out_progress->status = finished ? task->status : VP_OK;
+  return VP_OK;
+}
+
+void vp_task_cancel(VpAnalysisTask* task) {
+  if (task) {
+    vp_cancel_token_cancel(task->token);
+    if (task->scheduler) {
+      task->scheduler->wake();
+    }
+  }
+}
+
+int vp_task_wait(VpAnalysisTask* task, VpAggregateResult* out_result) {
+  if (!task || task->thread.get_id() == std::this_thread::get_id()) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  if (task->thread.joinable()) {
+    task->thread.join();
+  } else if (task->scheduler) {
+    std::unique_lock<std::mutex> lock(task->done_mutex);
+    task->done.wait(lock, [task] { return task->finished.load(std::memory_order_acquire); });
+  }
+  if (task->status == VP_OK && out_result) {
+    *out_result = task->result;
+  }
+  return task->status;
+}
+
+void vp_task_destroy(VpAnalysisTask* task) {
+  if (!task) {
+    return;
+  }
+  if (!task->finished.load(std::memory_order_acquire)) {
+    vp_task_cancel(task);
+  }
+  vp_task_wait(task, nullptr);
+  delete task;
+}
+
+void vp_default_scheduler_config(VpSchedulerConfig* config) {
+  if (!config) {
+    return;
+  }
+  config->max_running = 0;
+  config->background_share = 0.5f;
+  config->aging_ms = 2000;
+}
+
+VpScheduler* vp_scheduler_create(const VpSchedulerConfig* config) {
+  VpSchedulerConfig defaults;
+  vp_default_scheduler_config(&defaults);
+  std::unique_ptr<VpScheduler> scheduler(new (std::nothrow) VpScheduler());
+  if (!scheduler) {
+    return nullptr;
+  }
+  scheduler->impl = new (std::nothrow) vp::Scheduler(config ? *config : defaults);
+  if (!scheduler->impl) {
+    return nullptr;
+  }
+  if (!scheduler->impl->start()) {
+    delete scheduler->impl;
+    return nullptr;
+  }
+  return scheduler.release();
+}
+
+int vp_scheduler_submit(VpScheduler* scheduler, VpPriority priority, VpAnalyzer* analyzer,
+                        const VpFrame* frames, int frame_count,
+                        const VpFrameMetrics* frame_metrics, int frame_metrics_count,
+                        VpCancelToken* cancel, VpProgressCallback progress,
+                        VpCompletionCallback completion, void* user_data,
+                        VpAnalysisTask** out_task) {
+  if (!scheduler || !scheduler->impl ||
+      (priority != VP_PRIORITY_INTERACTIVE && priority != VP_PRIORITY_BACKGROUND)) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  std::unique_ptr<VpAnalysisTask> task;
+  int rc = make_task(analyzer, frames, frame_count, frame_metrics, frame_metrics_count, cancel,
+                     progress, completion, user_data, out_task, &task);
+  if (rc != VP_OK) {
+    return rc;
+  }
+  if (!analyzer->impl->try_acquire()) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  task->scheduler = scheduler->impl;
+  task->job.priority = priority;
+  task->job.cancel = &task->token->cancelled;
+  task->job.run = &VpAnalysisTask::run_scheduled;
+  task->job.owner = task.get();
+  *out_task = task.release();
+  scheduler->impl->submit(&(*out_task)->job);
+  return VP_OK;
+}
+
+void vp_scheduler_destroy(VpScheduler* scheduler) {
+  if (!scheduler) {
+    return;
+  }
+  delete scheduler->impl;
+  delete scheduler;
+}
+
+int vp_get_tile_grid(const VpAnalyzer* analyzer, VpTileGrid* out_grid) {
+  if (!analyzer || !analyzer->impl || !out_grid) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  return analyzer->impl->get_tile_grid(out_grid);
+}
+
+int vp_get_video_signature(const VpAnalyzer* analyzer, VpVideoSignature* out_signature) {
+  if (!analyzer || !analyzer->impl || !out_signature) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  return analyzer->impl->get_video_signature(out_signature);
+}
+
+int vp_get_exposure_stats(const VpAnalyzer* analyzer, VpExposureStats* out_stats) {
+  if (!analyzer || !analyzer->impl || !out_stats) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  return analyzer->impl->get_exposure_stats(out_stats);
+}
+
+int vp_get_stats(const VpAnalyzer* analyzer, VpStats* out_stats) {
+  if (!analyzer || !analyzer->impl || !out_stats) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  if (!vp::Stats::kEnabled) {
+    return VP_ERR_UNSUPPORTED;
+  }
+  analyzer->impl->stats().snapshot(out_stats);
+  analyzer->impl->name_custom_metric_stats(out_stats);
+  out_stats->scratch_bytes = static_cast<uint64_t>(analyzer->impl->scratch().capacity_bytes());
+  return VP_OK;
+}
+
+int vp_reset_stats(VpAnalyzer* analyzer) {
   if (!analyzer || !analyzer->impl) {
     return VP_ERR_INVALID_ARGUMENT;
   }
-  return analyzer->impl->analyze(frames, frame_count, frame_metrics, frame_metrics_count, out_result);
+  if (!vp::Stats::kEnabled) {
+    return VP_ERR_UNSUPPORTED;
+  }
+  analyzer->impl->stats().reset();
+  return VP_OK;
+}
+
+int vp_trim_scratch(VpAnalyzer* analyzer, uint64_t keep_bytes) {
+  if (!is_available(analyzer)) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  analyzer->impl->scratch().trim(static_cast<size_t>(keep_bytes));
+  return VP_OK;
+}
+
+int vp_write_trace(const VpAnalyzer* analyzer, const char* path) {
+  if (!analyzer || !analyzer->impl || !path) {
+    return VP_ERR_INVALID_ARGUMENT;
+  }
+  const vp::Tracer* tracer = analyzer->impl->tracer();
+  if (!tracer) {
+    return VP_ERR_UNSUPPORTED;
+  }
+  return tracer->write_chrome_json(path) ? VP_OK : VP_ERR_IO;
 }
 
 void vp_destroy(VpAnalyzer* analyzer) {
@@ -0,0 +1,61 @@
+#include "vp_histogram.h"
+
+namespace vp {
+
+namespace {
+
+// Smallest level whose cumulative count reaches `fraction` of the total.
+float percentile(const uint64_t* bins, uint64_t total, double fraction) {
+  double target = fraction * static_cast<double>(total);
+  uint64_t cumulative = 0;
+  for (int bin = 0; bin < kHistogramBins; ++bin) {
+    cumulative += bins[bin];
+    if (static_cast<double>(cumulative) >= target && cumulative > 0) {
+      return static_cast<float>(bin);
+    }
+  }
+  return static_cast<float>(kHistogramBins - 1);
+}
+
+} // namespace
+
+void summarize_histogram(const uint64_t* bins, const ClipLevels& levels, VpExposureStats* out) {
+  uint64_t total = 0;
+  uint64_t weighted = 0;
+  uint64_t low = 0;
+  uint64_t high = 0;
+  for (int bin = 0; bin < kHistogramBins; ++bin) {
+    total += bins[bin];
+    weighted += bins[bin] * static_cast<uint64_t>(bin);
+    if (bin <= levels.low) {
+      low += bins[bin];
+    } else if (bin >= levels.high) {
+      high += bins[bin];
+    }
+  }
+  for (int bin = 0; bin < kHistogramBins; ++bin) {
+    out->histogram[bin] = bins[bin];
+  }
+  out->clip_low = levels.low;
+  out->clip_high = levels.high;
+  if (total == 0) {
+    out->mean = 0.0f;
+    out->low_clip_ratio = 0.0f;
+    out->high_clip_ratio = 0.0f;
+    out->p5 = 0.0f;
+    out->p50 = 0.0f;
+    out->p95 = 0.0f;
+    out->dynamic_range = 0.0f;
+    return;
+  }
+  double inv_total = 1.0 / static_cast<double>(total);
+  out->mean = static_cast<float>(static_cast<double>(weighted) * inv_total);
+  out->low_clip_ratio = static_cast<float>(static_cast<double>(low) * inv_total);
+  out->high_clip_ratio = static_cast<float>(static_cast<double>(high) * inv_total);
+  out->p5 = percentile(bins, total, 0.05);
+  out->p50 = percentile(bins, total, 0.50);
+  out->p95 = percentile(bins, total, 0.95);
+  out->dynamic_range = out->p95 - out->p5;
+}
+
+} // namespace vp
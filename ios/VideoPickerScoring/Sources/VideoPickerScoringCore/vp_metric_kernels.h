@@ -0,0 +1,466 @@
+#ifndef VP_METRIC_KERNELS_H
+#define VP_METRIC_KERNELS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "vp_histogram.h"
+#include "vp_motion.h"
+#include "vp_pixel_access.h"
+#include "vp_tiles.h"
+
+namespace vp {
+
+// Metric kernels templated on an accessor policy (see vp_pixel_access.h).
+// Each instantiation is a single loop with the pixel read inlined; results
+// match the original GrayFrame implementations bit for bit, except motion blur,
+// which is now derived from block motion.
+
+template <class Access>
+inline int laplacian_at(const uint8_t* row_prev, const uint8_t* row, const uint8_t* row_next, int x) {
+  return -4 * Access::luma(row, x) + Access::luma(row, x - 1) + Access::luma(row, x + 1) +
+         Access::luma(row_prev, x) + Access::luma(row_next, x);
+}
+
+// Row-streaming form: each metric keeps its running sums in a small state
+// that is fed rows in increasing order, so several metrics can share one pass
+// over rows that are still in cache (see the banded pipeline). Per-row sums
+// are kept in locals and folded into the state once per row; the order of
+// additions is the same as a single whole-frame loop.
+
+struct SharpnessSums {
+  double sum = 0.0;
+  double sum_sq = 0.0;
+  int64_t count = 0;
+  int tile_row = 0;
+};
+
+// Adds the Laplacians of row y (1 <= y < height - 1), reading rows y - 1 to
+// y + 1. With `tiles`, the row is walked as per-tile segments and the segment
+// sums are added to both the tile and the frame totals. The sums are exact
+// integers in double precision, so the frame value is unchanged.
+template <class Access>
+inline void sharpness_row(const Access& frame, int y, TileFrameSums* tiles, SharpnessSums* sums) {
+  const int width = frame.width();
+  const uint8_t* row = frame.row(y);
+  const uint8_t* row_prev = frame.row(y - 1);
+  const uint8_t* row_next = frame.row(y + 1);
+  double sum = sums->sum;
+  double sum_sq = sums->sum_sq;
+  int64_t count = sums->count;
+
+  if (!tiles) {
+    for (int x = 1; x < width - 1; ++x) {
+      double value = static_cast<double>(laplacian_at<Access>(row_prev, row, row_next, x));
+      sum += value;
+      sum_sq += value * value;
+    }
+    count += width > 2 ? width - 2 : 0;
+  } else {
+    sums->tile_row = tiles->advance_row(sums->tile_row, y);
+    for (int tile_col = 0; tile_col < tiles->cols; ++tile_col) {
+      int x0 = std::max(tiles->col_begin[tile_col], 1);
+      int x1 = std::min(tiles->col_begin[tile_col + 1], width - 1);
+      if (x0 >= x1) {
+        continue;
+      }
+      double segment_sum = 0.0;
+      double segment_sum_sq = 0.0;
+      for (int x = x0; x < x1; ++x) {
+        double value = static_cast<double>(laplacian_at<Access>(row_prev, row, row_next, x));
+        segment_sum += value;
+        segment_sum_sq += value * value;
+      }
+      int tile = sums->tile_row * tiles->cols + tile_col;
+      tiles->sharp_sum[tile] += segment_sum;
+      tiles->sharp_sum_sq[tile] += segment_sum_sq;
+      tiles->sharp_count[tile] += x1 - x0;
+      sum += segment_sum;
+      sum_sq += segment_sum_sq;
+      count += x1 - x0;
+    }
+  }
+
+  sums->sum = sum;
+  sums->sum_sq = sum_sq;
+  sums->count = count;
+}
+
+inline float sharpness_value(const SharpnessSums& sums) {
+  if (sums.count == 0) {
+    return 0.0f;
+  }
+  double mean = sums.sum / static_cast<double>(sums.count);
+  double variance = (sums.sum_sq / static_cast<double>(sums.count)) - (mean * mean);
+  if (variance < 0.0) {
+    variance = 0.0;
+  }
+  return static_cast<float>(variance);
+}
+
+template <class Access>
+float sharpness_kernel(const Access& frame, TileFrameSums* tiles = nullptr) {
+  SharpnessSums sums;
+  for (int y = 1; y < frame.height() - 1; ++y) {
+    sharpness_row(frame, y, tiles, &sums);
+  }
+  return sharpness_value(sums);
+}
+
+// Clipped share of the frame, counted from a banked luma histogram built in
+// the same pass.
+struct ExposureCounts {
+  ExposureCounts(const ClipLevels& clip_levels, const TileFrameSums* tiles) : levels(clip_levels) {
+    if (tiles) {
+      for (int value = 0; value < kHistogramBins; ++value) {
+        clip_lut[value] = (value <= levels.low || value >= levels.high) ? 1 : 0;
+      }
+    }
+  }
+
+  ClipLevels levels;
+  HistogramBanks banks;
+  uint8_t clip_lut[kHistogramBins] = {};
+  int tile_row = 0;
+};
+
+template <class Access>
+inline void exposure_row(const Access& frame, int y, TileFrameSums* tiles, ExposureCounts* counts) {
+  const uint8_t* row = frame.row(y);
+  if (!tiles) {
+    counts->banks.add_row<Access>(row, 0, frame.width());
+    return;
+  }
+  counts->tile_row = tiles->advance_row(counts->tile_row, y);
+  for (int tile_col = 0; tile_col < tiles->cols; ++tile_col) {
+    int x0 = tiles->col_begin[tile_col];
+    int x1 = tiles->col_begin[tile_col + 1];
+    int tile = counts->tile_row * tiles->cols + tile_col;
+    tiles->clipped[tile] += counts->banks.add_row_counting<Access>(row, x0, x1, counts->clip_lut);
+    tiles->exposure_count[tile] += x1 - x0;
+  }
+}
+
+// `histogram` (optional) receives the merged bins.
+inline float exposure_value(const ExposureCounts& counts, int total, LumaHistogram* histogram) {
+  if (histogram) {
+    counts.banks.merge_into(histogram);
+  }
+  if (total == 0) {
+    return 0.0f;
+  }
+  int clipped = static_cast<int>(counts.banks.count_range(0, counts.levels.low) +
+                                 counts.banks.count_range(counts.levels.high, kHistogramBins - 1));
+  return static_cast<float>(clipped) / static_cast<float>(total);
+}
+
+template <class Access>
+float exposure_kernel(const Access& frame, const ClipLevels& levels, LumaHistogram* histogram,
+                      TileFrameSums* tiles = nullptr) {
+  ExposureCounts counts(levels, tiles);
+  for (int y = 0; y < frame.height(); ++y) {
+    exposure_row(frame, y, tiles, &counts);
+  }
+  return exposure_value(counts, frame.width() * frame.height(), histogram);
+}
+
+// Absolute difference between a pixel and the mean of its clamped 3x3
+// neighbourhood. Interior pixels skip the clamping.
+template <class Access>
+inline float noise_at(const uint8_t* const rows[3], int x, int width) {
+  int sum = 0;
+  if (x > 0 && x < width - 1) {
+    for (int r = 0; r < 3; ++r) {
+      sum += Access::luma(rows[r], x - 1) + Access::luma(rows[r], x) + Access::luma(rows[r], x + 1);
+    }
+  } else {
+    int left = std::max(x - 1, 0);
+    int right = std::min(x + 1, width - 1);
+    for (int r = 0; r < 3; ++r) {
+      sum += Access::luma(rows[r], left) + Access::luma(rows[r], x) + Access::luma(rows[r], right);
+    }
+  }
+  float mean = static_cast<float>(sum) / 9.0f;
+  return std::abs(static_cast<float>(Access::luma(rows[1], x)) - mean);
+}
+
+struct NoiseSums {
+  double accum = 0.0;
+  int64_t count = 0;
+  int tile_row = 0;
+};
+
+// Adds row y, reading rows y - 1 to y + 1 clamped to the frame. With
+// `tiles`, per-segment partial sums change the floating-point summation
+// order, so the frame value may differ from the untiled one in the last bits.
+template <class Access>
+inline void noise_row(const Access& frame, int y, TileFrameSums* tiles, NoiseSums* sums) {
+  const int width = frame.width();
+  const int height = frame.height();
+  const uint8_t* rows[3] = {frame.row(std::max(y - 1, 0)), frame.row(y),
+                            frame.row(std::min(y + 1, height - 1))};
+  double accum = sums->accum;
+  if (!tiles) {
+    for (int x = 0; x < width; ++x) {
+      accum += noise_at<Access>(rows, x, width);
+    }
+    sums->accum = accum;
+    sums->count += width;
+    return;
+  }
+  sums->tile_row = tiles->advance_row(sums->tile_row, y);
+  for (int tile_col = 0; tile_col < tiles->cols; ++tile_col) {
+    int x0 = tiles->col_begin[tile_col];
+    int x1 = tiles->col_begin[tile_col + 1];
+    double segment_accum = 0.0;
+    for (int x = x0; x < x1; ++x) {
+      segment_accum += noise_at<Access>(rows, x, width);
+    }
+    int tile = sums->tile_row * tiles->cols + tile_col;
+    tiles->noise_sum[tile] += segment_accum;
+    tiles->noise_count[tile] += x1 - x0;
+    accum += segment_accum;
+    sums->count += x1 - x0;
+  }
+  sums->accum = accum;
+}
+
+inline float noise_value(const NoiseSums& sums) {
+  if (sums.count == 0) {
+    return 0.0f;
+  }
+  return static_cast<float>(sums.accum / static_cast<double>(sums.count)) / 255.0f;
+}
+
+template <class Access>
+float noise_kernel(const Access& frame, TileFrameSums* tiles = nullptr) {
+  NoiseSums sums;
+  for (int y = 0; y < frame.height(); ++y) {
+    noise_row(frame, y, tiles, &sums);
+  }
+  return noise_value(sums);
+}
+
+// Laplacian variance restricted to the person region described by `extras`:
+// the union of the boxes (clipped to the 3x3 stencil interior) and/or the
+// nearest-neighbour upscaled mask, whose values weight each pixel. Rows
+// 1 <= y < height - 1 are fed in increasing order after begin().
+class PersonSharpness {
+ public:
+  // Returns false when the region is empty, so the caller can fall back.
+  bool begin(int width, int height, const VpFrameExtras& extras) {
+    if (width < 3 || height < 3) {
+      return false;
+    }
+    width_ = width;
+    height_ = height;
+    box_count_ = 0;
+    if (extras.box_count > 0) {
+      for (int i = 0; i < extras.box_count && i < VP_MAX_PERSON_BOXES; ++i) {
+        const VpRect& rect = extras.boxes[i];
+        Span span{std::max(rect.x, 1), std::min(rect.x + rect.width, width - 1),
+                  std::max(rect.y, 1), std::min(rect.y + rect.height, height - 1)};
+        if (span.x0 < span.x1 && span.y0 < span.y1) {
+          boxes_[box_count_++] = span;
+        }
+      }
+      if (box_count_ == 0) {
+        return false;
+      }
+    } else {
+      boxes_[box_count_++] = Span{1, width - 1, 1, height - 1};
+    }
+    std::sort(boxes_, boxes_ + box_count_,
+              [](const Span& a, const Span& b) { return a.x0 < b.x0; });
+    mask_ = extras.mask;
+    mask_width_ = extras.mask_width;
+    mask_height_ = extras.mask_height;
+    mask_stride_ = extras.mask_stride;
+    sum_ = 0.0;
+    sum_sq_ = 0.0;
+    weight_sum_ = 0.0;
+    return true;
+  }
+
+  template <class Access>
+  void add_row(const Access& frame, int y) {
+    const int width = width_;
+    const uint8_t* row = frame.row(y);
+    const uint8_t* row_prev = frame.row(y - 1);
+    const uint8_t* row_next = frame.row(y + 1);
+    const uint8_t* mask_row =
+        mask_ ? mask_ + static_cast<ptrdiff_t>(y * mask_height_ / height_) * mask_stride_ : nullptr;
+    double sum = sum_;
+    double sum_sq = sum_sq_;
+    double weight_sum = weight_sum_;
+
+    // Boxes are sorted by x0, so covering spans for this row merge in one sweep.
+    int run_end = 1;
+    for (int b = 0; b < box_count_; ++b) {
+      const Span& box = boxes_[b];
+      if (y < box.y0 || y >= box.y1 || box.x1 <= run_end) {
+        continue;
+      }
+      int x0 = std::max(box.x0, run_end);
+      int x1 = box.x1;
+      run_end = x1;
+      if (!mask_row) {
+        for (int x = x0; x < x1; ++x) {
+          double value = static_cast<double>(laplacian_at<Access>(row_prev, row, row_next, x));
+          sum += value;
+          sum_sq += value * value;
+        }
+        weight_sum += static_cast<double>(x1 - x0);
+        continue;
+      }
+      // Step the mask column with an integer remainder instead of dividing per pixel.
+      int mask_x = static_cast<int>(static_cast<int64_t>(x0) * mask_width_ / width);
+      int remainder = static_cast<int>(static_cast<int64_t>(x0) * mask_width_ % width);
+      for (int x = x0; x < x1; ++x) {
+        int weight = mask_row[mask_x];
+        if (weight != 0) {
+          double value = static_cast<double>(laplacian_at<Access>(row_prev, row, row_next, x));
+          double w = static_cast<double>(weight);
+          sum += w * value;
+          sum_sq += w * value * value;
+          weight_sum += w;
+        }
+        remainder += mask_width_;
+        while (remainder >= width) {
+          remainder -= width;
+          ++mask_x;
+        }
+      }
+    }
+
+    sum_ = sum;
+    sum_sq_ = sum_sq;
+    weight_sum_ = weight_sum;
+  }
+
+  // False when no pixel of the region had a non-zero weight.
+  bool result(float* out_raw) const {
+    if (weight_sum_ <= 0.0) {
+      return false;
+    }
+    double mean = sum_ / weight_sum_;
+    double variance = (sum_sq_ / weight_sum_) - (mean * mean);
+    if (variance < 0.0) {
+      variance = 0.0;
+    }
+    *out_raw = static_cast<float>(variance);
+    return true;
+  }
+
+ private:
+  struct Span {
+    int x0;
+    int x1;
+    int y0;
+    int y1;
+  };
+
+  Span boxes_[VP_MAX_PERSON_BOXES];
+  int box_count_ = 0;
+  int width_ = 0;
+  int height_ = 0;
+  const uint8_t* mask_ = nullptr;
+  int mask_width_ = 0;
+  int mask_height_ = 0;
+  int mask_stride_ = 0;
+  double sum_ = 0.0;
+  double sum_sq_ = 0.0;
+  double weight_sum_ = 0.0;
+};
+
+template <class Access>
+bool person_sharpness_kernel(const Access& frame, const VpFrameExtras& extras, float* out_raw) {
+  PersonSharpness person;
+  if (!person.begin(frame.width(), frame.height(), extras)) {
+    return false;
+  }
+  for (int y = 1; y < frame.height() - 1; ++y) {
+    person.add_row(frame, y);
+  }
+  return person.result(out_raw);
+}
+
+// Motion blur from a block motion field: within each block, blur along the
+// block's motion weakens the luma gradient parallel to the motion relative to
+// the perpendicular one. The result is that gradient anisotropy (ratio minus
+// one, capped by the motion length in pixels), weighted by gradient energy. It
+// grows with the blur length but saturates: about 0.05 for 2 px of blur, 0.3
+// for 8 px and 0.4 to 0.6 from 16 px on. A sharp pan and a static out-of-focus frame
+// both score near zero.
+// Gradients are taken at full resolution on every (2 * factor)-th row, with the
+// motion direction in 8-bit fixed point so the inner loop stays integer.
+template <class Access>
+float motion_blur_kernel(const Access& frame, const MotionField& field) {
+  const int width = frame.width();
+  const int height = frame.height();
+  const int factor = field.factor;
+  const int block_extent = kMotionBlockSize * factor;
+  const int row_step = 2 * factor;
+
+  double weighted_blur = 0.0;
+  double weight_sum = 0.0;
+  for (int by = 0; by < field.block_rows; ++by) {
+    const int y_begin = std::max(1, by * block_extent + factor / 2);
+    const int y_end = std::min(height - 1, (by + 1) * block_extent);
+    for (int bx = 0; bx < field.block_cols; ++bx) {
+      const MotionVector& vector = field.vectors[by * field.block_cols + bx];
+      const int x_begin = std::max(1, bx * block_extent);
+      const int x_end = std::min(width - 1, (bx + 1) * block_extent);
+      const float motion =
+          std::sqrt(static_cast<float>(vector.dx * vector.dx + vector.dy * vector.dy)) *
+          static_cast<float>(factor);
+      int dir_x = 0;
+      int dir_y = 0;
+      if (motion > 0.0f) {
+        dir_x = static_cast<int>(std::lround(256.0f * vector.dx * factor / motion));
+        dir_y = static_cast<int>(std::lround(256.0f * vector.dy * factor / motion));
+      }
+
+      int64_t energy = 0;
+      int64_t parallel = 0;
+      int64_t perpendicular = 0;
+      for (int y = y_begin; y < y_end; y += row_step) {
+        const uint8_t* row = frame.row(y);
+        const uint8_t* row_prev = frame.row(y - 1);
+        const uint8_t* row_next = frame.row(y + 1);
+        int32_t row_energy = 0;
+        int32_t row_parallel = 0;
+        int32_t row_perpendicular = 0;
+        for (int x = x_begin; x < x_end; ++x) {
+          const int gx = Access::luma(row, x + 1) - Access::luma(row, x - 1);
+          const int gy = Access::luma(row_next, x) - Access::luma(row_prev, x);
+          row_energy += std::abs(gx) + std::abs(gy);
+          row_parallel += std::abs(gx * dir_x + gy * dir_y);
+          row_perpendicular += std::abs(gy * dir_x - gx * dir_y);
+        }
+        energy += row_energy;
+        parallel += row_parallel;
+        perpendicular += row_perpendicular;
+      }
+      weight_sum += static_cast<double>(energy);
+      if (motion > 0.0f && parallel > 0) {
+        float blur = static_cast<float>(static_cast<double>(perpendicular) /
+                                        static_cast<double>(parallel)) - 1.0f;
+        blur = std::min(std::max(blur, 0.0f), motion);
+        weighted_blur += static_cast<double>(energy) * static_cast<double>(blur);
+      } else if (motion > 0.0f && perpendicular > 0) {
+        weighted_blur += static_cast<double>(energy) * static_cast<double>(motion);
+      }
+    }
+  }
+
+  if (weight_sum <= 0.0) {
+    return 0.0f;
+  }
+  return static_cast<float>(weighted_blur / weight_sum);
+}
+
+} // namespace vp
+
+#endif // VP_METRIC_KERNELS_H
@@ -0,0 +1,225 @@
+#include "vp_motion.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "vp_pixel_access.h"
+#include "vp_simd.h"
+
+namespace vp {
+
+namespace {
+
+// Box filter with the factor as a template parameter so the inner loops
+// unroll; factors are powers of two, so the rounding divide is a shift.
+template <class Access, int kFactor>
+void downsample_luma(const Access& frame, uint8_t* dst, int dst_width, int dst_height) {
+  constexpr uint32_t kArea = kFactor * kFactor;
+  constexpr int kShift = kArea == 1 ? 0 : kArea == 4 ? 2 : kArea == 16 ? 4 : kArea == 64 ? 6 : 8;
+  for (int y = 0; y < dst_height; ++y) {
+    uint8_t* out = dst + static_cast<ptrdiff_t>(y) * dst_width;
+    const uint8_t* rows[kFactor];
+    for (int r = 0; r < kFactor; ++r) {
+      rows[r] = frame.row(y * kFactor + r);
+    }
+    for (int x = 0; x < dst_width; ++x) {
+      const int x0 = x * kFactor;
+      uint32_t total = 0;
+      for (int r = 0; r < kFactor; ++r) {
+        for (int i = 0; i < kFactor; ++i) {
+          total += static_cast<uint32_t>(Access::luma(rows[r], x0 + i));
+        }
+      }
+      out[x] = static_cast<uint8_t>((total + kArea / 2) >> kShift);
+    }
+  }
+}
+
+template <class Access>
+void downsample_luma(const Access& frame, int factor, uint8_t* dst, int dst_width, int dst_height) {
+  switch (factor) {
+    case 1:
+      return downsample_luma<Access, 1>(frame, dst, dst_width, dst_height);
+    case 2:
+      return downsample_luma<Access, 2>(frame, dst, dst_width, dst_height);
+    case 4:
+      return downsample_luma<Access, 4>(frame, dst, dst_width, dst_height);
+    case 8:
+      return downsample_luma<Access, 8>(frame, dst, dst_width, dst_height);
+    default:
+      return downsample_luma<Access, 16>(frame, dst, dst_width, dst_height);
+  }
+}
+
+int16_t median_component(int16_t* values, int count) {
+  std::nth_element(values, values + count / 2, values + count);
+  return values[count / 2];
+}
+
+// Matches every block of `current` against `previous` within
+// +-kMotionSearchRange. The zero vector, the predictor and the left and upper
+// neighbours' vectors are tried first. Unless one of them is already a good
+// match, a step search (8 neighbours at steps 4, 2, 1) refines the best of
+// them, which bounds the cost at 24 more candidates instead of the full
+// window. Each SAD stops as soon as it exceeds the best so far.
+void match_blocks(const uint8_t* current, const uint8_t* previous, int width, int height,
+                  int predict_dx, int predict_dy, int block_cols, int block_rows,
+                  MotionVector* vectors) {
+  const int stride = width;
+  for (int by = 0; by < block_rows; ++by) {
+    for (int bx = 0; bx < block_cols; ++bx) {
+      const int x0 = bx * kMotionBlockSize;
+      const int y0 = by * kMotionBlockSize;
+      const uint8_t* block = current + static_cast<ptrdiff_t>(y0) * stride + x0;
+
+      // Offsets into the previous frame; the block moved by minus the offset.
+      int best_ox = 0;
+      int best_oy = 0;
+      uint32_t best = std::numeric_limits<uint32_t>::max();
+      auto try_offset = [&](int ox, int oy) {
+        if (std::abs(ox) > kMotionSearchRange || std::abs(oy) > kMotionSearchRange ||
+            x0 + ox < 0 || y0 + oy < 0 || x0 + ox + kMotionBlockSize > width ||
+            y0 + oy + kMotionBlockSize > height) {
+          return;
+        }
+        const uint8_t* candidate = previous + static_cast<ptrdiff_t>(y0 + oy) * stride + x0 + ox;
+        uint32_t sad = sad_16xn(block, stride, candidate, stride, kMotionBlockSize, best);
+        if (sad < best) {
+          best = sad;
+          best_ox = ox;
+          best_oy = oy;
+        }
+      };
+
+      try_offset(0, 0);
+      try_offset(-predict_dx, -predict_dy);
+      if (bx > 0) {
+        const MotionVector& left = vectors[by * block_cols + bx - 1];
+        try_offset(-left.dx, -left.dy);
+      }
+      if (by > 0) {
+        const MotionVector& up = vectors[(by - 1) * block_cols + bx];
+        try_offset(-up.dx, -up.dy);
+      }
+      if (best > kMotionEarlyExitSad) {
+        for (int step = 4; step >= 1; step /= 2) {
+          const int center_x = best_ox;
+          const int center_y = best_oy;
+          for (int sy = -step; sy <= step; sy += step) {
+            for (int sx = -step; sx <= step; sx += step) {
+              if (sx != 0 || sy != 0) {
+                try_offset(center_x + sx, center_y + sy);
+              }
+            }
+          }
+        }
+      }
+      vectors[by * block_cols + bx] =
+          MotionVector{static_cast<int16_t>(-best_ox), static_cast<int16_t>(-best_oy), best};
+    }
+  }
+}
+
+} // namespace
+
+void downsample_luma_plane(const VpFrame& frame, int factor, uint8_t* dst, int dst_width,
+                           int dst_height) {
+  switch (frame.format) {
+    case VP_PIXEL_GRAY8:
+    case VP_PIXEL_NV12:
+    case VP_PIXEL_I420:
+      if (factor == 1) {
+        for (int y = 0; y < dst_height; ++y) {
+          std::memcpy(dst + static_cast<ptrdiff_t>(y) * dst_width,
+                      frame.data + static_cast<ptrdiff_t>(y) * frame.stride_bytes,
+                      static_cast<size_t>(dst_width));
+        }
+        return;
+      }
+      downsample_luma(Gray8Access(frame), factor, dst, dst_width, dst_height);
+      return;
+    case VP_PIXEL_RGBA8888:
+      downsample_luma(Rgba8888Access(frame), factor, dst, dst_width, dst_height);
+      return;
+    case VP_PIXEL_BGRA8888:
+      downsample_luma(Bgra8888Access(frame), factor, dst, dst_width, dst_height);
+      return;
+  }
+}
+
+void MotionEstimator::reset() {
+  has_cached_ = false;
+  predict_dx_ = 0;
+  predict_dy_ = 0;
+}
+
+bool MotionEstimator::is_cached(const VpFrame& frame) const {
+  return has_cached_ && frame.data == cached_.data && frame.width == cached_.width &&
+         frame.height == cached_.height && frame.stride_bytes == cached_.stride_bytes &&
+         frame.format == cached_.format;
+}
+
+bool MotionEstimator::estimate(const VpFrame& frame, const VpFrame& prev, Stats* stats,
+                               MotionField* out) {
+  const int factor = motion_downsample_factor(frame.width, frame.height);
+  const int width = frame.width / factor;
+  const int height = frame.height / factor;
+  const int block_cols = width / kMotionBlockSize;
+  const int block_rows = height / kMotionBlockSize;
+  if (block_cols == 0 || block_rows == 0) {
+    return false;
+  }
+  const int block_count = block_cols * block_rows;
+  const size_t plane_bytes = static_cast<size_t>(width) * static_cast<size_t>(height);
+  const size_t vector_bytes = static_cast<size_t>(block_count) *
+                              (sizeof(MotionVector) + 2 * sizeof(int16_t));
+
+  // The cached plane sits in the current slot; make it the previous one.
+  bool reuse = is_cached(prev);
+  if (reuse) {
+    arena_->swap(kScratchMotionCurrent, kScratchMotionPrevious);
+  }
+  bool grew_previous = false;
+  bool grew_current = false;
+  bool grew_vectors = false;
+  uint8_t* previous = arena_->acquire(kScratchMotionPrevious, plane_bytes, &grew_previous);
+  uint8_t* current = arena_->acquire(kScratchMotionCurrent, plane_bytes, &grew_current);
+  uint8_t* vector_memory = arena_->acquire(kScratchMotionVectors, vector_bytes, &grew_vectors);
+  if (stats) {
+    for (bool grew : {grew_previous, grew_current, grew_vectors}) {
+      if (grew) {
+        stats->add_allocation(VP_STAGE_METRICS);
+      }
+    }
+  }
+  has_cached_ = false;
+  if (!previous || !current || !vector_memory) {
+    return false;
+  }
+  if (!reuse || grew_previous) {
+    downsample_luma_plane(prev, factor, previous, width, height);
+  }
+  downsample_luma_plane(frame, factor, current, width, height);
+  has_cached_ = true;
+  cached_ = frame;
+
+  MotionVector* vectors = reinterpret_cast<MotionVector*>(vector_memory);
+  match_blocks(current, previous, width, height, predict_dx_, predict_dy_, block_cols, block_rows,
+               vectors);
+
+  int16_t* dx = reinterpret_cast<int16_t*>(vectors + block_count);
+  int16_t* dy = dx + block_count;
+  for (int i = 0; i < block_count; ++i) {
+    dx[i] = vectors[i].dx;
+    dy[i] = vectors[i].dy;
+  }
+  predict_dx_ = median_component(dx, block_count);
+  predict_dy_ = median_component(dy, block_count);
+
+  *out = MotionField{factor, block_cols, block_rows, vectors, predict_dx_, predict_dy_};
+  return true;
+}
+
+} // namespace vp
@@ -0,0 +1,27 @@
+#ifndef VP_PHASH_H
+#define VP_PHASH_H
+
+#include <cstdint>
+
+#include "vp_analyzer.h"
+
+namespace vp {
+
+// 64-bit difference hash (dHash): the frame's luma is box-averaged down to a
+// 9x8 grid and each bit records whether a cell is darker than its right-hand
+// neighbour. Each cell averages up to kHashRowsPerCell evenly spaced pixel
+// rows, so the cost is a few row sums rather than a full-frame pass.
+using FrameHashFn = uint64_t (*)(const VpFrame& frame);
+
+constexpr int kHashRowsPerCell = 4;
+
+// Returns the hash function specialized for `format`, or nullptr.
+FrameHashFn select_frame_hash(VpPixelFormat format);
+
+inline int hamming_distance(uint64_t a, uint64_t b) {
+  return __builtin_popcountll(a ^ b);
+}
+
+} // namespace vp
+
+#endif // VP_PHASH_H
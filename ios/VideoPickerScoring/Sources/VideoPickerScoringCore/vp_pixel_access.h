@@ -0,0 +1,143 @@
+#ifndef VP_PIXEL_ACCESS_H
+#define VP_PIXEL_ACCESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "vp_analyzer.h"
+#include "vp_metrics.h"
+#include "vp_simd.h"
+
+namespace vp {
+
+// Accessor policies let the metric kernels read luma straight out of the
+// caller's buffer. Each policy exposes the frame geometry, a row pointer and
+// a static luma(row, x) that the kernels inline into their loops, plus a
+// static sum_luma(row, x0, x1) over [x0, x1) for downsampling.
+// kBytesPerPixel == 1 marks policies whose rows are plain luma bytes.
+
+class Gray8Access {
+ public:
+  static constexpr int kBytesPerPixel = 1;
+
+  explicit Gray8Access(const VpFrame& frame)
+      : data_(frame.data), stride_(frame.stride_bytes), width_(frame.width), height_(frame.height) {}
+  explicit Gray8Access(const GrayFrame& frame)
+      : data_(frame.data), stride_(frame.stride), width_(frame.width), height_(frame.height) {}
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  const uint8_t* row(int y) const { return data_ + static_cast<ptrdiff_t>(y) * stride_; }
+
+  static int luma(const uint8_t* row, int x) { return row[x]; }
+  static uint32_t sum_luma(const uint8_t* row, int x0, int x1) { return sum_u8(row + x0, x1 - x0); }
+
+  // Writes row y to dst[0, width), for the banded pipeline.
+  void convert_row(int y, uint8_t* dst) const { std::memcpy(dst, row(y), static_cast<size_t>(width_)); }
+
+ private:
+  const uint8_t* data_;
+  int stride_;
+  int width_;
+  int height_;
+};
+
+// 4-byte packed RGB formats; luma is the BT.601 integer approximation the
+// analyzer has always used, computed on every read.
+template <int kR, int kG, int kB>
+class PackedRgbAccess {
+ public:
+  static constexpr int kBytesPerPixel = 4;
+
+  explicit PackedRgbAccess(const VpFrame& frame)
+      : data_(frame.data), stride_(frame.stride_bytes), width_(frame.width), height_(frame.height) {}
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  const uint8_t* row(int y) const { return data_ + static_cast<ptrdiff_t>(y) * stride_; }
+
+  static int luma(const uint8_t* row, int x) {
+    const uint8_t* pixel = row + x * 4;
+    return (299 * pixel[kR] + 587 * pixel[kG] + 114 * pixel[kB]) / 1000;
+  }
+
+  static uint32_t sum_luma(const uint8_t* row, int x0, int x1) {
+    uint32_t total = 0;
+    for (int x = x0; x < x1; ++x) {
+      total += static_cast<uint32_t>(luma(row, x));
+    }
+    return total;
+  }
+
+  // Writes the luma of row y to dst[0, width).
+  void convert_row(int y, uint8_t* dst) const {
+    const uint8_t* src = row(y);
+    for (int x = 0; x < width_; ++x) {
+      dst[x] = static_cast<uint8_t>(luma(src, x));
+    }
+  }
+
+ private:
+  const uint8_t* data_;
+  int stride_;
+  int width_;
+  int height_;
+};
+
+using Rgba8888Access = PackedRgbAccess<0, 1, 2>;
+using Bgra8888Access = PackedRgbAccess<2, 1, 0>;
+
+// Luma rows of a frame held in a ring of kRingRows packed rows, so row(y)
+// resolves to slot y mod kRingRows. Only the rows most recently written by the
+// banded pipeline are valid.
+class RingRowsAccess {
+ public:
+  static constexpr int kBytesPerPixel = 1;
+  static constexpr int kRingRows = 4;
+
+  RingRowsAccess(uint8_t* ring, int width, int height) : ring_(ring), width_(width), height_(height) {}
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  const uint8_t* row(int y) const { return slot(y); }
+  uint8_t* slot(int y) const {
+    return ring_ + static_cast<ptrdiff_t>(y & (kRingRows - 1)) * width_;
+  }
+
+  static int luma(const uint8_t* row, int x) { return row[x]; }
+  static uint32_t sum_luma(const uint8_t* row, int x0, int x1) { return sum_u8(row + x0, x1 - x0); }
+
+ private:
+  uint8_t* ring_;
+  int width_;
+  int height_;
+};
+
+// NV12 / I420: VpFrame.data and stride_bytes describe the Y plane, which is
+// already luma, so the planar formats share the GRAY8 policy.
+using YPlaneAccess = Gray8Access;
+
+inline int bytes_per_pixel(VpPixelFormat format) {
+  switch (format) {
+    case VP_PIXEL_GRAY8:
+    case VP_PIXEL_NV12:
+    case VP_PIXEL_I420:
+      return 1;
+    case VP_PIXEL_RGBA8888:
+    case VP_PIXEL_BGRA8888:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+inline bool is_valid_frame(const VpFrame& frame) {
+  int bpp = bytes_per_pixel(frame.format);
+  return frame.data && frame.width > 0 && frame.height > 0 && bpp > 0 && frame.stride_bytes > 0 &&
+         frame.stride_bytes >= frame.width * bpp;
+}
+
+} // namespace vp
+
+#endif // VP_PIXEL_ACCESS_H
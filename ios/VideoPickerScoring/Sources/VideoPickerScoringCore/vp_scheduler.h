@@ -0,0 +1,106 @@
+#ifndef VP_SCHEDULER_H
+#define VP_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vp_analyzer.h"
+
+namespace vp {
+
+// One analysis submitted to a Scheduler. The owner fills in the first block;
+// the rest is scheduler state guarded by its mutex.
+struct ScheduledJob {
+  VpPriority priority = VP_PRIORITY_BACKGROUND;
+  const std::atomic<bool>* cancel = nullptr;
+  // Runs the whole analysis on a worker thread, calling Scheduler::checkpoint
+  // between frames and Scheduler::finish before reporting completion.
+  void (*run)(void* owner) = nullptr;
+  void* owner = nullptr;
+
+  enum class State { kQueued, kReady, kRunning, kPaused, kDone };
+  State state = State::kQueued;
+  // Set once a worker has picked the job up; a paused job keeps its worker.
+  bool started = false;
+  bool holds_slot = false;
+  // Waited past the aging limit: from then on admitted like an interactive
+  // job and never preempted.
+  bool aged = false;
+  std::chrono::steady_clock::time_point waiting_since;
+  uint64_t sequence = 0;
+};
+
+// Runs analyses on a fixed worker pool with at most max_running of them
+// scoring at once. Interactive jobs are admitted first; a running background
+// job gives its slot up at the next frame boundary while an interactive (or
+// aged) job waits for one, and resumes when readmitted. Background jobs hold
+// at most background_cap slots, running or preempted, which also bounds the
+// threads parked by preemption. A background job waiting aging_ms becomes
+// aged, so a steady stream of interactive work cannot starve it.
+class Scheduler {
+ public:
+  explicit Scheduler(const VpSchedulerConfig& config);
+  // Every submitted job must have finished.
+  ~Scheduler();
+
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+
+  bool start();
+  void submit(ScheduledJob* job);
+
+  // Between two frames of a running job: yields the slot and blocks while
+  // preempted. Returns early, without a slot, if the job is cancelled.
+  void checkpoint(ScheduledJob* job);
+
+  // The job's analysis is over; frees its slot.
+  void finish(ScheduledJob* job);
+
+  // A job's cancel flag was set: wakes the workers so a queued job is run
+  // (and ends at once) and a preempted one stops waiting for its slot.
+  void wake();
+
+  int max_running() const { return max_running_; }
+  int background_cap() const { return background_cap_; }
+
+ private:
+  void worker();
+  // Hands free slots to the best admissible waiting jobs. Needs mutex_.
+  void dispatch();
+  bool admissible(const ScheduledJob& job) const;
+  bool urgent(const ScheduledJob& job, std::chrono::steady_clock::time_point now) const;
+  bool has_urgent_waiter(std::chrono::steady_clock::time_point now) const;
+  // Some job has not started yet; idle workers then poll for cancellation.
+  bool has_queued() const;
+  void grant(ScheduledJob* job, std::chrono::steady_clock::time_point now);
+  void remove_waiting(ScheduledJob* job);
+
+  int max_running_;
+  int background_cap_;
+  std::chrono::milliseconds aging_;
+
+  std::mutex mutex_;
+  // Idle workers wait for ready_ jobs; preempted jobs wait to be resumed.
+  std::condition_variable ready_cv_;
+  std::condition_variable resume_cv_;
+  // Queued and paused jobs.
+  std::vector<ScheduledJob*> waiting_;
+  // Granted jobs that no worker has picked up yet.
+  std::deque<ScheduledJob*> ready_;
+  int running_ = 0;
+  // Background jobs started and not finished, running or paused.
+  int background_held_ = 0;
+  uint64_t next_sequence_ = 0;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+
+} // namespace vp
+
+#endif // VP_SCHEDULER_H
@@ -0,0 +1,75 @@
+#include "vp_scratch.h"
+
+#include <new>
+#include <utility>
+
+namespace vp {
+
+ScratchArena::~ScratchArena() {
+  for (Block& block : blocks_) {
+    release(block);
+  }
+}
+
+void ScratchArena::release(Block& block) {
+  if (block.data) {
+    ::operator delete(block.data, std::align_val_t(kAlignment));
+  }
+  block.data = nullptr;
+  block.capacity = 0;
+}
+
+uint8_t* ScratchArena::acquire(ScratchSlot slot, size_t bytes, bool* grew) {
+  Block& block = blocks_[slot];
+  if (grew) {
+    *grew = false;
+  }
+  if (bytes <= block.capacity && block.data) {
+    return block.data;
+  }
+
+  size_t capacity = (bytes + kAlignment - 1) / kAlignment * kAlignment;
+  if (capacity == 0) {
+    capacity = kAlignment;
+  }
+  void* memory = ::operator new(capacity, std::align_val_t(kAlignment), std::nothrow);
+  if (!memory) {
+    return nullptr;
+  }
+  release(block);
+  block.data = static_cast<uint8_t*>(memory);
+  block.capacity = capacity;
+  if (grew) {
+    *grew = true;
+  }
+  return block.data;
+}
+
+void ScratchArena::swap(ScratchSlot a, ScratchSlot b) {
+  std::swap(blocks_[a], blocks_[b]);
+}
+
+void ScratchArena::trim(size_t keep_bytes) {
+  while (capacity_bytes() > keep_bytes) {
+    Block* largest = nullptr;
+    for (Block& block : blocks_) {
+      if (block.data && (!largest || block.capacity > largest->capacity)) {
+        largest = &block;
+      }
+    }
+    if (!largest) {
+      return;
+    }
+    release(*largest);
+  }
+}
+
+size_t ScratchArena::capacity_bytes() const {
+  size_t total = 0;
+  for (const Block& block : blocks_) {
+    total += block.capacity;
+  }
+  return total;
+}
+
+} // namespace vp
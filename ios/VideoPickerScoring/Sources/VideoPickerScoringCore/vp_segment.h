@@ -0,0 +1,82 @@
+#ifndef VP_SEGMENT_H
+#define VP_SEGMENT_H
+
+#include <vector>
+
+#include "vp_analyzer.h"
+
+namespace vp {
+
+// Streaming search for the contiguous window of `window` frames with the
+// highest mean composite score (a weighted mean of the metric scores). Frames
+// are pushed in order; the finder keeps only the last `window` frames in ring
+// buffers, updates the window sums in O(1) and tracks each metric's window
+// minimum with a monotonic deque, so a clip costs O(frames) in total. Ties go
+// to the earliest window. Usage:
+//
+//   finder.reset(window, metric_count, weights);
+//   for each frame: finder.push(scores, raws);
+//   finder.finish();
+class SegmentFinder {
+ public:
+  struct MetricWindow {
+    float mean_score;
+    float mean_raw;
+    // The lowest score in the window and the raw value it came from.
+    float worst_score;
+    float worst_raw;
+  };
+
+  // weights[metric_count] must be non-negative; all zero weighs every metric
+  // equally.
+  void reset(int window, int metric_count, const float* weights);
+
+  // scores[metric_count] and raws[metric_count] of the next frame.
+  void push(const float* scores, const float* raws);
+
+  // Settles the result; a clip shorter than the window yields the whole clip.
+  // Returns false if no frame was pushed.
+  bool finish();
+
+  int start() const { return best_start_; }
+  // One past the last frame of the best window.
+  int end() const { return best_start_ + best_length_; }
+  float score() const { return best_score_; }
+  const MetricWindow& metric(int index) const { return best_metrics_[index]; }
+
+ private:
+  // Ring of frame indices whose scores increase from front to back.
+  struct MinDeque {
+    int head = 0;
+    int size = 0;
+  };
+
+  static constexpr double kTieEpsilon = 1e-6;
+
+  void snapshot(int length);
+
+  int window_ = 0;
+  int metric_count_ = 0;
+  float weights_[VP_MAX_ITEMS] = {};
+  int count_ = 0;
+  // Window-sized rings, metric-major: [metric * window + frame % window].
+  std::vector<float> scores_;
+  std::vector<float> raws_;
+  std::vector<int> deque_frames_;
+  std::vector<float> composites_;
+  MinDeque deques_[VP_MAX_ITEMS];
+  double score_sums_[VP_MAX_ITEMS] = {};
+  double raw_sums_[VP_MAX_ITEMS] = {};
+  double composite_sum_ = 0.0;
+
+  bool has_best_ = false;
+  int best_start_ = 0;
+  int best_length_ = 0;
+  double best_mean_ = 0.0;
+  float best_score_ = 0.0f;
+  MetricWindow best_metrics_[VP_MAX_ITEMS] = {};
+};
+
+} // namespace vp
+
+#endif // VP_SEGMENT_H
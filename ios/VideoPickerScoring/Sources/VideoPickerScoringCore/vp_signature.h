@@ -0,0 +1,72 @@
+#ifndef VP_SIGNATURE_H
+#define VP_SIGNATURE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "vp_analyzer.h"
+
+namespace vp {
+
+// Hashes with fewer than this many set (or clear) bits come from nearly flat
+// frames (black, fades, solid titles); they would match across unrelated
+// clips and are left out of signatures.
+constexpr int kSignatureMinBits = 4;
+
+// Hashes up to VP_SIGNATURE_HASHES evenly spaced frames of frames[0, count).
+// Frames with an unsupported layout are skipped like flat ones. Returns
+// VP_ERR_INVALID_ARGUMENT for an empty sequence.
+int compute_signature(const VpFrame* frames, int frame_count, VpVideoSignature* out_signature);
+
+// Multi-index hashing over clip signatures: every hash is split into four
+// 16-bit bands and each band value heads a list of the clips containing it,
+// threaded through one node array so adding a clip never allocates per key. Two
+// hashes within Hamming distance 3 agree on at least one band, so a query
+// only visits clips that share a band with one of its hashes and verifies
+// them with the full distance. Queries are const and may run concurrently;
+// add() and load() need exclusive access.
+class SignatureIndex {
+ public:
+  static constexpr int kBands = 4;
+  static constexpr int kBandBits = 16;
+
+  // False for an empty signature.
+  bool add(const VpVideoSignature& signature, uint64_t video_id);
+
+  void query(const VpVideoSignature& signature, const VpSignatureQuery& query,
+             VpSignatureMatch* out_match) const;
+
+  int64_t size() const { return static_cast<int64_t>(entries_.size()); }
+
+  int save(const char* path) const;
+  int load(const char* path);
+
+ private:
+  struct Entry {
+    uint64_t video_id;
+    VpVideoSignature signature;
+  };
+
+  struct Node {
+    uint32_t entry;
+    uint32_t next;
+  };
+
+  static constexpr uint32_t kNoNode = 0xffffffffu;
+
+  static uint32_t band_key(uint64_t hash, int band) {
+    return (static_cast<uint32_t>(band) << kBandBits) |
+           static_cast<uint32_t>((hash >> (band * kBandBits)) & 0xffffu);
+  }
+
+  void insert_bands(uint32_t entry);
+
+  std::vector<Entry> entries_;
+  // kBands << kBandBits list heads, allocated with the first entry.
+  std::vector<uint32_t> heads_;
+  std::vector<Node> nodes_;
+};
+
+} // namespace vp
+
+#endif // VP_SIGNATURE_H
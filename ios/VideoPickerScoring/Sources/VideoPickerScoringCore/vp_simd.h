@@ -0,0 +1,90 @@
+#ifndef VP_SIMD_H
+#define VP_SIMD_H
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VP_SIMD_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VP_SIMD_NEON 1
+#endif
+
+namespace vp {
+
+// Sum of `count` bytes. SSE2 uses psadbw against zero; NEON widens with
+// pairwise adds. Both fall back to a scalar tail.
+inline uint32_t sum_u8(const uint8_t* data, int count) {
+  uint32_t total = 0;
+  int i = 0;
+#if defined(VP_SIMD_SSE2)
+  __m128i acc = _mm_setzero_si128();
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= count; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+  }
+  total += static_cast<uint32_t>(_mm_cvtsi128_si32(acc)) +
+           static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#elif defined(VP_SIMD_NEON)
+  uint32x4_t acc = vdupq_n_u32(0);
+  for (; i + 16 <= count; i += 16) {
+    uint8x16_t v = vld1q_u8(data + i);
+    acc = vpadalq_u16(acc, vpaddlq_u8(v));
+  }
+  total += vgetq_lane_u32(acc, 0) + vgetq_lane_u32(acc, 1) + vgetq_lane_u32(acc, 2) +
+           vgetq_lane_u32(acc, 3);
+#endif
+  for (; i < count; ++i) {
+    total += data[i];
+  }
+  return total;
+}
+
+// Sum of absolute differences over a block 16 pixels wide and `rows` tall.
+// The partial sum is checked every 4 rows; once it reaches `limit` the
+// search candidate cannot win, so the partial value (>= limit) is returned.
+// SSE2 uses one psadbw per row; NEON accumulates vabdq into 16-bit lanes.
+inline uint32_t sad_16xn(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int rows,
+                         uint32_t limit) {
+  uint32_t total = 0;
+  for (int y = 0; y < rows; y += 4) {
+    int end = y + 4 < rows ? y + 4 : rows;
+#if defined(VP_SIMD_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    for (int r = y; r < end; ++r) {
+      __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + r * a_stride));
+      __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + r * b_stride));
+      acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+    }
+    total += static_cast<uint32_t>(_mm_cvtsi128_si32(acc)) +
+             static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#elif defined(VP_SIMD_NEON)
+    uint16x8_t acc = vdupq_n_u16(0);
+    for (int r = y; r < end; ++r) {
+      uint8x16_t diff = vabdq_u8(vld1q_u8(a + r * a_stride), vld1q_u8(b + r * b_stride));
+      acc = vpadalq_u8(acc, diff);
+    }
+    uint32x4_t wide = vpaddlq_u16(acc);
+    total += vgetq_lane_u32(wide, 0) + vgetq_lane_u32(wide, 1) + vgetq_lane_u32(wide, 2) +
+             vgetq_lane_u32(wide, 3);
+#else
+    for (int r = y; r < end; ++r) {
+      const uint8_t* ra = a + r * a_stride;
+      const uint8_t* rb = b + r * b_stride;
+      for (int x = 0; x < 16; ++x) {
+        total += static_cast<uint32_t>(ra[x] > rb[x] ? ra[x] - rb[x] : rb[x] - ra[x]);
+      }
+    }
+#endif
+    if (total >= limit) {
+      return total;
+    }
+  }
+  return total;
+}
+
+} // namespace vp
+
+#endif // VP_SIMD_H
@@ -0,0 +1,64 @@
+#include "vp_stats.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "vp_metrics.h"
+
+namespace vp {
+
+#if VP_ENABLE_STATS
+
+void Stats::snapshot(VpStats* out) const {
+  std::memset(out, 0, sizeof(*out));
+  out->enabled = 1;
+  for (int i = 0; i < VP_STAGE_COUNT; ++i) {
+    const StageCounters& counters = stages_[i];
+    VpStageStats& stage = out->stages[i];
+    stage.calls = counters.calls.load(std::memory_order_relaxed);
+    stage.frames = counters.frames.load(std::memory_order_relaxed);
+    stage.pixels = counters.pixels.load(std::memory_order_relaxed);
+    stage.bytes_copied = counters.bytes_copied.load(std::memory_order_relaxed);
+    stage.allocations = counters.allocations.load(std::memory_order_relaxed);
+    stage.nanoseconds = counters.nanoseconds.load(std::memory_order_relaxed);
+  }
+  int metric_count = 0;
+  for (int i = 0; i < VP_MAX_ITEMS; ++i) {
+    const MetricCounters& counters = metrics_[i];
+    int32_t metric_id = counters.metric_id.load(std::memory_order_relaxed);
+    if (metric_id < 0) {
+      continue;
+    }
+    VpMetricStats& metric = out->metrics[i];
+    metric.metric_id = metric_id;
+    std::snprintf(metric.id_str, VP_METRIC_ID_MAX_LEN, "%s",
+                  metric_id_to_string(metric_id));
+    metric.calls = counters.calls.load(std::memory_order_relaxed);
+    metric.overrides = counters.overrides.load(std::memory_order_relaxed);
+    metric.nanoseconds = counters.nanoseconds.load(std::memory_order_relaxed);
+    metric_count = i + 1;
+  }
+  out->metric_count = metric_count;
+  out->near_duplicate_frames = near_duplicates_.load(std::memory_order_relaxed);
+}
+
+void Stats::reset() {
+  near_duplicates_.store(0, std::memory_order_relaxed);
+  for (StageCounters& counters : stages_) {
+    counters.calls.store(0, std::memory_order_relaxed);
+    counters.frames.store(0, std::memory_order_relaxed);
+    counters.pixels.store(0, std::memory_order_relaxed);
+    counters.bytes_copied.store(0, std::memory_order_relaxed);
+    counters.allocations.store(0, std::memory_order_relaxed);
+    counters.nanoseconds.store(0, std::memory_order_relaxed);
+  }
+  for (MetricCounters& counters : metrics_) {
+    counters.calls.store(0, std::memory_order_relaxed);
+    counters.overrides.store(0, std::memory_order_relaxed);
+    counters.nanoseconds.store(0, std::memory_order_relaxed);
+  }
+}
+
+#endif // VP_ENABLE_STATS
+
+} // namespace vp
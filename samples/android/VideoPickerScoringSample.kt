@@ -1,18 +1,17 @@
 package com.example.videopickerscoring
 
-import android.net.Uri
+import android.media.Image
 import android.util.Log
 
 class VideoPickerScoringSample(private val scoring: VideoPickerScoring) {
-    fun analyzeFromUri(uri: Uri, context: android.content.Context) {
-        val tempFile = VideoPickerScoring.copyContentUriToFile(context, uri)
-        val result = scoring.analyzeVideo(tempFile.absolutePath)
+    // Images from an ImageReader (YUV_420_888) fed to MediaCodec output.
+    fun analyzeImages(images: List<Image>) {
+        val result = scoring.analyzeFrames(images.map { VideoPickerScoring.Frame.fromImage(it) })
         if (result == null) {
             Log.e("VideoPickerScoring", "Analyze failed")
             return
         }
-        val weightedScore = scoring.weightedScore(result)
-        Log.d("VideoPickerScoring", "weightedScore=${weightedScore ?: "n/a"}")
+        Log.d("VideoPickerScoring", "weightedScore=${scoring.weightedScore(result) ?: "n/a"}")
         result.mean.forEach { item ->
             Log.d("VideoPickerScoring", "mean ${item.id} score=${item.score} raw=${item.raw}")
         }